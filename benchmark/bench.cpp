@@ -7,6 +7,7 @@
 #include <unordered_map>
 
 #include "art.h"
+#include "fixed_key_art.h"
 #include "util.h"
 
 namespace bm = benchmark;
@@ -54,7 +55,7 @@ struct ARTKeyHash {
 
 int main(int argc, char** argv) {
   ::benchmark::Initialize(&argc, argv);
-  Random random;
+  Random random(42);
   Allocator &allocator = Allocator::DefaultAllocator();
   ArenaAllocator arena_allocator(allocator, 16384);
   int limit = 1000000;
@@ -69,6 +70,20 @@ int main(int argc, char** argv) {
     }
   });
 
+  std::vector<int64_t> int_keys;
+  for (int i = 0; i < limit; i++) {
+    int_keys.push_back(random.NextLong());
+  }
+
+  register_benchmark("fixed_key_art_unordered_write_test", 1, [&](bm::State &st) {
+    FixedKeyART<int64_t> art;
+    while (st.KeepRunning()) {
+      for(int i = 0; i < limit; i++) {
+        art.Put(int_keys[i], i);
+      }
+    }
+  });
+
   std::sort(kv_pairs.begin(), kv_pairs.end(), [](auto a, auto b) {
     return a.first < b.first;
   });
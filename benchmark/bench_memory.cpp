@@ -0,0 +1,324 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+// Memory cost of ART against std::map, std::unordered_map, absl::btree_map and absl::flat_hash_map for datasets of
+// different shapes. Every structure allocates through a counting allocator, so bytes_per_key is the heap memory it
+// really holds after the inserts, keys included, divided by the number of distinct keys:
+//
+//   dense     sequential int64
+//   sparse    random int64
+//   short     random strings of 4 to 12 characters
+//   url       URLs sharing hosts and paths
+//   email     email like keys on a few domains
+//
+// ART additionally reports the number of nodes of each type and fill, the part of its allocator buffers used by
+// nodes. The time of a run is the time to build the structure.
+//
+//   bench_memory --benchmark_filter='.*/url/.*'
+#include <absl/container/btree_map.h>
+#include <absl/container/flat_hash_map.h>
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "arena_allocator.h"
+#include "art.h"
+#include "art_iterator.h"
+#include "leaf.h"
+#include "node16.h"
+#include "node256.h"
+#include "node4.h"
+#include "node48.h"
+#include "prefix.h"
+
+namespace bm = benchmark;
+using namespace part;
+
+static constexpr idx_t KEY_COUNT = 1000000;
+static constexpr uint64_t SEED = 42;
+
+//! Heap bytes currently held by the structure under test
+static int64_t allocated_bytes = 0;
+
+//! Counts the memory of the std and absl containers, and of the strings they own
+template <class T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <class U>
+  CountingAllocator(const CountingAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    allocated_bytes += n * sizeof(T);
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *ptr, size_t n) {
+    allocated_bytes -= n * sizeof(T);
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template <class U>
+  bool operator==(const CountingAllocator<U> &) const {
+    return true;
+  }
+  template <class U>
+  bool operator!=(const CountingAllocator<U> &) const {
+    return false;
+  }
+};
+
+using CountingString = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+
+struct StringHash {
+  using is_transparent = void;
+  size_t operator()(const CountingString &value) const {
+    return std::hash<std::string_view>()(std::string_view(value.data(), value.size()));
+  }
+};
+
+//! Counts the buffers of the ART allocators
+static data_ptr_t CountingAllocate(PrivateAllocatorData *private_data, idx_t size) {
+  allocated_bytes += size;
+  return Allocator::DefaultAllocate(private_data, size);
+}
+
+static void CountingFree(PrivateAllocatorData *private_data, data_ptr_t pointer, idx_t size) {
+  allocated_bytes -= size;
+  Allocator::DefaultFree(private_data, pointer, size);
+}
+
+static data_ptr_t CountingReallocate(PrivateAllocatorData *private_data, data_ptr_t pointer, idx_t old_size,
+                                     idx_t size) {
+  allocated_bytes += int64_t(size) - int64_t(old_size);
+  return Allocator::DefaultReallocate(private_data, pointer, old_size, size);
+}
+
+static Allocator &CountingARTAllocator() {
+  static Allocator allocator(CountingAllocate, CountingFree, CountingReallocate,
+                             std::make_unique<PrivateAllocatorData>());
+  return allocator;
+}
+
+enum class Dataset : uint8_t { DENSE, SPARSE, SHORT, URL, EMAIL };
+
+static const char *DatasetName(Dataset dataset) {
+  switch (dataset) {
+    case Dataset::DENSE:
+      return "dense";
+    case Dataset::SPARSE:
+      return "sparse";
+    case Dataset::SHORT:
+      return "short";
+    case Dataset::URL:
+      return "url";
+    case Dataset::EMAIL:
+      return "email";
+  }
+  return "";
+}
+
+static inline bool IsIntegral(Dataset dataset) { return dataset == Dataset::DENSE || dataset == Dataset::SPARSE; }
+
+static std::vector<int64_t> GenerateInts(Dataset dataset) {
+  std::vector<int64_t> keys(KEY_COUNT);
+  std::mt19937_64 gen(SEED);
+  for (idx_t i = 0; i < KEY_COUNT; i++) {
+    keys[i] = dataset == Dataset::DENSE ? int64_t(i) : int64_t(gen());
+  }
+  return keys;
+}
+
+static std::vector<std::string> GenerateStrings(Dataset dataset) {
+  static const char *WORDS[] = {"news",    "sports", "tech",   "travel", "food",  "music",
+                                "science", "health", "movies", "books",  "games", "finance"};
+  static const char *NAMES[] = {"alice", "bob",   "carol", "dave",   "erin",  "frank",
+                                "grace", "heidi", "ivan",  "judy",   "mallory", "oscar"};
+  static const char *DOMAINS[] = {"gmail.com", "yahoo.com", "outlook.com", "example.org", "company.io"};
+  std::mt19937_64 gen(SEED);
+  std::vector<std::string> keys;
+  keys.reserve(KEY_COUNT);
+  for (idx_t i = 0; i < KEY_COUNT; i++) {
+    switch (dataset) {
+      case Dataset::SHORT: {
+        std::string key(4 + gen() % 9, ' ');
+        for (auto &c : key) {
+          c = 'a' + gen() % 26;
+        }
+        keys.push_back(std::move(key));
+        break;
+      }
+      case Dataset::URL:
+        keys.push_back(fmt::format("https://www.site{}.com/{}/{}/article-{}.html", gen() % 100, WORDS[gen() % 12],
+                                   WORDS[gen() % 12], gen() % 100000000));
+        break;
+      case Dataset::EMAIL:
+        keys.push_back(fmt::format("{}.{}{}@{}", NAMES[gen() % 12], NAMES[gen() % 12], gen() % 100000,
+                                   DOMAINS[gen() % 5]));
+        break;
+      default:
+        break;
+    }
+  }
+  return keys;
+}
+
+static void ReportMemory(bm::State &state, idx_t distinct_keys) {
+  state.counters["bytes_per_key"] = double(allocated_bytes) / distinct_keys;
+  state.counters["keys"] = distinct_keys;
+}
+
+static void ReportARTNodes(bm::State &state, ART &art) {
+  static const char *NAMES[] = {"prefix", "leaf",   "node4",        "node16",
+                                "node48", "node256", "leaf_segment", "leaf_bitmap"};
+  idx_t used = 0;
+  idx_t reserved = 0;
+  for (idx_t i = 0; i < art.allocators->size(); i++) {
+    auto &allocator = (*art.allocators)[i];
+    state.counters[NAMES[i]] = allocator.total_allocations;
+    used += allocator.total_allocations * allocator.allocation_size;
+    reserved += allocator.GetMemoryUsage();
+  }
+  state.counters["fill"] = reserved ? double(used) / reserved : 0;
+}
+
+static std::shared_ptr<std::vector<FixedSizeAllocator>> CountingAllocators() {
+  // NOTE: the order of ART::ART
+  auto &allocator = CountingARTAllocator();
+  auto allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
+  allocators->emplace_back(sizeof(Prefix), allocator);
+  allocators->emplace_back(sizeof(Leaf), allocator);
+  allocators->emplace_back(sizeof(Node4), allocator);
+  allocators->emplace_back(sizeof(Node16), allocator);
+  allocators->emplace_back(sizeof(Node48), allocator);
+  allocators->emplace_back(sizeof(Node256), allocator);
+  allocators->emplace_back(sizeof(LeafSegment), allocator);
+  allocators->emplace_back(sizeof(LeafBitmap), allocator);
+  return allocators;
+}
+
+static void BM_ART(bm::State &state, Dataset dataset) {
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::vector<ARTKey> keys;
+  if (IsIntegral(dataset)) {
+    for (auto key : GenerateInts(dataset)) {
+      keys.push_back(ARTKey::CreateARTKey<int64_t>(arena_allocator, key));
+    }
+  } else {
+    for (auto &key : GenerateStrings(dataset)) {
+      keys.push_back(ARTKey::CreateARTKey<std::string_view>(arena_allocator, key));
+    }
+  }
+
+  std::unique_ptr<ART> art;
+  for (auto _ : state) {
+    art.reset();
+    allocated_bytes = 0;
+    art = std::make_unique<ART>(CountingAllocators());
+    for (idx_t i = 0; i < keys.size(); i++) {
+      art->Put(keys[i], i);
+    }
+  }
+  // duplicate keys share a leaf, count the distinct ones as the maps do
+  idx_t distinct_keys = 0;
+  ARTIterator it(*art);
+  for (bool valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    distinct_keys++;
+  }
+  ReportMemory(state, distinct_keys);
+  ReportARTNodes(state, *art);
+}
+
+template <class Map>
+static void MeasureIntMap(bm::State &state, Dataset dataset) {
+  auto keys = GenerateInts(dataset);
+  std::unique_ptr<Map> map;
+  idx_t distinct_keys = 0;
+  for (auto _ : state) {
+    map.reset();
+    allocated_bytes = 0;
+    map = std::make_unique<Map>();
+    for (idx_t i = 0; i < keys.size(); i++) {
+      map->emplace(keys[i], i);
+    }
+    distinct_keys = map->size();
+  }
+  ReportMemory(state, distinct_keys);
+}
+
+template <class Map>
+static void MeasureStringMap(bm::State &state, Dataset dataset) {
+  auto keys = GenerateStrings(dataset);
+  std::unique_ptr<Map> map;
+  idx_t distinct_keys = 0;
+  for (auto _ : state) {
+    map.reset();
+    allocated_bytes = 0;
+    map = std::make_unique<Map>();
+    for (idx_t i = 0; i < keys.size(); i++) {
+      map->emplace(CountingString(keys[i].data(), keys[i].size()), i);
+    }
+    distinct_keys = map->size();
+  }
+  ReportMemory(state, distinct_keys);
+}
+
+template <class K>
+using Pair = std::pair<const K, idx_t>;
+
+template <class K, class Hash>
+using StdMap = std::map<K, idx_t, std::less<K>, CountingAllocator<Pair<K>>>;
+template <class K, class Hash>
+using StdUnorderedMap = std::unordered_map<K, idx_t, Hash, std::equal_to<K>, CountingAllocator<Pair<K>>>;
+template <class K, class Hash>
+using BtreeMap = absl::btree_map<K, idx_t, std::less<K>, CountingAllocator<Pair<K>>>;
+// NOTE: std::hash of an integer is the identity, which swiss tables degrade on
+template <class K, class Hash>
+using FlatHashMap = absl::flat_hash_map<K, idx_t, std::conditional_t<std::is_integral_v<K>, absl::Hash<K>, Hash>,
+                                        std::equal_to<K>, CountingAllocator<Pair<K>>>;
+
+template <template <class, class> class Map>
+static void BM_Map(bm::State &state, Dataset dataset) {
+  if (IsIntegral(dataset)) {
+    MeasureIntMap<Map<int64_t, std::hash<int64_t>>>(state, dataset);
+  } else {
+    MeasureStringMap<Map<CountingString, StringHash>>(state, dataset);
+  }
+}
+
+int main(int argc, char **argv) {
+  bm::Initialize(&argc, argv);
+
+  for (auto dataset : {Dataset::DENSE, Dataset::SPARSE, Dataset::SHORT, Dataset::URL, Dataset::EMAIL}) {
+    auto name = DatasetName(dataset);
+    // NOTE: one build per run, the memory does not change with the iterations
+    bm::RegisterBenchmark(fmt::format("art/{}", name).c_str(), BM_ART, dataset)
+        ->Iterations(1)
+        ->Unit(bm::kMillisecond);
+    bm::RegisterBenchmark(fmt::format("std_map/{}", name).c_str(), BM_Map<StdMap>, dataset)
+        ->Iterations(1)
+        ->Unit(bm::kMillisecond);
+    bm::RegisterBenchmark(fmt::format("std_unordered_map/{}", name).c_str(), BM_Map<StdUnorderedMap>, dataset)
+        ->Iterations(1)
+        ->Unit(bm::kMillisecond);
+    bm::RegisterBenchmark(fmt::format("absl_btree_map/{}", name).c_str(), BM_Map<BtreeMap>, dataset)
+        ->Iterations(1)
+        ->Unit(bm::kMillisecond);
+    bm::RegisterBenchmark(fmt::format("absl_flat_hash_map/{}", name).c_str(), BM_Map<FlatHashMap>, dataset)
+        ->Iterations(1)
+        ->Unit(bm::kMillisecond);
+  }
+
+  bm::RunSpecifiedBenchmarks();
+  bm::Shutdown();
+  return 0;
+}
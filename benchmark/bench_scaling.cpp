@@ -0,0 +1,95 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+// Scaling of ConcurrentART over thread counts and read/write ratios. Each run reports the lock contention counters
+// of ConcurrentART per operation next to the throughput: spins and yields waiting for node locks, lookups and
+// inserts restarted, and those of them that went back to the root. A small key space puts every thread on the same
+// nodes, a large one spreads them.
+//
+//   bench_scaling --benchmark_filter='concurrent_art/scaling/read:90/.*'
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "concurrent_art.h"
+#include "radix.h"
+
+namespace bm = benchmark;
+using namespace part;
+
+static constexpr uint64_t SEED = 42;
+
+static std::unique_ptr<ConcurrentART> art;
+
+static inline ARTKey EncodeKey(data_t (&data)[sizeof(int64_t)], int64_t value) {
+  Radix::EncodeData<int64_t>(data, value);
+  return ARTKey(data, sizeof(int64_t));
+}
+
+//! range(0) is the percentage of reads, range(1) the number of distinct keys
+static void BM_Scaling(bm::State &state) {
+  auto read_percent = state.range(0);
+  auto key_count = state.range(1);
+  data_t data[sizeof(int64_t)];
+  ContentionStats before;
+  if (state.thread_index() == 0) {
+    art = std::make_unique<ConcurrentART>();
+    for (int64_t i = 0; i < key_count; i++) {
+      art->Put(EncodeKey(data, i), i);
+    }
+    before = ConcurrentART::GetContentionStats();
+  }
+
+  std::mt19937_64 gen(SEED + state.thread_index());
+  std::uniform_int_distribution<int64_t> keys(0, key_count - 1);
+  std::uniform_int_distribution<int64_t> percent(0, 99);
+  idx_t found;
+  idx_t doc_id = key_count + (idx_t(state.thread_index()) << 40);
+  for (auto _ : state) {
+    auto key = EncodeKey(data, keys(gen));
+    if (percent(gen) < read_percent) {
+      bm::DoNotOptimize(art->GetFirst(key, found));
+    } else {
+      art->Put(key, doc_id++);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    // NOTE: the other threads are done, the loop ends with a barrier
+    auto after = ConcurrentART::GetContentionStats();
+    auto per_op = [&](uint64_t after_value, uint64_t before_value) {
+      return bm::Counter(double(after_value - before_value), bm::Counter::kAvgIterations);
+    };
+    state.counters["rlock_spins"] = per_op(after.rlock_spins, before.rlock_spins);
+    state.counters["lock_spins"] =
+        per_op(after.lock_spins + after.upgrade_spins, before.lock_spins + before.upgrade_spins);
+    state.counters["yields"] = per_op(after.yields, before.yields);
+    state.counters["restarts"] =
+        per_op(after.get_restarts + after.put_restarts, before.get_restarts + before.put_restarts);
+    state.counters["root_restarts"] = per_op(after.root_restarts, before.root_restarts);
+    art.reset();
+  }
+}
+
+int main(int argc, char **argv) {
+  bm::Initialize(&argc, argv);
+
+  int max_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  auto benchmark = bm::RegisterBenchmark("concurrent_art/scaling", BM_Scaling)
+                       ->ArgNames({"read", "keys"})
+                       ->ArgsProduct({{0, 50, 90, 99, 100}, {1 << 10, 1 << 20}})
+                       ->Unit(bm::kMicrosecond)
+                       ->UseRealTime();
+  for (int threads = 1; threads < max_threads; threads *= 2) {
+    benchmark->Threads(threads);
+  }
+  benchmark->Threads(max_threads);
+
+  bm::RunSpecifiedBenchmarks();
+  bm::Shutdown();
+  return 0;
+}
@@ -1,67 +1,210 @@
 //
 // Created by skyitachi on 24-3-20.
 //
-#include <chrono>
-
-#include "concurrent_art.h"
-#include "util.h"
+// Serialization and open times of ART, for int32, int64 and string keys at 1M, 10M and 100M keys:
+//
+//   serialize        ART::Serialize of the whole index
+//   fast_serialize   ART::FastSerialize, a dump of the allocator buffers
+//   open             ART(path), deserializes every node
+//   open_lazy        ART(path, nullptr, NONE, true), reads the root only, so its throughput is nominal
+//   fast_open        ART(path, true), reads a FastSerialize file
+//
+// bytes_per_second and items_per_second are the throughput in file bytes and keys, bytes_per_key is the size of the
+// file. The cold variants drop the index file from the page cache before every open, as after a restart. Building a
+// dataset is not timed, and only one is kept in memory, so pick the sizes with --benchmark_filter:
+//
+//   bench_serialize --benchmark_filter='.*/int64/10000000.*'
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "arena_allocator.h"
 #include "art.h"
 
+namespace bm = benchmark;
 using namespace part;
 
-void bench_art_serialize(ART &art) {
-  auto start = std::chrono::high_resolution_clock::now();
-
-  art.Serialize();
-
-  auto end = std::chrono::high_resolution_clock::now();
+enum class KeyType : uint8_t { INT32, INT64, STRING };
 
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+static constexpr uint64_t SEED = 42;
+static constexpr idx_t STRING_KEY_LENGTH = 16;
 
-  // 输出计时结果
-  std::cout << "serialize: " << duration.count() << " 毫秒" << std::endl;
+static const char *KeyTypeName(KeyType type) {
+  switch (type) {
+    case KeyType::INT32:
+      return "int32";
+    case KeyType::INT64:
+      return "int64";
+    case KeyType::STRING:
+      return "string";
+  }
+  return "";
 }
 
-void bench_art_fast_serialize(ART &art) {
-  auto start = std::chrono::high_resolution_clock::now();
-
-  art.FastSerialize();
+//! The index of the last dataset used, rebuilt when a benchmark asks for another one
+struct Dataset {
+  KeyType type;
+  idx_t key_count;
+  std::string index_path;
+  std::unique_ptr<ART> art;
+};
 
-  auto end = std::chrono::high_resolution_clock::now();
+static std::unique_ptr<Dataset> dataset;
 
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+static std::string IndexPath(KeyType type, idx_t key_count) {
+  return fmt::format("bench_serialize_{}_{}.idx", KeyTypeName(type), key_count);
+}
 
-  // 输出计时结果
-  std::cout << "fast_serialize: " << duration.count() << " 毫秒" << std::endl;
+static void RemoveFiles(const std::string &index_path) {
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
 }
 
-int main() {
-  int limit = 1000000;
+static ART &GetDataset(KeyType type, idx_t key_count) {
+  if (dataset && dataset->type == type && dataset->key_count == key_count) {
+    return *dataset->art;
+  }
+  if (dataset) {
+    dataset->art.reset();
+    RemoveFiles(dataset->index_path);
+  }
+  dataset = std::make_unique<Dataset>();
+  dataset->type = type;
+  dataset->key_count = key_count;
+  dataset->index_path = IndexPath(type, key_count);
+  RemoveFiles(dataset->index_path);
+  dataset->art = std::make_unique<ART>(dataset->index_path);
+
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::mt19937_64 gen(SEED);
+  std::string value(STRING_KEY_LENGTH, ' ');
+  for (idx_t i = 0; i < key_count; i++) {
+    // NOTE: keys are reset with the arena, the ART copies them
+    if (i % 4096 == 0) {
+      arena_allocator.Reset();
+    }
+    switch (type) {
+      case KeyType::INT32:
+        dataset->art->Put(ARTKey::CreateARTKey<int32_t>(arena_allocator, static_cast<int32_t>(gen())), i);
+        break;
+      case KeyType::INT64:
+        dataset->art->Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, static_cast<int64_t>(gen())), i);
+        break;
+      case KeyType::STRING: {
+        // fixed length keys, so none is a prefix of another
+        auto bits = gen();
+        for (idx_t k = 0; k < STRING_KEY_LENGTH; k++) {
+          value[k] = 'a' + (bits >> (k * 4) & 0xF);
+        }
+        dataset->art->Put(ARTKey::CreateARTKey<std::string_view>(arena_allocator, value), i);
+        break;
+      }
+    }
+  }
+  return *dataset->art;
+}
 
-//  ConcurrentART cart("item_id.idx");
-  ART cart("art.idx");
+//! Rewrites the index file of the dataset from scratch, returns its size
+static idx_t WriteIndex(ART &art, bool fast_serialize) {
+  // NOTE: the serializers do not truncate, a longer earlier file would inflate the size
+  std::filesystem::resize_file(dataset->index_path, 0);
+  fast_serialize ? art.FastSerialize() : art.Serialize();
+  return std::filesystem::file_size(dataset->index_path);
+}
 
-  Allocator &allocator = Allocator::DefaultAllocator();
-  ArenaAllocator arena_allocator(allocator, 16384);
+//! Drops a file from the page cache, its dirty pages are written back first as they cannot be dropped
+static void DropFromPageCache(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  ::fsync(fd);
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
 
-  std::vector<ARTKey> keys;
+static void ReportThroughput(bm::State &state, idx_t file_size) {
+  auto key_count = dataset->key_count;
+  state.SetBytesProcessed(state.iterations() * file_size);
+  state.SetItemsProcessed(state.iterations() * key_count);
+  state.counters["bytes_per_key"] = double(file_size) / key_count;
+}
 
-  for (idx_t i = 0; i < limit; i++) {
-    keys.push_back(ARTKey::CreateARTKey<int32_t>(arena_allocator, i));
+static void BM_Serialize(bm::State &state, KeyType type, idx_t key_count, bool fast_serialize) {
+  auto &art = GetDataset(type, key_count);
+  idx_t file_size = 0;
+  for (auto _ : state) {
+    file_size = WriteIndex(art, fast_serialize);
   }
+  ReportThroughput(state, file_size);
+}
 
-  for (idx_t i = 0; i < limit; i++) {
-    cart.Put(keys[i], i);
+enum class OpenMode : uint8_t { EAGER, LAZY, FAST };
+
+static void BM_Open(bm::State &state, KeyType type, idx_t key_count, OpenMode mode, bool cold) {
+  auto &art = GetDataset(type, key_count);
+  auto index_path = dataset->index_path;
+  auto file_size = WriteIndex(art, mode == OpenMode::FAST);
+  for (auto _ : state) {
+    if (cold) {
+      state.PauseTiming();
+      DropFromPageCache(index_path);
+      DropFromPageCache(ART::FilterPath(index_path));
+      state.ResumeTiming();
+    }
+    std::unique_ptr<ART> opened;
+    switch (mode) {
+      case OpenMode::EAGER:
+        opened = std::make_unique<ART>(index_path);
+        break;
+      case OpenMode::LAZY:
+        opened = std::make_unique<ART>(index_path, nullptr, IndexConstraintType::NONE, true);
+        break;
+      case OpenMode::FAST:
+        opened = std::make_unique<ART>(index_path, true);
+        break;
+    }
+    bm::DoNotOptimize(opened->root->GetData());
+    // freeing the nodes is not part of the open
+    state.PauseTiming();
+    opened.reset();
+    state.ResumeTiming();
   }
+  ReportThroughput(state, file_size);
+}
 
-  bench_art_serialize(cart);
-
-  ART fastART("fast_art.idx");
-
-  for (idx_t i = 0; i < limit; i++) {
-    fastART.Put(keys[i], i);
+int main(int argc, char **argv) {
+  bm::Initialize(&argc, argv);
+
+  for (auto type : {KeyType::INT32, KeyType::INT64, KeyType::STRING}) {
+    for (idx_t key_count : {1000000, 10000000, 100000000}) {
+      auto suffix = fmt::format("{}/{}", KeyTypeName(type), key_count);
+      bm::RegisterBenchmark(("serialize/" + suffix).c_str(), BM_Serialize, type, key_count, false)
+          ->Unit(bm::kMillisecond);
+      bm::RegisterBenchmark(("fast_serialize/" + suffix).c_str(), BM_Serialize, type, key_count, true)
+          ->Unit(bm::kMillisecond);
+      for (auto cold : {false, true}) {
+        auto name = suffix + (cold ? "/cold" : "/warm");
+        bm::RegisterBenchmark(("open/" + name).c_str(), BM_Open, type, key_count, OpenMode::EAGER, cold)
+            ->Unit(bm::kMillisecond);
+        bm::RegisterBenchmark(("open_lazy/" + name).c_str(), BM_Open, type, key_count, OpenMode::LAZY, cold)
+            ->Unit(bm::kMillisecond);
+        bm::RegisterBenchmark(("fast_open/" + name).c_str(), BM_Open, type, key_count, OpenMode::FAST, cold)
+            ->Unit(bm::kMillisecond);
+      }
+    }
+  }
+  bm::RunSpecifiedBenchmarks();
+  bm::Shutdown();
+  if (dataset) {
+    dataset->art.reset();
+    RemoveFiles(dataset->index_path);
   }
-
-  bench_art_fast_serialize(fastART);
   return 0;
-}
\ No newline at end of file
+}
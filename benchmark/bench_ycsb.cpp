@@ -0,0 +1,372 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+// YCSB core workloads A to F on ART and ConcurrentART. Every thread draws its operations and keys from its own
+// generator with a fixed seed, so two runs issue the same operations in the same order per thread.
+//
+//   A  50% read, 50% update                   zipfian
+//   B  95% read,  5% update                   zipfian
+//   C 100% read                               zipfian
+//   D  95% read,  5% insert                   latest
+//   E  95% scan,  5% insert                   zipfian, scan length uniform in [1, MAX_SCAN_LENGTH]
+//   F  50% read, 50% read-modify-write        zipfian
+//
+// Every workload also runs with uniform keys. ART is single threaded, ConcurrentART runs from 1 up to the number of
+// cores. ConcurrentART has no scans, so E only runs on ART. Every key holds a single doc id, which an update and a
+// read-modify-write replace in place, so the work of an operation does not grow with the number of iterations.
+// Besides the ops/sec of items_per_second, p50, p99 and p999 report the latency of a single operation in ns, taken
+// over the operations of all threads and precise to the about 3% of a LatencyHistogram bucket.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "art.h"
+#include "art_iterator.h"
+#include "concurrent_art.h"
+#include "latency_histogram.h"
+#include "radix.h"
+
+namespace bm = benchmark;
+using namespace part;
+
+static constexpr idx_t RECORD_COUNT = 1000000;
+static constexpr idx_t MAX_SCAN_LENGTH = 100;
+static constexpr uint64_t SEED = 42;
+
+enum class Operation : uint8_t { READ, UPDATE, INSERT, SCAN, READ_MODIFY_WRITE };
+enum class Distribution : uint8_t { UNIFORM, ZIPFIAN, LATEST };
+
+struct Workload {
+  std::string name;
+  double read;
+  double update;
+  double insert;
+  double scan;
+  double read_modify_write;
+  Distribution distribution;
+};
+
+static const std::vector<Workload> WORKLOADS = {
+    {"A", 0.5, 0.5, 0, 0, 0, Distribution::ZIPFIAN},  {"B", 0.95, 0.05, 0, 0, 0, Distribution::ZIPFIAN},
+    {"C", 1, 0, 0, 0, 0, Distribution::ZIPFIAN},      {"D", 0.95, 0, 0.05, 0, 0, Distribution::LATEST},
+    {"E", 0, 0, 0.05, 0.95, 0, Distribution::ZIPFIAN}, {"F", 0.5, 0, 0, 0, 0.5, Distribution::ZIPFIAN},
+};
+
+static const char *DistributionName(Distribution distribution) {
+  switch (distribution) {
+    case Distribution::UNIFORM:
+      return "uniform";
+    case Distribution::ZIPFIAN:
+      return "zipfian";
+    case Distribution::LATEST:
+      return "latest";
+  }
+  return "";
+}
+
+//! The zipfian generator of YCSB (Gray et al., "Quickly generating billion-record synthetic databases"), item 0 is
+//! the most popular one
+class ZipfianGenerator {
+ public:
+  static constexpr double THETA = 0.99;
+
+  explicit ZipfianGenerator(idx_t item_count) : item_count(item_count) {
+    zeta_n = zeta(item_count);
+    alpha = 1.0 / (1.0 - THETA);
+    eta = (1 - std::pow(2.0 / item_count, 1 - THETA)) / (1 - zeta(2) / zeta_n);
+  }
+
+  template <class G>
+  idx_t Next(G &gen) {
+    auto u = std::uniform_real_distribution<double>(0, 1)(gen);
+    auto uz = u * zeta_n;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, THETA)) {
+      return 1;
+    }
+    return std::min<idx_t>(item_count - 1, item_count * std::pow(eta * u - eta + 1, alpha));
+  }
+
+ private:
+  static double zeta(idx_t n) {
+    double sum = 0;
+    for (idx_t i = 1; i <= n; i++) {
+      sum += 1 / std::pow(i, THETA);
+    }
+    return sum;
+  }
+
+  idx_t item_count;
+  double zeta_n;
+  double alpha;
+  double eta;
+};
+
+//! Scatters the record numbers over the key space, so popular records do not share a subtree
+static inline int64_t RecordKey(idx_t record) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (idx_t i = 0; i < sizeof(record); i++) {
+    hash ^= (record >> (i * 8)) & 0xFF;
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<int64_t>(hash >> 1);
+}
+
+//! The key bytes of a record, reused for every operation of a thread
+struct KeyBuffer {
+  data_t data[sizeof(int64_t)];
+
+  inline ARTKey Key(idx_t record) {
+    Radix::EncodeData<int64_t>(data, RecordKey(record));
+    return ARTKey(data, sizeof(int64_t));
+  }
+};
+
+//! Shared by the threads of one benchmark run
+struct RunState {
+  explicit RunState(const Workload &workload) : workload(workload), record_count(RECORD_COUNT) {}
+
+  const Workload &workload;
+  //! Records inserted so far, inserts append to the end of the key sequence
+  std::atomic<idx_t> record_count;
+  std::unique_ptr<ZipfianGenerator> zipfian;
+};
+
+class OperationChooser {
+ public:
+  OperationChooser(RunState &run, Distribution distribution, idx_t thread_index)
+      : run(run), distribution(distribution), gen(SEED + thread_index) {}
+
+  Operation NextOperation() {
+    auto p = std::uniform_real_distribution<double>(0, 1)(gen);
+    auto &w = run.workload;
+    if ((p -= w.read) < 0) {
+      return Operation::READ;
+    }
+    if ((p -= w.update) < 0) {
+      return Operation::UPDATE;
+    }
+    if ((p -= w.insert) < 0) {
+      return Operation::INSERT;
+    }
+    if ((p -= w.scan) < 0) {
+      return Operation::SCAN;
+    }
+    return Operation::READ_MODIFY_WRITE;
+  }
+
+  idx_t NextRecord() {
+    auto count = run.record_count.load(std::memory_order_relaxed);
+    switch (distribution) {
+      case Distribution::UNIFORM:
+        return std::uniform_int_distribution<idx_t>(0, count - 1)(gen);
+      case Distribution::ZIPFIAN:
+        // NOTE: records inserted during the run are not drawn, as the YCSB request distribution
+        return run.zipfian->Next(gen) % count;
+      case Distribution::LATEST: {
+        auto offset = run.zipfian->Next(gen);
+        return offset < count ? count - 1 - offset : count - 1;
+      }
+    }
+    return 0;
+  }
+
+  idx_t ScanLength() { return std::uniform_int_distribution<idx_t>(1, MAX_SCAN_LENGTH)(gen); }
+
+ private:
+  RunState &run;
+  Distribution distribution;
+  std::mt19937_64 gen;
+};
+
+static inline void RecordLatency(LatencyHistogram &latencies, std::chrono::steady_clock::time_point start) {
+  latencies.Record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+//! Counters are summed over the threads, so only one thread reports the percentiles of the merged histogram
+static void ReportLatencies(bm::State &state, const LatencyHistogram &latencies) {
+  if (latencies.Count() == 0) {
+    return;
+  }
+  state.counters["p50"] = double(latencies.Percentile(50));
+  state.counters["p99"] = double(latencies.Percentile(99));
+  state.counters["p999"] = double(latencies.Percentile(99.9));
+}
+
+static void LoadART(ART &art) {
+  KeyBuffer buffer;
+  for (idx_t i = 0; i < RECORD_COUNT; i++) {
+    art.Insert(buffer.Key(i), i);
+  }
+}
+
+static void LoadConcurrentART(ConcurrentART &art) {
+  KeyBuffer buffer;
+  for (idx_t i = 0; i < RECORD_COUNT; i++) {
+    art.Put(buffer.Key(i), i);
+  }
+}
+
+static void RunART(bm::State &state, const Workload &workload, Distribution distribution) {
+  RunState run(workload);
+  run.zipfian = std::make_unique<ZipfianGenerator>(RECORD_COUNT);
+  ART art(nullptr, IndexConstraintType::UNIQUE);
+  LoadART(art);
+
+  OperationChooser chooser(run, distribution, 0);
+  LatencyHistogram latencies;
+  KeyBuffer buffer;
+  std::vector<idx_t> result_ids;
+  idx_t doc_id = RECORD_COUNT;
+  for (auto _ : state) {
+    auto operation = chooser.NextOperation();
+    auto record = operation == Operation::INSERT ? run.record_count++ : chooser.NextRecord();
+    auto start = std::chrono::steady_clock::now();
+    auto key = buffer.Key(record);
+    switch (operation) {
+      case Operation::READ:
+        result_ids.clear();
+        bm::DoNotOptimize(art.Get(key, result_ids));
+        break;
+      case Operation::UPDATE:
+      case Operation::INSERT:
+        art.Upsert(key, doc_id++);
+        break;
+      case Operation::SCAN: {
+        ARTIterator it(art);
+        idx_t length = chooser.ScanLength();
+        for (bool valid = it.Seek(key); valid && length > 0; valid = it.Next(), length--) {
+          result_ids.clear();
+          it.GetDocIds(result_ids);
+        }
+        bm::DoNotOptimize(result_ids.data());
+        break;
+      }
+      case Operation::READ_MODIFY_WRITE:
+        result_ids.clear();
+        art.Get(key, result_ids);
+        art.Upsert(key, doc_id++);
+        break;
+    }
+    RecordLatency(latencies, start);
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReportLatencies(state, latencies);
+}
+
+static std::unique_ptr<ConcurrentART> concurrent_art;
+static std::unique_ptr<RunState> concurrent_run;
+
+//! The latencies of all threads of a ConcurrentART run, the first thread reports them once every thread merged its own
+static struct {
+  std::mutex lock;
+  std::condition_variable cv;
+  LatencyHistogram latencies;
+  int merged = 0;
+} concurrent_latencies;
+
+static void RunConcurrentART(bm::State &state, const Workload &workload, Distribution distribution) {
+  // NOTE: the other threads only touch the shared state inside the loop, which they enter once the first one has
+  // loaded the index
+  if (state.thread_index() == 0) {
+    concurrent_run = std::make_unique<RunState>(workload);
+    concurrent_run->zipfian = std::make_unique<ZipfianGenerator>(RECORD_COUNT);
+    concurrent_art = std::make_unique<ConcurrentART>();
+    LoadConcurrentART(*concurrent_art);
+    concurrent_latencies.latencies.Reset();
+    concurrent_latencies.merged = 0;
+  }
+
+  std::optional<OperationChooser> chooser;
+  LatencyHistogram latencies;
+  KeyBuffer buffer;
+  std::vector<idx_t> result_ids;
+  // doc ids of different threads never collide
+  idx_t doc_id = RECORD_COUNT + (idx_t(state.thread_index()) << 40);
+  for (auto _ : state) {
+    if (!chooser) {
+      chooser.emplace(*concurrent_run, distribution, state.thread_index());
+    }
+    auto operation = chooser->NextOperation();
+    auto record = operation == Operation::INSERT ? concurrent_run->record_count++ : chooser->NextRecord();
+    auto start = std::chrono::steady_clock::now();
+    auto key = buffer.Key(record);
+    switch (operation) {
+      case Operation::READ:
+        result_ids.clear();
+        bm::DoNotOptimize(concurrent_art->Get(key, result_ids));
+        break;
+      case Operation::UPDATE:
+      case Operation::INSERT:
+        concurrent_art->Upsert(key, doc_id++);
+        break;
+      case Operation::SCAN:
+        break;
+      case Operation::READ_MODIFY_WRITE:
+        result_ids.clear();
+        concurrent_art->Get(key, result_ids);
+        concurrent_art->Upsert(key, doc_id++);
+        break;
+    }
+    RecordLatency(latencies, start);
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  {
+    std::unique_lock<std::mutex> guard(concurrent_latencies.lock);
+    concurrent_latencies.latencies.Merge(latencies);
+    concurrent_latencies.merged++;
+    concurrent_latencies.cv.notify_all();
+    if (state.thread_index() == 0) {
+      concurrent_latencies.cv.wait(guard, [&] { return concurrent_latencies.merged == state.threads(); });
+      ReportLatencies(state, concurrent_latencies.latencies);
+    }
+  }
+
+  if (state.thread_index() == 0) {
+    concurrent_art.reset();
+    concurrent_run.reset();
+  }
+}
+
+int main(int argc, char **argv) {
+  bm::Initialize(&argc, argv);
+
+  auto max_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  for (auto &workload : WORKLOADS) {
+    for (auto distribution : {workload.distribution, Distribution::UNIFORM}) {
+      auto name = "ycsb_" + workload.name + "_" + DistributionName(distribution);
+      bm::RegisterBenchmark(("art/" + name).c_str(),
+                            [&workload, distribution](bm::State &state) { RunART(state, workload, distribution); })
+          ->Unit(bm::kMicrosecond)
+          ->UseRealTime();
+      if (workload.scan > 0) {
+        continue;
+      }
+      bm::RegisterBenchmark(
+          ("concurrent_art/" + name).c_str(),
+          [&workload, distribution](bm::State &state) { RunConcurrentART(state, workload, distribution); })
+          ->ThreadRange(1, max_threads)
+          ->Unit(bm::kMicrosecond)
+          ->UseRealTime();
+    }
+  }
+
+  bm::RunSpecifiedBenchmarks();
+  bm::Shutdown();
+  return 0;
+}
@@ -0,0 +1,26 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <iostream>
+
+#include "art_stream.h"
+
+using namespace part;
+
+//! Merges serialized ART files into a new one without loading them, usage: art_merge <output> <input>...
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <output> <input>..." << std::endl;
+    return 1;
+  }
+  std::vector<std::string> input_paths(argv + 2, argv + argc);
+  try {
+    auto key_count = ARTStreamWriter::MergeFiles(input_paths, argv[1]);
+    std::cout << "merged " << input_paths.size() << " indexes into " << argv[1] << ", " << key_count << " keys"
+              << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -5,6 +5,7 @@
 #ifndef PART_ART_H
 #define PART_ART_H
 #include <fstream>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -12,7 +13,9 @@
 #include "arena_allocator.h"
 #include "art_key.h"
 #include "block.h"
+#include "bloom_filter.h"
 #include "concurrent_node.h"
+#include "leaf.h"
 #include "node.h"
 #include "serializer.h"
 #include "types.h"
@@ -21,33 +24,129 @@ namespace part {
 class Node;
 class FixedSizeAllocator;
 class ARTKey;
+class TaskScheduler;
 
 template <typename T>
 using reference = std::reference_wrapper<T>;
 
+enum class IndexConstraintType : uint8_t {
+  NONE = 0,
+  //! Every key maps to exactly one doc id, which lives in the inlined leaf
+  UNIQUE = 1,
+};
+
 class ART {
  public:
-  explicit ART(const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr = nullptr);
+  explicit ART(const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr = nullptr,
+               IndexConstraintType constraint_type = IndexConstraintType::NONE);
 
+  //! lazy_load reads only the root node on open, the other nodes are deserialized on first access
   explicit ART(const std::string &index_path,
-               const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr = nullptr);
+               const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr = nullptr,
+               IndexConstraintType constraint_type = IndexConstraintType::NONE, bool lazy_load = false);
 
-  explicit ART(const std::string &index_path, bool fast_serialize);
+  explicit ART(const std::string &index_path, bool fast_serialize,
+               IndexConstraintType constraint_type = IndexConstraintType::NONE);
 
   ~ART();
   std::unique_ptr<Node> root;
   std::shared_ptr<std::vector<FixedSizeAllocator>> allocators;
   bool owns_data;
+  IndexConstraintType constraint_type;
+  //! Children read from the index file stay serialized pointers until they are accessed
+  bool lazy_load = false;
+  //! Node grows and shrinks since the index was created
+  NodeTransitionCounters transitions;
+
+  inline bool IsUnique() const { return constraint_type == IndexConstraintType::UNIQUE; }
 
   // only support int64_t value
+  // NOTE: a unique index treats Put as Insert
   void Put(const ARTKey &key, idx_t doc_id);
 
   bool Get(const ARTKey &key, std::vector<idx_t> &result_ids);
 
+  //! Whether the key holds any doc id, the leaf itself is not read
+  bool Contains(const ARTKey &key);
+  //! Reads the first doc id of the key, for posting lists longer than LEAF_SIZE that is the smallest one
+  bool GetFirst(const ARTKey &key, idx_t &doc_id);
+  //! The number of doc ids under the key, 0 if it does not exist
+  idx_t Count(const ARTKey &key);
+
+  //! Calls fn(idx_t) for every doc id under the key without copying the posting list, returns false if the key
+  //! does not exist
+  template <class F>
+  bool ForEachDocId(const ARTKey &key, F &&fn) {
+    if (!MayContain(key)) {
+      return false;
+    }
+    auto leaf = lookup(*root, key, 0);
+    if (!leaf) {
+      return false;
+    }
+    Leaf::ForEachDocId(*this, *leaf.value(), std::forward<F>(fn));
+    return true;
+  }
+
+  //! Unique index only: adds the key, throws if it already exists
+  void Insert(const ARTKey &key, idx_t doc_id);
+  //! Unique index only: adds the key or replaces its doc id
+  void Upsert(const ARTKey &key, idx_t doc_id);
+  //! Unique index only: adds the key, returns false and keeps the old doc id if it already exists
+  bool InsertIfAbsent(const ARTKey &key, idx_t doc_id);
+  //! Unique index only: reads the doc id straight from the inlined leaf
+  bool Get(const ARTKey &key, idx_t &doc_id);
+
   void Delete(const ARTKey &key, idx_t doc_id);
 
+  //! Removes every key in [lower, upper] together with all of its doc ids. Subtrees lying completely inside the range
+  //! are freed as a whole, only the paths of the two bounds are visited node by node
+  void DeleteRange(const ARTKey &lower, const ARTKey &upper);
+
+  //! Appends the doc ids present under every key in ascending order, without duplicates, and stops once
+  //! result_ids holds limit doc ids. Returns false if a key does not exist
+  bool Intersect(const std::vector<ARTKey> &keys, std::vector<idx_t> &result_ids,
+                 idx_t limit = std::numeric_limits<idx_t>::max());
+
+  //! Appends the doc ids present under any key in ascending order, without duplicates, and stops once result_ids
+  //! holds limit doc ids. Returns false if none of the keys exist
+  bool Union(const std::vector<ARTKey> &keys, std::vector<idx_t> &result_ids,
+             idx_t limit = std::numeric_limits<idx_t>::max());
+
+  //! A unique index throws before anything is merged if a key of other is already present, both trees are left as
+  //! they were then
   void Merge(ART &other);
 
+  //! Merges other with up to thread_count tasks at a time on the task scheduler of this index, when both trees branch
+  //! into inner nodes below the same prefix. The children of these nodes, and of their children while there are too
+  //! few of them, are split into independent merges under different key bytes. Both indexes must share their
+  //! allocators
+  void Merge(ART &other, idx_t thread_count);
+
+  //! Removes the doc ids of every key in deletes from this index, a delete-delta of tombstones kept next to the
+  //! delta of added doc ids. The deletes are visited in key order and only the paths of deleted keys are walked,
+  //! leaves left empty are removed and their parents shrunk on the way back. Deletes itself is left as is
+  void ApplyDeletes(ART &deletes);
+
+  //! Applies the tombstones in deletes first and merges other afterwards, so a doc id deleted and added again within
+  //! the same delta survives. The tombstones take a walk of their own rather than being applied within the merge
+  //! traversal: the merge moves subtrees only other holds without visiting them and never enters the ones only this
+  //! index holds, which is where most tombstones point to, so the extra walk only covers the paths of deleted keys.
+  //! A key of other that stays present after the deletes fails a unique index before anything is changed
+  void Merge(ART &other, ART &deletes, idx_t thread_count = 1);
+
+  //! Throws if a threshold leaves more children than the next smaller node type holds
+  void SetShrinkPolicy(const ShrinkPolicy &policy);
+  inline const ShrinkPolicy &GetShrinkPolicy() const { return shrink_policy; }
+
+  //! Shrinks every inner node held in memory with fewer children than the threshold of its type, as far down as the
+  //! thresholds allow. With deferred shrinking this is the only place nodes shrink, run it while the index is idle.
+  //! Returns the number of node type changes
+  idx_t Compact();
+
+  inline NodeTransitionStats GetTransitionStats() const { return transitions.Snapshot(); }
+  inline void ResetTransitionStats() { transitions.Reset(); }
+
   idx_t GetMemoryUsage();
 
   idx_t LeafCount();
@@ -68,8 +167,26 @@ class ART {
 
   void FastSerialize();
 
+  //! The key filter written next to the index file by Serialize and FastSerialize
+  static std::string FilterPath(const std::string &index_path);
+  //! Writes filter to FilterPath(index_path) along with the size and the first bytes of the index file, which hold
+  //! the root pointer. The index file must be complete
+  static void WriteFilter(const std::string &index_path, const BloomFilter &filter);
+  //! Returns nullptr if the index has no filter, or its filter was written for another version of the index file
+  static std::unique_ptr<BloomFilter> ReadFilter(const std::string &index_path);
+
+  //! Bits per key of the filter written on serialization, 0 writes no filter
+  inline void SetFilterBitsPerKey(idx_t bits_per_key) { filter_bits_per_key = bits_per_key; }
+  inline bool HasFilter() const { return filter != nullptr; }
+  //! False only if the key is certainly not in the index, lets lazily loaded indexes skip the traversal for misses
+  inline bool MayContain(const ARTKey &key) const { return !filter || filter->MayContain(key); }
+
   int GetIndexFileFd() { return index_fd_; }
 
+  //! The pool running the parallel maintenance work of this index, TaskScheduler::Default() unless one was set
+  TaskScheduler &GetTaskScheduler();
+  inline void SetTaskScheduler(std::shared_ptr<TaskScheduler> scheduler_p) { scheduler = std::move(scheduler_p); }
+
   void Draw(const std::string &outf) {
     std::ofstream out(outf);
     out << "digraph G {" << std::endl;
@@ -80,14 +197,36 @@ class ART {
   }
 
  private:
-  void insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &value);
-  void erase(Node &node, const ARTKey &key, idx_t depth, const idx_t &value);
+  enum class InsertMode : uint8_t { APPEND, INSERT, UPSERT, INSERT_IF_ABSENT };
+
+  //! Throws if the index is not unique or doc_id does not fit into an inlined leaf
+  void checkUnique(idx_t doc_id) const;
+  bool insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &value, InsertMode mode = InsertMode::APPEND);
+  //! Removes count doc ids from the key, a leaf left empty is removed and its parent shrunk
+  void erase(Node &node, const ARTKey &key, idx_t depth, const idx_t *doc_ids, idx_t count);
+  //! check_lower and check_upper tell whether the keys below node still share all bytes with the bound so far
+  void eraseRange(Node &node, const ARTKey &lower, const ARTKey &upper, idx_t depth, bool check_lower,
+                  bool check_upper);
   std::optional<Node *> lookup(Node node, const ARTKey &key, idx_t depth);
-  //! Insert a row ID into a leaf
-  bool insertToLeaf(Node &leaf, const idx_t row_id);
+  //! Throws if a key of other is present in this unique index and deletes, if given, does not remove its doc id
+  void checkMergeConflicts(ART &other, ART *deletes);
+  //! The merges behind the public overloads, each of which checks for conflicts exactly once before
+  void merge(ART &other);
+  void merge(ART &other, idx_t thread_count);
+  //! Insert a row ID into a leaf, returns false if the key exists and mode is INSERT_IF_ABSENT
+  bool insertToLeaf(Node &leaf, const idx_t row_id, InsertMode mode);
+  //! Builds a filter over all keys and writes it to FilterPath(index_path_)
+  void writeFilter();
+
+  std::unique_ptr<BloomFilter> filter;
+  idx_t filter_bits_per_key = BloomFilter::DEFAULT_BITS_PER_KEY;
+
+  std::shared_ptr<TaskScheduler> scheduler;
+
+  ShrinkPolicy shrink_policy;
 
-  int metadata_fd_;
-  int index_fd_;
+  int metadata_fd_ = -1;
+  int index_fd_ = -1;
   std::string index_path_;
 };
 
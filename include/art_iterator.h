@@ -0,0 +1,64 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_ART_ITERATOR_H
+#define PART_ART_ITERATOR_H
+#include <vector>
+
+#include "art.h"
+#include "art_key.h"
+#include "node.h"
+
+namespace part {
+
+//! Walks the keys of an ART in ascending byte order. Lazily loaded nodes are deserialized on the way, the tree must
+//! not be modified while an iterator is positioned on it
+class ARTIterator {
+ public:
+  explicit ARTIterator(ART &art);
+
+  //! Positions the iterator on the smallest key, returns false if the tree is empty
+  bool SeekToFirst();
+  //! Positions the iterator on the first key not smaller than lower, returns false if there is none
+  bool Seek(const ARTKey &lower);
+  //! Moves to the next key, returns false once the iterator is exhausted
+  bool Next();
+
+  inline bool Valid() const { return leaf != nullptr; }
+
+  //! The current key, it stays valid until the iterator moves
+  inline ARTKey Key() { return ARTKey(key.data(), key.size()); }
+  //! The leaf of the current key, a LEAF or LEAF_INLINED node
+  inline Node &LeafNode() {
+    assert(Valid());
+    return *leaf;
+  }
+  //! Appends the doc ids of the current key
+  bool GetDocIds(std::vector<idx_t> &result_ids);
+
+ private:
+  struct Frame {
+    //! An inner node and the byte of the child the iterator is in
+    Node *node;
+    uint8_t byte;
+    //! The key length up to this node
+    idx_t depth;
+  };
+
+  //! Descends to the smallest key below node
+  void descendLeftmost(Node *node);
+  //! Moves to the smallest key after the subtree at the top of the stack
+  bool advance();
+  //! Deserializes node and appends the bytes of all its prefixes, returns the first non-prefix node
+  Node *skipPrefixes(Node *node);
+
+  ART &art;
+  std::vector<Frame> stack;
+  std::vector<data_t> key;
+  Node *leaf;
+};
+
+}  // namespace part
+
+#endif  // PART_ART_ITERATOR_H
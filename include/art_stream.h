@@ -0,0 +1,127 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_ART_STREAM_H
+#define PART_ART_STREAM_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "art_key.h"
+#include "block.h"
+#include "bloom_filter.h"
+#include "node.h"
+#include "serializer.h"
+#include "types.h"
+
+namespace part {
+
+//! Reads the keys of a file written by ART::Serialize in ascending order straight from disk. Nodes are decoded into
+//! a small stack instead of the ART allocators, so memory stays bounded by the depth of the tree whatever the size
+//! of the file. The FastSerialize format is not supported.
+class ARTStreamReader {
+ public:
+  explicit ARTStreamReader(const std::string &index_path);
+  ~ARTStreamReader();
+
+  ARTStreamReader(const ARTStreamReader &) = delete;
+  ARTStreamReader &operator=(const ARTStreamReader &) = delete;
+
+  //! Positions the reader on the smallest key, returns false if the index is empty
+  bool SeekToFirst();
+  //! Moves to the next key, returns false once the reader is exhausted
+  bool Next();
+
+  inline bool Valid() const { return valid; }
+  //! The current key, it stays valid until the reader moves
+  inline ARTKey Key() { return ARTKey(key.data(), key.size()); }
+  //! The doc ids of the current key in the order they were serialized
+  inline const std::vector<idx_t> &DocIds() const { return doc_ids; }
+
+ private:
+  struct Frame {
+    //! The children of an inner node in ascending byte order
+    std::vector<std::pair<uint8_t, BlockPointer>> children;
+    idx_t pos;
+    //! The key length up to this node
+    idx_t depth;
+  };
+
+  //! Reads size bytes at pointer, the result stays valid until the next read
+  const_data_ptr_t read(BlockPointer pointer, idx_t size);
+  //! Follows prefixes and the first children down to the next leaf
+  void descend(BlockPointer pointer);
+  bool advance();
+
+  //! Reads are served from a window of the file, nodes of one subtree lie next to each other
+  static constexpr idx_t WINDOW_SIZE = 64 * 1024;
+
+  int fd;
+  std::string index_path;
+  std::vector<data_t> buffer;
+  idx_t buffer_offset;
+  idx_t buffer_size;
+  std::vector<Frame> stack;
+  std::vector<data_t> key;
+  std::vector<idx_t> doc_ids;
+  bool valid;
+};
+
+//! Writes a serialized ART from keys arriving in ascending order, in one sequential pass. Only the nodes on the path
+//! of the last key are kept in memory, each node is written once all of its keys are known. The result has the
+//! ART::Serialize format, including the key filter, and can be opened with ART(index_path).
+class ARTStreamWriter {
+ public:
+  //! expected_keys sizes the key filter upfront, 0 collects one hash per key and sizes it at Finish
+  explicit ARTStreamWriter(const std::string &index_path, idx_t expected_keys = 0,
+                           idx_t bits_per_key = BloomFilter::DEFAULT_BITS_PER_KEY);
+
+  //! Keys must be strictly ascending and none may be a prefix of another, as in any ART
+  void Append(const ARTKey &key, const std::vector<idx_t> &doc_ids);
+  //! Writes the remaining nodes, the root pointer and the key filter
+  void Finish();
+
+  inline idx_t KeyCount() const { return key_count; }
+
+  //! Merges the serialized indexes at input_paths into output_path with bounded memory. Doc ids of a key present
+  //! in several inputs are concatenated in input order. Returns the number of keys written
+  static idx_t MergeFiles(const std::vector<std::string> &input_paths, const std::string &output_path,
+                          idx_t bits_per_key = BloomFilter::DEFAULT_BITS_PER_KEY);
+
+ private:
+  struct OpenNode {
+    //! The key position this node branches on
+    idx_t depth;
+    std::vector<std::pair<uint8_t, BlockPointer>> children;
+  };
+
+  //! A written subtree whose first non-prefix node sits at depth of the last key
+  struct Pending {
+    BlockPointer pointer;
+    idx_t depth;
+  };
+
+  //! Writes the bytes of the last key between start and pending.depth as a prefix in front of pending
+  BlockPointer attach(const Pending &pending, idx_t start);
+  BlockPointer writeLeaf(const std::vector<idx_t> &doc_ids);
+  BlockPointer writeInner(const OpenNode &node);
+  void writePointer(const BlockPointer &pointer);
+
+  std::string index_path;
+  std::unique_ptr<SequentialSerializer> writer;
+  std::vector<OpenNode> stack;
+  Pending pending;
+  std::vector<data_t> last_key;
+  idx_t key_count;
+  bool finished;
+
+  idx_t bits_per_key;
+  std::unique_ptr<BloomFilter> filter;
+  //! Only used without expected_keys
+  std::vector<uint64_t> hashes;
+};
+
+}  // namespace part
+
+#endif  // PART_ART_STREAM_H
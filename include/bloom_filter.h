@@ -0,0 +1,56 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_BLOOM_FILTER_H
+#define PART_BLOOM_FILTER_H
+#include <vector>
+
+#include "art_key.h"
+#include "serializer.h"
+#include "types.h"
+
+namespace part {
+
+//! A blocked Bloom filter over full keys. All probes of a key fall into one 64 byte block, so a lookup costs a
+//! single cache miss. A default constructed filter is empty and matches every key
+class BloomFilter {
+ public:
+  static constexpr idx_t DEFAULT_BITS_PER_KEY = 10;
+  static constexpr idx_t BLOCK_BITS = 512;
+  static constexpr idx_t WORDS_PER_BLOCK = BLOCK_BITS / 64;
+
+  BloomFilter() = default;
+  explicit BloomFilter(idx_t expected_keys, idx_t bits_per_key = DEFAULT_BITS_PER_KEY);
+
+  static uint64_t Hash(const ARTKey &key);
+
+  inline void Add(const ARTKey &key) { AddHash(Hash(key)); }
+  //! Never returns false for a key that was added
+  inline bool MayContain(const ARTKey &key) const { return MayContainHash(Hash(key)); }
+
+  void AddHash(uint64_t hash);
+  bool MayContainHash(uint64_t hash) const;
+
+  inline bool IsEmpty() const { return words.empty(); }
+  //! The filter was sized for capacity keys, at twice as many the false positive rate is up from about 1% to 8%
+  inline bool IsFull() const { return count > 2 * capacity; }
+  inline idx_t Capacity() const { return capacity; }
+  inline idx_t GetMemoryUsage() const { return words.size() * sizeof(uint64_t); }
+
+  void Serialize(Serializer &writer) const;
+  static BloomFilter Deserialize(Deserializer &reader);
+
+ private:
+  const uint64_t *block(uint64_t hash) const;
+
+  uint32_t probe_count = 0;
+  idx_t capacity = 0;
+  //! The number of added keys, duplicates included
+  idx_t count = 0;
+  std::vector<uint64_t> words;
+};
+
+}  // namespace part
+
+#endif  // PART_BLOOM_FILTER_H
@@ -0,0 +1,109 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_BUFFERED_CONCURRENT_ART_H
+#define PART_BUFFERED_CONCURRENT_ART_H
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "art.h"
+#include "art_key.h"
+#include "concurrent_art.h"
+#include "task_scheduler.h"
+#include "types.h"
+
+namespace part {
+
+//! Bulk ingest front end of a ConcurrentART. Every writer fills its own private ART memtable without taking any
+//! lock, full memtables are queued and tasks on the scheduler merge them into the concurrent tree with
+//! ConcurrentART::Merge, one at a time. Readers see the concurrent tree plus every queued memtable, doc ids still
+//! sitting in the memtable of a writer become visible once that memtable is handed over.
+class BufferedConcurrentART {
+ public:
+  //! The number of Puts after which a writer hands its memtable over to the merger
+  static constexpr idx_t DEFAULT_MEMTABLE_LIMIT = 1 << 16;
+  //! Writers block once this many memtables wait for the merger
+  static constexpr idx_t DEFAULT_MAX_PENDING = 4;
+
+  //! A single threaded handle owning one memtable, every writer thread needs its own Writer
+  class Writer {
+   public:
+    explicit Writer(BufferedConcurrentART &owner);
+    //! Hands the remaining doc ids over to the merger
+    ~Writer();
+
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    void Put(const ARTKey &key, idx_t doc_id);
+    //! Hands the current memtable over to the merger, even if it is not full yet
+    void Flush();
+
+   private:
+    BufferedConcurrentART &owner;
+    std::unique_ptr<ART> memtable;
+    idx_t count;
+  };
+
+  //! Merges run on scheduler, TaskScheduler::Default() if none is given
+  explicit BufferedConcurrentART(ConcurrentART &cart, idx_t memtable_limit = DEFAULT_MEMTABLE_LIMIT,
+                                 idx_t max_pending = DEFAULT_MAX_PENDING,
+                                 std::shared_ptr<TaskScheduler> scheduler = nullptr);
+  //! Merges all queued memtables, writers must be destroyed before
+  ~BufferedConcurrentART() = default;
+
+  BufferedConcurrentART(const BufferedConcurrentART &) = delete;
+  BufferedConcurrentART &operator=(const BufferedConcurrentART &) = delete;
+
+  std::unique_ptr<Writer> NewWriter();
+
+  //! Appends the doc ids of the concurrent tree and of all queued memtables, a doc id put twice is reported twice
+  //! whether its memtable is merged or not
+  bool Get(const ARTKey &key, std::vector<idx_t> &result_ids);
+
+  //! Blocks until every memtable handed over so far is merged into the concurrent tree, rethrows the error of a
+  //! failed merge
+  void WaitMerged();
+
+  idx_t PendingCount();
+  //! The number of memtables merged since construction
+  idx_t MergedCount();
+
+  inline ConcurrentART &GetConcurrentART() { return cart; }
+
+ private:
+  struct Memtable {
+    std::unique_ptr<ART> art;
+    // NOTE: ConcurrentART::Merge restructures the merged ART, so readers must not walk it at the same time
+    std::shared_mutex lock;
+    bool merged = false;
+  };
+
+  //! Queues a full memtable and a task merging it, blocks while max_pending memtables are waiting
+  void handOff(std::unique_ptr<ART> memtable);
+  //! Merges the oldest queued memtable
+  void mergeFront();
+
+  ConcurrentART &cart;
+  idx_t memtable_limit;
+  idx_t max_pending;
+
+  std::mutex lock;
+  std::condition_variable merged_cv;
+  // NOTE: readers copy the queue, so a memtable stays alive until the last reader is done with it
+  std::deque<std::shared_ptr<Memtable>> pending;
+  idx_t merged_count;
+
+  std::shared_ptr<TaskScheduler> scheduler;
+  // NOTE: declared last, destroying the group merges the queued memtables before any other member goes away
+  TaskGroup merges;
+};
+
+}  // namespace part
+
+#endif  // PART_BUFFERED_CONCURRENT_ART_H
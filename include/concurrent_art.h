@@ -4,7 +4,9 @@
 
 #ifndef PART_CONCURRENT_ART_H
 #define PART_CONCURRENT_ART_H
+#include <atomic>
 #include <fstream>
+#include <limits>
 #include <list>
 #include <memory>
 #include <vector>
@@ -38,7 +40,18 @@ class ConcurrentART {
 
   bool Get(const ARTKey &key, std::vector<idx_t> &result_ids);
 
+  //! Whether the key holds any doc id, stops at the first doc id of the leaf
+  bool Contains(const ARTKey &key);
+  //! Reads the first doc id of the key without walking the rest of the leaf chain
+  bool GetFirst(const ARTKey &key, idx_t &doc_id);
+
   void Put(const ARTKey &key, idx_t doc_id);
+  //! Replaces all doc ids of the key by doc_id, adds the key if it is missing
+  void Upsert(const ARTKey &key, idx_t doc_id);
+
+  //! Lock spins, yields and restarts of all ConcurrentART instances since the last reset
+  static ContentionStats GetContentionStats();
+  static void ResetContentionStats();
 
   BlockPointer ReadMetadata() const;
 
@@ -66,17 +79,40 @@ class ConcurrentART {
   void UpdateMetadata(BlockPointer pointer, Serializer &writer);
 
  private:
-  bool lookup(ConcurrentNode *node, const ARTKey &key, idx_t depth, std::vector<idx_t> &result_ids);
-  // if need retry
-  bool insert(ConcurrentNode &node, const ARTKey &key, idx_t depth, const idx_t &doc_id);
-
-  bool insertToLeaf(ConcurrentNode *leaf, idx_t doc_id);
+  //! The deepest inner node a lookup or insert passed, a retry resumes from it instead of from the root. An inner
+  //! node keeps its depth until it is deleted, only Merge moves subtrees without marking them deleted
+  struct RestartPoint {
+    ConcurrentNode *node = nullptr;
+    idx_t depth = 0;
+    //! merge_epoch_ when the attempt began, INVALID_INDEX if a merge was running
+    idx_t epoch = INVALID_INDEX;
+  };
+
+  //! Read locks the node the next attempt starts from: the restart point if it is still an inner node and no merge
+  //! began since it was taken, the root otherwise
+  ConcurrentNode *lockRestartNode(RestartPoint &restart, idx_t &depth);
+
+  bool get(const ARTKey &key, std::vector<idx_t> &result_ids, idx_t max_count);
+  void put(const ARTKey &key, idx_t doc_id, bool replace);
+
+  // NOTE: node is read locked by the caller, returns whether a retry is needed
+  bool lookup(ConcurrentNode *node, const ARTKey &key, idx_t depth, std::vector<idx_t> &result_ids,
+              RestartPoint &restart, idx_t max_count = std::numeric_limits<idx_t>::max());
+  // if need retry, with replace the doc ids of an existing key are replaced by doc_id
+  bool insert(ConcurrentNode &node, const ARTKey &key, idx_t depth, const idx_t &doc_id, RestartPoint &restart,
+              bool replace = false);
+
+  bool insertToLeaf(ConcurrentNode *leaf, idx_t doc_id, bool replace);
 
   int metadata_fd_ = -1;
   int index_fd_ = -1;
   std::string index_path_;
 
   std::list<ConcurrentNode *> node_allocators_;
+
+  //! Bumped when a merge begins and ends, restart points do not outlive a merge
+  std::atomic<idx_t> merge_epoch_ = {0};
+  std::atomic<idx_t> active_merges_ = {0};
 };
 }  // namespace part
 #endif  // PART_CONCURRENT_ART_H
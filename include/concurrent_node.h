@@ -14,6 +14,40 @@ namespace part {
 class ConcurrentART;
 class Prefix;
 
+//! A snapshot of the lock contention counters of ConcurrentART
+struct ContentionStats {
+  //! Failed attempts to take a node lock, by lock mode
+  uint64_t rlock_spins = 0;
+  uint64_t lock_spins = 0;
+  uint64_t upgrade_spins = 0;
+  uint64_t unlock_spins = 0;
+  //! Times a spinning thread gave up its time slice
+  uint64_t yields = 0;
+  //! Lookups and inserts that ran into a node changed under them and started over
+  uint64_t get_restarts = 0;
+  uint64_t put_restarts = 0;
+  //! Restarts of either that went back to the root, the others resumed from an inner node passed on the way down
+  uint64_t root_restarts = 0;
+};
+
+//! Process wide contention counters shared by all ConcurrentART instances. They are only updated once a thread had
+//! to wait, an uncontended lock stays a single compare exchange.
+struct ContentionCounters {
+  std::atomic<uint64_t> rlock_spins = {0};
+  std::atomic<uint64_t> lock_spins = {0};
+  std::atomic<uint64_t> upgrade_spins = {0};
+  std::atomic<uint64_t> unlock_spins = {0};
+  std::atomic<uint64_t> yields = {0};
+  std::atomic<uint64_t> get_restarts = {0};
+  std::atomic<uint64_t> put_restarts = {0};
+  std::atomic<uint64_t> root_restarts = {0};
+
+  static ContentionCounters &Global();
+
+  ContentionStats Snapshot() const;
+  void Reset();
+};
+
 // NOTE: 1. node cannot be serialized when accessed, different from Node (currently for simplicity)
 class ConcurrentNode : public Node {
  public:
@@ -0,0 +1,121 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_FIXED_KEY_ART_H
+#define PART_FIXED_KEY_ART_H
+#include <limits>
+#include <type_traits>
+
+#include "art.h"
+#include "leaf.h"
+#include "prefix.h"
+
+namespace part {
+
+//! ART specialized for fixed-width integer keys. The key is kept as an order-preserving unsigned integer in a
+//! register and its bytes are extracted by shifting, so neither Put nor Get touches an ArenaAllocator.
+//! Nodes and allocators are shared with the generic ART, so trees can be merged and serialized as usual.
+//! The ARTKey overloads of ART are hidden, every key of the tree has KEY_LEN bytes. Trees built through the ART
+//! interface must keep to this as well.
+template <class T>
+class FixedKeyART : public ART {
+  static_assert(std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> || std::is_same_v<T, int64_t> ||
+                    std::is_same_v<T, uint64_t>,
+                "FixedKeyART only supports int32_t, uint32_t, int64_t and uint64_t keys");
+
+ public:
+  using encoded_t = std::make_unsigned_t<T>;
+
+  //! Every key has exactly KEY_LEN bytes, which is also the maximum depth of the tree
+  static constexpr uint32_t KEY_LEN = sizeof(T);
+
+  using ART::ART;
+
+  //! Same byte order as Radix::EncodeData<T>: big endian with the sign bit flipped for signed types
+  static inline encoded_t Encode(T value) {
+    auto encoded = static_cast<encoded_t>(value);
+    if constexpr (std::is_signed_v<T>) {
+      encoded ^= encoded_t(1) << (KEY_LEN * 8 - 1);
+    }
+    return encoded;
+  }
+
+  static inline uint8_t ByteAt(encoded_t encoded, idx_t depth) {
+    assert(depth < KEY_LEN);
+    return static_cast<uint8_t>(encoded >> ((KEY_LEN - 1 - depth) * 8));
+  }
+
+  void Put(T key, idx_t doc_id) {
+    data_t data[KEY_LEN];
+    Radix::EncodeData<T>(data, key);
+    ART::Put(ARTKey(data, KEY_LEN), doc_id);
+  }
+
+  bool Get(T key, std::vector<idx_t> &result_ids) {
+    if (HasFilter()) {
+      data_t data[KEY_LEN];
+      Radix::EncodeData<T>(data, key);
+      if (!MayContain(ARTKey(data, KEY_LEN))) {
+        return false;
+      }
+    }
+    auto leaf = lookup(Encode(key));
+    if (!leaf) {
+      return false;
+    }
+    return Leaf::GetDocIds(*this, *leaf.value(), result_ids, std::numeric_limits<idx_t>::max());
+  }
+
+  void Delete(T key, idx_t doc_id) {
+    data_t data[KEY_LEN];
+    Radix::EncodeData<T>(data, key);
+    ART::Delete(ARTKey(data, KEY_LEN), doc_id);
+  }
+
+ private:
+  std::optional<Node *> lookup(const encoded_t encoded) {
+    auto next_node = std::ref(*root);
+    idx_t depth = 0;
+
+    while (next_node.get().IsSet()) {
+      if (next_node.get().IsSerialized()) {
+        next_node.get().Deserialize(*this);
+      }
+
+      while (next_node.get().GetType() == NType::PREFIX) {
+        auto &prefix = Prefix::Get(*this, next_node);
+        for (idx_t i = 0; i < prefix.data[Node::PREFIX_SIZE]; i++) {
+          // NOTE: a longer key of a tree built through ART never matches
+          if (depth >= KEY_LEN || prefix.data[i] != ByteAt(encoded, depth)) {
+            return std::nullopt;
+          }
+          depth++;
+        }
+        next_node = prefix.ptr;
+        if (next_node.get().IsSerialized()) {
+          next_node.get().Deserialize(*this);
+        }
+      }
+
+      if (next_node.get().GetType() == NType::LEAF || next_node.get().GetType() == NType::LEAF_INLINED) {
+        return &next_node.get();
+      }
+
+      if (depth >= KEY_LEN) {
+        return std::nullopt;
+      }
+      auto child = next_node.get().GetChild(*this, ByteAt(encoded, depth));
+      if (!child) {
+        return std::nullopt;
+      }
+      next_node = *child.value();
+      depth++;
+    }
+    return std::nullopt;
+  }
+};
+
+}  // namespace part
+
+#endif  // PART_FIXED_KEY_ART_H
@@ -4,6 +4,11 @@
 
 #ifndef PART_FIXED_SIZE_ALLOCATOR_H
 #define PART_FIXED_SIZE_ALLOCATOR_H
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 
@@ -14,13 +19,48 @@
 
 namespace part {
 
+class AllocatorCache;
+
 struct BufferEntry {
+  BufferEntry() : ptr(nullptr), allocation_count(0) {}
   BufferEntry(const data_ptr_t &ptr, const idx_t &allocation_count) : ptr(ptr), allocation_count(allocation_count) {}
 
   data_ptr_t ptr;
   idx_t allocation_count;
 };
 
+//! The buffer list of an allocator. Its entries live in chunks that double in size and never move, so an
+//! AllocatorCache may append under lock while readers on other threads index into the list without it
+class BufferTable {
+ public:
+  BufferTable() = default;
+  BufferTable(const BufferTable &other);
+  BufferTable &operator=(const BufferTable &other) = delete;
+
+  inline idx_t size() const { return count.load(std::memory_order_acquire); }
+  inline bool empty() const { return size() == 0; }
+
+  inline BufferEntry &operator[](idx_t index) const {
+    auto position = index + FIRST_CHUNK_SIZE;
+    auto chunk = std::bit_width(position) - 1 - FIRST_CHUNK_BITS;
+    return chunks[chunk][position - (idx_t(FIRST_CHUNK_SIZE) << chunk)];
+  }
+  inline BufferEntry &back() const { return (*this)[size() - 1]; }
+
+  void emplace_back(data_ptr_t ptr, idx_t allocation_count);
+  //! Keeps the chunks, they are reused by the next buffers
+  inline void pop_back() { count.store(size() - 1, std::memory_order_release); }
+
+ private:
+  static constexpr idx_t FIRST_CHUNK_BITS = 4;
+  static constexpr idx_t FIRST_CHUNK_SIZE = idx_t(1) << FIRST_CHUNK_BITS;
+  //! Enough chunks for every buffer id of a Node
+  static constexpr idx_t MAX_CHUNKS = 32 - FIRST_CHUNK_BITS;
+
+  std::array<std::unique_ptr<BufferEntry[]>, MAX_CHUNKS> chunks;
+  std::atomic<idx_t> count = {0};
+};
+
 class FixedSizeAllocator {
  public:
   //! Fixed size of the buffers
@@ -44,10 +84,13 @@ class FixedSizeAllocator {
   idx_t allocation_offset;
   idx_t allocations_per_buffer;
 
-  std::vector<BufferEntry> buffers;
+  BufferTable buffers;
   std::unordered_set<idx_t> buffers_with_free_space;
   Allocator &allocator;
 
+  //! While set, New and Free of the allocators the cache covers go through it
+  static thread_local AllocatorCache *thread_cache;
+
  public:
   Node New();
 
@@ -79,6 +122,9 @@ class FixedSizeAllocator {
 
   void Reset();
 
+  //! Returns the memory of empty buffers at the end of the buffer list, the ids of all other buffers stay valid
+  void ReleaseEmptyBuffers();
+
   inline idx_t GetMemoryUsage() const { return buffers.size() * BUFFER_ALLOC_SIZE; }
 
   uint32_t GetOffset(ValidityMask &mask, idx_t allocation_count);
@@ -91,6 +137,53 @@ class FixedSizeAllocator {
   }
 
   void initMaskData();
+
+  Node newNode();
+  void freeNode(const Node ptr);
+
+  friend class AllocatorCache;
+};
+
+//! A per thread stash of free slots of a shared allocator list, used by threads that build nodes in disjoint
+//! subtrees of the same ART. Slots are taken from and given back to the shared allocators in batches under lock, so
+//! the threads rarely contend.
+class AllocatorCache {
+ public:
+  static constexpr idx_t BATCH_SIZE = 64;
+
+  AllocatorCache(std::vector<FixedSizeAllocator> &allocators, std::mutex &lock);
+  //! Returns all cached slots to the shared allocators
+  ~AllocatorCache();
+
+  AllocatorCache(const AllocatorCache &) = delete;
+  AllocatorCache &operator=(const AllocatorCache &) = delete;
+
+  inline bool Covers(const FixedSizeAllocator &allocator) const {
+    return &allocator >= allocators.data() && &allocator < allocators.data() + allocators.size();
+  }
+
+  Node New(FixedSizeAllocator &allocator);
+  void Free(FixedSizeAllocator &allocator, const Node ptr);
+
+ private:
+  void release(idx_t index, idx_t count);
+
+  std::vector<FixedSizeAllocator> &allocators;
+  std::mutex &lock;
+  //! Free slots per allocator
+  std::vector<std::vector<Node>> slots;
+};
+
+//! Installs cache on the current thread for the lifetime of the guard
+class AllocatorCacheGuard {
+ public:
+  explicit AllocatorCacheGuard(AllocatorCache &cache) : previous(FixedSizeAllocator::thread_cache) {
+    FixedSizeAllocator::thread_cache = &cache;
+  }
+  ~AllocatorCacheGuard() { FixedSizeAllocator::thread_cache = previous; }
+
+ private:
+  AllocatorCache *previous;
 };
 }  // namespace part
 #endif  // PART_FIXED_SIZE_ALLOCATOR_H
@@ -0,0 +1,157 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_LATENCY_HISTOGRAM_H
+#define PART_LATENCY_HISTOGRAM_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "types.h"
+
+namespace part {
+
+struct LatencyRegistry;
+
+//! A histogram of latencies in ns with log-linear buckets as in HdrHistogram: values below 2^SUB_BUCKET_BITS have a
+//! bucket each, every larger power of two is split into 2^(SUB_BUCKET_BITS - 1) buckets, so a value is known to
+//! within 1 / 2^(SUB_BUCKET_BITS - 1), about 3%. Values above MAX_VALUE count as MAX_VALUE.
+class LatencyHistogram {
+ public:
+  static constexpr idx_t SUB_BUCKET_BITS = 6;
+  static constexpr idx_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  static constexpr idx_t HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+  //! About 18 minutes
+  static constexpr idx_t MAX_VALUE_BITS = 40;
+  static constexpr uint64_t MAX_VALUE = (uint64_t(1) << MAX_VALUE_BITS) - 1;
+  static constexpr idx_t BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT;
+
+  void Record(uint64_t value, uint64_t count = 1);
+  void Merge(const LatencyHistogram &other);
+  void Reset();
+
+  inline uint64_t Count() const { return total_count; }
+  inline uint64_t Min() const { return total_count ? min : 0; }
+  inline uint64_t Max() const { return max; }
+  double Mean() const;
+  //! The smallest value that percentile of the recorded values are less than or equal to, up to the bucket precision.
+  //! percentile is in [0, 100]
+  uint64_t Percentile(double percentile) const;
+
+  inline uint64_t BucketCount(idx_t bucket) const { return counts[bucket]; }
+
+  static idx_t BucketIndex(uint64_t value);
+  //! The smallest and the largest value of a bucket
+  static uint64_t BucketLowerBound(idx_t bucket);
+  static uint64_t BucketUpperBound(idx_t bucket);
+
+ private:
+  std::array<uint64_t, BUCKET_COUNT> counts = {};
+  uint64_t total_count = 0;
+  uint64_t sum = 0;
+  uint64_t min = UINT64_MAX;
+  uint64_t max = 0;
+};
+
+//! The operations timed by LatencyMetrics
+enum class IndexOperation : uint8_t {
+  PUT,
+  GET,
+  DELETE,
+  MERGE,
+  SERIALIZE,
+  //! A Node::Deserialize, including the nodes loaded with it by an eager load
+  DESERIALIZE_NODE,
+};
+
+static constexpr idx_t INDEX_OPERATION_COUNT = static_cast<idx_t>(IndexOperation::DESERIALIZE_NODE) + 1;
+
+//! Process wide latency histograms of the index operations of ART and ConcurrentART. Every thread records into its
+//! own histograms, Snapshot merges them. Recording is off until a sample rate is set.
+class LatencyMetrics {
+ public:
+  //! Times one in sample_rate calls of every operation on each thread, 0 turns recording off
+  static void SetSampleRate(idx_t sample_rate);
+  static inline idx_t SampleRate() { return sample_rate.load(std::memory_order_relaxed); }
+
+  static LatencyHistogram Snapshot(IndexOperation operation);
+  //! Latencies recorded by threads at the same time may survive the reset
+  static void Reset();
+
+ private:
+  friend class ScopedLatency;
+  friend struct LatencyRegistry;
+
+  struct ThreadHistograms {
+    ThreadHistograms();
+    //! Hands the histograms of an exiting thread over to the process totals
+    ~ThreadHistograms();
+
+    //! Only taken to record a sample or to read the histograms, it is uncontended on the hot path
+    std::mutex lock;
+    std::array<LatencyHistogram, INDEX_OPERATION_COUNT> histograms;
+    //! Operations in progress on the thread, a nested call of the same operation is part of the outer one
+    std::array<idx_t, INDEX_OPERATION_COUNT> depth = {};
+    std::array<idx_t, INDEX_OPERATION_COUNT> calls = {};
+  };
+
+  static ThreadHistograms &Local() {
+    // NOTE: allocated on first use, threads that never record do not carry the histograms
+    static thread_local std::unique_ptr<ThreadHistograms> histograms;
+    if (!histograms) {
+      histograms = std::make_unique<ThreadHistograms>();
+    }
+    return *histograms;
+  }
+
+  static void record(ThreadHistograms &local, IndexOperation operation, uint64_t nanos);
+
+  static std::atomic<idx_t> sample_rate;
+};
+
+//! Times the enclosing scope as one call of operation, if it is sampled
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(IndexOperation operation) : operation(operation), local(nullptr), sampled(false) {
+    auto rate = LatencyMetrics::SampleRate();
+    if (rate == 0) {
+      return;
+    }
+    local = &LatencyMetrics::Local();
+    auto index = static_cast<idx_t>(operation);
+    if (local->depth[index]++ > 0) {
+      return;
+    }
+    if (++local->calls[index] % rate == 0) {
+      sampled = true;
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedLatency() {
+    if (!local) {
+      return;
+    }
+    local->depth[static_cast<idx_t>(operation)]--;
+    if (sampled) {
+      auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      LatencyMetrics::record(*local, operation, nanos.count());
+    }
+  }
+
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+ private:
+  IndexOperation operation;
+  LatencyMetrics::ThreadHistograms *local;
+  bool sampled;
+  std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace part
+
+#endif  // PART_LATENCY_HISTOGRAM_H
@@ -4,6 +4,7 @@
 
 #ifndef PART_LEAF_H
 #define PART_LEAF_H
+#include <functional>
 #include <vector>
 
 #include "concurrent_art.h"
@@ -14,13 +15,152 @@
 
 namespace part {
 
+//! A fixed-size slab holding a sorted run of doc ids. The first doc id is kept as is, the following ones are
+//! stored as varint encoded deltas to their predecessor. Large posting lists are a chain of segments ordered by
+//! doc id, so a dense list takes one or two bytes per doc id instead of a whole idx_t.
+class LeafSegment {
+ public:
+  static constexpr idx_t SEGMENT_SIZE = 256;
+  static constexpr idx_t DATA_SIZE = SEGMENT_SIZE - 4 * sizeof(idx_t);
+  //! Every delta takes at least one byte
+  static constexpr idx_t MAX_COUNT = DATA_SIZE + 1;
+
+  static LeafSegment &New(ART &art, Node &node);
+
+  static inline LeafSegment &Get(const ART &art, const Node ptr) {
+    assert(!ptr.IsSerialized());
+    return *Node::GetAllocator(art, NType::LEAF_SEGMENT).Get<LeafSegment>(ptr);
+  }
+
+  //! Decodes all doc ids of this segment into doc_ids, which must have room for MAX_COUNT doc ids
+  idx_t Decode(idx_t *doc_ids) const;
+  //! Encodes the longest prefix of the sorted doc_ids fitting into byte_budget, returns the number of encoded ids
+  idx_t Encode(const idx_t *doc_ids, idx_t doc_count, idx_t byte_budget = DATA_SIZE);
+  //! Appends a doc id which is not smaller than last, returns false if the segment is full
+  bool Append(idx_t doc_id);
+
+ public:
+  //! The number of doc ids in this segment
+  uint16_t count;
+  //! The number of used bytes in data
+  uint16_t size;
+  //! The smallest and the largest doc id of this segment
+  idx_t first;
+  idx_t last;
+  //! A pointer to the next LEAF_SEGMENT node
+  Node ptr;
+  //! Varint encoded deltas of all doc ids but the first
+  data_t data[DATA_SIZE];
+};
+
+//! A roaring style bitmap container covering the CONTAINER_SIZE doc ids that share the same high bits. Dense posting
+//! lists are a chain of containers ordered by their high bits. A bitmap holds every doc id at most once, so a leaf
+//! holding a doc id more than once is kept in segments.
+class LeafBitmap {
+ public:
+  static constexpr idx_t CONTAINER_BITS = 16;
+  static constexpr idx_t CONTAINER_SIZE = idx_t(1) << CONTAINER_BITS;
+  static constexpr idx_t WORD_COUNT = CONTAINER_SIZE / (sizeof(validity_t) * 8);
+
+  static LeafBitmap &New(ART &art, Node &node, idx_t high);
+
+  static inline LeafBitmap &Get(const ART &art, const Node ptr) {
+    assert(!ptr.IsSerialized());
+    return *Node::GetAllocator(art, NType::LEAF_BITMAP).Get<LeafBitmap>(ptr);
+  }
+
+  static inline idx_t High(idx_t doc_id) { return doc_id >> CONTAINER_BITS; }
+
+  //! Returns false if doc_id was already set
+  bool Set(idx_t doc_id);
+  //! Returns false if doc_id was not set
+  bool Clear(idx_t doc_id);
+  //! Appends all doc ids of this container in ascending order
+  void Decode(std::vector<idx_t> &doc_ids) const;
+  void Union(const LeafBitmap &other);
+
+ public:
+  //! The high bits shared by all doc ids of this container
+  idx_t high;
+  //! The number of set bits
+  idx_t count;
+  //! A pointer to the next LEAF_BITMAP node
+  Node ptr;
+  validity_t words[WORD_COUNT];
+};
+
 class Leaf {
  public:
+  //! Marks a LEAF whose doc ids live in a chain of LeafSegments or LeafBitmaps starting at ptr. For such a leaf
+  //! row_ids[0] holds the total count, row_ids[1] the last node of the chain, so appending does not walk the chain,
+  //! and row_ids[2] the length of the chain. A key may hold a doc id several times in every layout, a segmented leaf
+  //! sets row_ids[3] once it holds a duplicate and never moves to bitmap containers then
+  static constexpr uint8_t SEGMENTED = 0xFF;
+  static constexpr uint8_t BITMAP = 0xFE;
+
   static void New(Node &node, const idx_t value);
+  //! Creates a leaf holding all doc_ids, lists longer than LEAF_SIZE are sorted and moved into segments or, if
+  //! they are dense and free of duplicates, into bitmap containers
+  static void New(ART &art, Node &node, std::vector<idx_t> &doc_ids);
   static void Free(ART &art, Node &node);
 
   static idx_t TotalCount(ART &art, Node &node);
   static bool GetDocIds(ART &art, Node &node, std::vector<idx_t> &result_ids, idx_t max_count);
+  //! The first doc id of the leaf, for segments and bitmap containers that is the smallest one
+  static idx_t FirstDocId(ART &art, Node &node);
+
+  //! Calls fn for every doc id of the leaf in storage order, without allocating
+  template <class F>
+  static void ForEachDocId(ART &art, Node &node, F &&fn) {
+    assert(node.IsSet() && !node.IsSerialized());
+
+    if (node.GetType() == NType::LEAF_INLINED) {
+      fn(node.GetDocId());
+      return;
+    }
+
+    auto &head = Leaf::Get(art, node);
+    if (head.IsSegmented()) {
+      idx_t doc_ids[LeafSegment::MAX_COUNT];
+      auto segment_node = head.ptr;
+      while (segment_node.IsSet()) {
+        auto &segment = LeafSegment::Get(art, segment_node);
+        auto doc_count = segment.Decode(doc_ids);
+        for (idx_t i = 0; i < doc_count; i++) {
+          fn(doc_ids[i]);
+        }
+        segment_node = segment.ptr;
+      }
+      return;
+    }
+
+    if (head.IsBitmap()) {
+      auto container_node = head.ptr;
+      while (container_node.IsSet()) {
+        auto &container = LeafBitmap::Get(art, container_node);
+        auto base = container.high << LeafBitmap::CONTAINER_BITS;
+        for (idx_t i = 0; i < LeafBitmap::WORD_COUNT; i++) {
+          for (auto word = container.words[i]; word; word &= word - 1) {
+            fn(base + i * 64 + __builtin_ctzll(word));
+          }
+        }
+        container_node = container.ptr;
+      }
+      return;
+    }
+
+    auto node_ref = std::ref(node);
+    while (node_ref.get().IsSet()) {
+      auto &leaf = Leaf::Get(art, node_ref);
+      for (idx_t i = 0; i < leaf.count; i++) {
+        fn(leaf.row_ids[i]);
+      }
+      if (leaf.ptr.IsSerialized()) {
+        leaf.ptr.Deserialize(art);
+      }
+      node_ref = leaf.ptr;
+    }
+  }
 
   static inline Leaf &Get(const ART &art, const Node ptr) {
     assert(!ptr.IsSerialized());
@@ -39,6 +179,9 @@ class Leaf {
   static void Deserialize(ART &art, Node &node, Deserializer &deserializer);
 
   static bool Remove(ART &art, std::reference_wrapper<Node> &node, idx_t row_id);
+  //! Removes one occurrence of each of the count doc_ids, segments and bitmap containers are walked once for all of
+  //! them. Returns true once the leaf is empty, the caller frees it then
+  static bool Remove(ART &art, std::reference_wrapper<Node> &node, const idx_t *doc_ids, idx_t count);
 
   static void Merge(ART &art, Node &l_node, Node &r_node);
 
@@ -51,9 +194,89 @@ class Leaf {
   //! A pointer to the next LEAF node
   Node ptr;
 
+  inline bool IsSegmented() const { return count == SEGMENTED; }
+  inline bool IsBitmap() const { return count == BITMAP; }
+
   // private:
   static void MoveInlinedToLeaf(ART &art, Node &node);
   Leaf &Append(ART &art, idx_t row_id);
+
+ private:
+  //! Moves all doc ids of a leaf into sorted segments
+  static void MoveToSegments(ART &art, Node &node);
+  //! Moves all doc ids of a leaf into bitmap containers
+  static void MoveToBitmap(ART &art, Node &node);
+  //! Frees every node behind ptr, whatever the layout of the leaf is
+  void FreeChain(ART &art);
+  //! Fills an empty segment chain with the sorted doc_ids
+  void BuildSegments(ART &art, const idx_t *doc_ids, idx_t doc_count);
+  void InsertSegmented(ART &art, idx_t doc_id);
+  bool RemoveSegmented(ART &art, idx_t doc_id);
+  //! Removes the sorted doc_ids in one walk over the segments, returns the number of removed doc ids
+  idx_t RemoveSegmented(ART &art, const idx_t *doc_ids, idx_t count);
+  //! Moves the doc ids of the next segment into the segment at node if they fit
+  bool CoalesceSegments(ART &art, const Node node);
+  //! Fills an empty container chain with the sorted doc_ids
+  void BuildBitmap(ART &art, const idx_t *doc_ids, idx_t doc_count);
+  //! Returns false and leaves the containers untouched if doc_id is already set
+  bool InsertBitmap(ART &art, idx_t doc_id);
+  bool RemoveBitmap(ART &art, idx_t doc_id);
+  //! Removes the sorted doc_ids in one walk over the containers, returns the number of removed doc ids
+  idx_t RemoveBitmap(ART &art, const idx_t *doc_ids, idx_t count);
+  //! Returns true if both bitmap leaves hold a common doc id
+  bool IntersectsBitmap(ART &art, const Leaf &other) const;
+  void MergeBitmap(ART &art, Leaf &other);
+  //! Switches between segments and bitmap containers when the other layout takes much less memory
+  static void Reorganize(ART &art, Node &node);
+};
+
+//! Walks the doc ids of a leaf in ascending order. Segments are decoded one at a time and bitmap containers are
+//! scanned in place, so skipping ahead never materializes the whole posting list
+class LeafCursor {
+ public:
+  LeafCursor(ART &art, Node &node);
+
+  inline bool Valid() const { return valid; }
+  inline idx_t Value() const {
+    assert(valid);
+    return value;
+  }
+  //! The number of doc ids in the leaf, duplicates included
+  inline idx_t Count() const { return count; }
+  //! The current bitmap container, nullptr if the leaf is not a bitmap leaf or the cursor is exhausted
+  inline const LeafBitmap *Container() const { return container; }
+
+  void Next();
+  //! Moves to the first doc id not smaller than target, the cursor never moves backwards
+  void SkipTo(idx_t target);
+  //! Moves to the first doc id of the next bitmap container
+  void NextContainer();
+
+ private:
+  //! Decodes next_segment into the buffer
+  void loadSegment();
+  //! Moves to the first set bit at or after bit, following the container chain
+  void seekBit();
+  inline void update() {
+    valid = pos < buffer.size();
+    if (valid) {
+      value = buffer[pos];
+    }
+  }
+
+  ART &art;
+  idx_t count;
+  bool valid;
+  idx_t value;
+
+  //! Plain leaves and the current segment
+  std::vector<idx_t> buffer;
+  idx_t pos;
+  Node next_segment;
+
+  //! Bitmap leaves
+  const LeafBitmap *container;
+  idx_t bit;
 };
 
 class CLeaf {
@@ -74,6 +297,8 @@ class CLeaf {
   static void Free(ConcurrentART &art, ConcurrentNode *node);
 
   static void Insert(ConcurrentART &art, ConcurrentNode *&node, const idx_t row_id, bool &retry);
+  //! Replaces all doc ids of the locked leaf by doc_id, the rest of its chain is freed and marked deleted
+  static void Replace(ConcurrentART &art, ConcurrentNode *node, idx_t doc_id);
 
   static void MoveInlinedToLeaf(ConcurrentART &art, ConcurrentNode &node);
 
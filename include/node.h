@@ -4,9 +4,12 @@
 
 #ifndef PART_NODE_H
 #define PART_NODE_H
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstring>
 #include <optional>
+#include <vector>
 
 #include "helper.h"
 #include "serializer.h"
@@ -25,6 +28,58 @@ enum class NType : uint8_t {
   NODE_48 = 5,
   NODE_256 = 6,
   LEAF_INLINED = 7,
+  LEAF_SEGMENT = 8,
+  LEAF_BITMAP = 9,
+};
+
+static constexpr idx_t NTYPE_COUNT = static_cast<idx_t>(NType::LEAF_BITMAP) + 1;
+
+//! One bit per key byte, set for the bytes a NODE_48 or NODE_256 holds a child under. Finding the next, first or last
+//! child takes a few word operations instead of a scan of the 256 slots
+class ChildBitmap {
+ public:
+  //! Returned once there is no such byte
+  static constexpr idx_t END = 256;
+
+  inline void Set(uint8_t byte) { words[byte >> 6] |= uint64_t(1) << (byte & 63); }
+  inline void Clear(uint8_t byte) { words[byte >> 6] &= ~(uint64_t(1) << (byte & 63)); }
+  inline bool Test(uint8_t byte) const { return (words[byte >> 6] >> (byte & 63)) & 1; }
+  inline void Reset() { std::memset(words, 0, sizeof(words)); }
+
+  inline idx_t Count() const {
+    return std::popcount(words[0]) + std::popcount(words[1]) + std::popcount(words[2]) + std::popcount(words[3]);
+  }
+
+  //! The first byte not smaller than byte holding a child
+  inline idx_t Next(idx_t byte) const {
+    if (byte >= END) {
+      return END;
+    }
+    idx_t word = byte >> 6;
+    auto bits = words[word] & (~uint64_t(0) << (byte & 63));
+    while (!bits) {
+      if (++word == WORD_COUNT) {
+        return END;
+      }
+      bits = words[word];
+    }
+    return word * 64 + std::countr_zero(bits);
+  }
+
+  inline idx_t First() const { return Next(0); }
+
+  inline idx_t Last() const {
+    for (idx_t word = WORD_COUNT; word-- > 0;) {
+      if (words[word]) {
+        return word * 64 + 63 - std::countl_zero(words[word]);
+      }
+    }
+    return END;
+  }
+
+ private:
+  static constexpr idx_t WORD_COUNT = 4;
+  uint64_t words[WORD_COUNT];
 };
 
 class Node {
@@ -82,12 +137,17 @@ class Node {
     P_ASSERT(!IsSerialized());
     auto type = data >> Node::SHIFT_TYPE;
     P_ASSERT(type >= (uint8_t)NType::PREFIX);
-    P_ASSERT(type <= (uint8_t)NType::LEAF_INLINED);
+    P_ASSERT(type <= (uint8_t)NType::LEAF_BITMAP);
     return NType(type);
   }
 
   inline uint8_t UnsafeGetType() const { return data >> Node::SHIFT_TYPE; }
 
+  //! Whether the node is a NODE_4, NODE_16, NODE_48 or NODE_256 held in memory
+  inline bool IsInner() const {
+    return IsSet() && !IsSerialized() && GetType() >= NType::NODE_4 && GetType() <= NType::NODE_256;
+  }
+
   //! Get the doc id
   inline idx_t GetDocId() const { return data & Node::AND_RESET; }
 
@@ -139,6 +199,9 @@ class Node {
 
   std::optional<Node *> GetNextChild(ART &art, uint8_t &byte) const;
 
+  //! The number of children of a NODE_4, NODE_16, NODE_48 or NODE_256
+  idx_t ChildCount(const ART &art) const;
+
   static void InsertChild(ART &art, Node &node, const uint8_t byte, const Node child);
 
   static void DeleteChild(ART &art, Node &node, Node &prefix, const uint8_t byte);
@@ -149,6 +212,14 @@ class Node {
 
   bool MergeInternal(ART &art, Node &other);
 
+  //! The serial part of a parallel merge of two inner nodes: moves the children only other has into this node and
+  //! appends the pairs of children under the same byte to tasks, which can be merged independently. Other is
+  //! appended to merged and must be freed once all tasks are done
+  void SplitMerge(ART &art, Node &other, std::vector<std::pair<Node *, Node *>> &tasks, std::vector<Node *> &merged);
+  //! Follows prefixes holding the same bytes in both trees down to the first nodes that differ, the skipped prefixes
+  //! of r_node are appended to merged
+  static void SkipEqualPrefixes(ART &art, Node *&l_node, Node *&r_node, std::vector<Node *> &merged);
+
   static void MergePrefixesDiffer(ART &art, reference<Node> &l_node, reference<Node> &r_node,
                                   idx_t &mismatched_position);
 
@@ -167,6 +238,44 @@ class Node {
  private:
   uint64_t data;
 };
+
+//! When a removal shrinks an inner node into the next smaller type: once it holds fewer children than the threshold of
+//! its type. The gap between a threshold and the capacity of the smaller type is the hysteresis that keeps a node
+//! churning around one size from being copied back and forth. With deferred shrinking removals never shrink, only
+//! ART::Compact does
+struct ShrinkPolicy {
+  uint8_t node16_threshold = Node::NODE_4_CAPACITY;
+  uint8_t node48_threshold = Node::NODE_48_SHRINK_THRESHOLD;
+  uint16_t node256_threshold = Node::NODE_256_SHRINK_THRESHOLD;
+  bool deferred = false;
+};
+
+//! A snapshot of the node type changes of an ART
+struct NodeTransitionStats {
+  //! Inserts into a full node, by the type that grew
+  idx_t grow_node4 = 0;
+  idx_t grow_node16 = 0;
+  idx_t grow_node48 = 0;
+  //! Removals and compactions, by the type that shrank
+  idx_t shrink_node16 = 0;
+  idx_t shrink_node48 = 0;
+  idx_t shrink_node256 = 0;
+};
+
+//! Atomic as parallel merges grow nodes from several threads
+struct NodeTransitionCounters {
+  std::atomic<idx_t> grow_node4 = {0};
+  std::atomic<idx_t> grow_node16 = {0};
+  std::atomic<idx_t> grow_node48 = {0};
+  std::atomic<idx_t> shrink_node16 = {0};
+  std::atomic<idx_t> shrink_node48 = {0};
+  std::atomic<idx_t> shrink_node256 = {0};
+
+  static inline void Add(std::atomic<idx_t> &counter) { counter.fetch_add(1, std::memory_order_relaxed); }
+
+  NodeTransitionStats Snapshot() const;
+  void Reset();
+};
 }  // namespace part
 
 #endif  // PART_NODE_H
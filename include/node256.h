@@ -14,6 +14,9 @@ class Node256 {
  public:
   uint16_t count;
 
+  //! Mirrors the children that are set
+  ChildBitmap occupied;
+
   Node children[Node::NODE_256_CAPACITY];
 
   static Node256 &New(ART &art, Node &node);
@@ -31,7 +34,14 @@ class Node256 {
 
   static void DeleteChild(ART &art, Node &node, const uint8_t byte);
 
-  inline void ReplaceChild(const uint8_t byte, const Node child) { children[byte] = child; }
+  inline void ReplaceChild(const uint8_t byte, const Node child) {
+    children[byte] = child;
+    if (child.IsSet()) {
+      occupied.Set(byte);
+    } else {
+      occupied.Clear(byte);
+    }
+  }
 
   std::optional<Node *> GetChild(const uint8_t byte);
 
@@ -46,6 +56,9 @@ class CNode256 {
  public:
   uint16_t count;
 
+  //! Mirrors the children that are not nullptr
+  ChildBitmap occupied;
+
   ConcurrentNode *children[Node::NODE_256_CAPACITY];
 
   static CNode256 &New(ConcurrentART &art, ConcurrentNode &node);
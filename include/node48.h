@@ -16,6 +16,9 @@ class Node48 {
  public:
   uint8_t count;
 
+  //! Mirrors the bytes of child_index that are not EMPTY_MARKER
+  ChildBitmap occupied;
+
   uint8_t child_index[Node::NODE_256_CAPACITY];
 
   Node children[Node::NODE_48_CAPACITY];
@@ -52,6 +55,9 @@ class CNode48 {
  public:
   uint8_t count;
 
+  //! Mirrors the bytes of child_index that are not EMPTY_MARKER
+  ChildBitmap occupied;
+
   uint8_t child_index[Node::NODE_256_CAPACITY];
 
   ConcurrentNode *children[Node::NODE_48_CAPACITY];
@@ -0,0 +1,83 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_SHARDED_ART_H
+#define PART_SHARDED_ART_H
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "art.h"
+#include "art_key.h"
+#include "types.h"
+
+namespace part {
+
+enum class ShardPartitioner : uint8_t {
+  //! Routes a key by the hash of all of its bytes, spreads any key distribution evenly
+  HASH = 0,
+  //! Routes a key by its first byte, every shard owns a contiguous key range
+  RANGE = 1,
+};
+
+//! N independent ARTs, each with its own allocators and lock. Point operations touch exactly one shard, scans merge
+//! the shards in key order
+class ShardedART {
+ public:
+  explicit ShardedART(idx_t shard_count, ShardPartitioner partitioner = ShardPartitioner::HASH);
+
+  //! Every shard lives in its own file, index_path.0 up to index_path.{shard_count - 1}
+  explicit ShardedART(const std::string &index_path, idx_t shard_count,
+                      ShardPartitioner partitioner = ShardPartitioner::HASH, bool fast_serialize = false);
+
+  void Put(const ARTKey &key, idx_t doc_id);
+
+  bool Get(const ARTKey &key, std::vector<idx_t> &result_ids);
+
+  void Delete(const ARTKey &key, idx_t doc_id);
+
+  //! Calls fn for every key in [lower, upper] in ascending key order until it returns false. All shards are locked
+  //! for the duration of the scan
+  void Scan(const ARTKey &lower, const ARTKey &upper,
+            const std::function<bool(const ARTKey &key, const std::vector<idx_t> &doc_ids)> &fn);
+
+  //! Serializes every shard into its own file, one task per shard on the task scheduler
+  void Serialize();
+
+  void FastSerialize();
+
+  idx_t GetMemoryUsage();
+
+  inline idx_t ShardCount() const { return shards.size(); }
+
+  idx_t ShardOf(const ARTKey &key) const;
+
+  inline ART &GetShard(idx_t shard_id) { return *shards[shard_id].art; }
+
+  static std::string ShardPath(const std::string &index_path, idx_t shard_id);
+
+  //! The pool running the per shard work, TaskScheduler::Default() unless one was set
+  inline void SetTaskScheduler(std::shared_ptr<TaskScheduler> scheduler_p) { scheduler = std::move(scheduler_p); }
+
+ private:
+  struct Shard {
+    std::unique_ptr<ART> art;
+    // NOTE: lazily loaded shards deserialize nodes on Get, so readers need the exclusive lock as well
+    std::mutex lock;
+  };
+
+  //! Runs fn on every shard under its lock, one task per shard
+  void forEachShardParallel(const std::function<void(ART &art)> &fn);
+
+  ShardPartitioner partitioner;
+  std::string index_path;
+  std::vector<Shard> shards;
+  std::shared_ptr<TaskScheduler> scheduler;
+};
+
+}  // namespace part
+
+#endif  // PART_SHARDED_ART_H
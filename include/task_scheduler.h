@@ -0,0 +1,121 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_TASK_SCHEDULER_H
+#define PART_TASK_SCHEDULER_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fixed_size_allocator.h"
+#include "types.h"
+
+namespace part {
+
+//! A fixed pool of worker threads for index maintenance jobs such as parallel merges and serialization. Every worker
+//! owns a deque of tasks, it takes its own tasks from the back and steals from the front of the other deques once
+//! its own is empty. Jobs submit their tasks through a TaskGroup.
+class TaskScheduler {
+ public:
+  using Task = std::function<void()>;
+
+  explicit TaskScheduler(idx_t thread_count = std::thread::hardware_concurrency());
+  //! Runs the remaining tasks and joins the workers
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  //! A process wide scheduler with one thread per core, used by indexes that were not given one
+  static std::shared_ptr<TaskScheduler> Default();
+
+  inline idx_t ThreadCount() const { return workers.size(); }
+
+  //! Limits the number of workers running tasks at the same time, so maintenance leaves cores to queries. The
+  //! other workers sleep until the limit is raised again
+  void SetMaxConcurrency(idx_t max_concurrency);
+  inline idx_t MaxConcurrency() const { return max_concurrency; }
+
+  //! The id of the worker of this scheduler running the calling thread, INVALID_INDEX on any other thread
+  idx_t WorkerId() const;
+
+  void Schedule(Task task);
+
+  //! Runs one queued task on the calling worker, returns false if there was none
+  bool RunOne(idx_t worker_id);
+
+ private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  bool pop(idx_t worker_id, Task &task);
+  void workerLoop(idx_t worker_id);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+
+  //! Guards queued and stopped, workers sleep on cv
+  std::mutex lock;
+  std::condition_variable cv;
+  int64_t queued;
+  bool stopped;
+
+  std::atomic<idx_t> max_concurrency;
+  std::atomic<idx_t> next_worker;
+};
+
+//! A set of tasks on a TaskScheduler that can be waited for. The first exception thrown by a task is rethrown by
+//! Wait, tasks that did not start yet are skipped after it.
+//! With allocators, every worker running tasks of the group allocates nodes through its own AllocatorCache of that
+//! allocator list, the caches are given back on Wait.
+class TaskGroup {
+ public:
+  //! max_concurrency caps the number of tasks of this group running at once, 0 leaves it to the scheduler
+  explicit TaskGroup(TaskScheduler &scheduler, idx_t max_concurrency = 0,
+                     std::vector<FixedSizeAllocator> *allocators = nullptr);
+  //! Waits for the remaining tasks, errors are dropped
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  void Run(TaskScheduler::Task task);
+
+  //! Blocks until all tasks are done. A worker of the scheduler calling Wait runs queued tasks meanwhile
+  void Wait();
+
+ private:
+  void submit(TaskScheduler::Task task);
+  void run(const TaskScheduler::Task &task);
+  void finish();
+
+  TaskScheduler &scheduler;
+  idx_t max_concurrency;
+
+  //! Guards all members below
+  std::mutex lock;
+  std::condition_variable cv;
+  //! Tasks handed to the scheduler and not finished yet
+  idx_t running;
+  //! Tasks held back by max_concurrency
+  std::deque<TaskScheduler::Task> pending;
+  std::exception_ptr error;
+
+  std::vector<FixedSizeAllocator> *allocators;
+  std::mutex allocator_lock;
+  //! One cache per worker, only ever touched by that worker until Wait
+  std::vector<std::unique_ptr<AllocatorCache>> caches;
+};
+
+}  // namespace part
+
+#endif  // PART_TASK_SCHEDULER_H
@@ -0,0 +1,132 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_TIERED_ART_H
+#define PART_TIERED_ART_H
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "art.h"
+#include "art_key.h"
+#include "bloom_filter.h"
+#include "task_scheduler.h"
+#include "types.h"
+
+namespace part {
+
+//! An LSM style index: Puts go into an in-memory ART memtable, a full memtable is swapped for an empty one and
+//! written out as an immutable serialized run without blocking Puts and Gets, and a task on the scheduler compacts
+//! the runs into one once there are too many of them. Runs are only opened on their first lookup, their key filters
+//! are loaded upfront, so lookups skip runs that cannot hold the key without reading them.
+//! The live runs are listed in the manifest file index_path.manifest, a run only becomes visible once the manifest
+//! names it.
+class TieredART {
+ public:
+  static constexpr idx_t DEFAULT_MEMTABLE_LIMIT = 1 << 20;
+  //! Compaction starts once there are this many runs
+  static constexpr idx_t DEFAULT_COMPACTION_TRIGGER = 4;
+
+  //! Compactions run on scheduler, TaskScheduler::Default() if none is given
+  explicit TieredART(const std::string &index_path, idx_t memtable_limit = DEFAULT_MEMTABLE_LIMIT,
+                     idx_t compaction_trigger = DEFAULT_COMPACTION_TRIGGER,
+                     idx_t bits_per_key = BloomFilter::DEFAULT_BITS_PER_KEY,
+                     std::shared_ptr<TaskScheduler> scheduler = nullptr);
+  //! Writes the memtable out and waits for the compactions it queued
+  ~TieredART();
+
+  TieredART(const TieredART &) = delete;
+  TieredART &operator=(const TieredART &) = delete;
+
+  //! Writes the memtable out as a new run once it holds memtable_limit doc ids. Only one memtable is written at a
+  //! time, a Put filling the next one meanwhile waits for that
+  void Put(const ARTKey &key, idx_t doc_id);
+
+  //! Appends the doc ids of the memtable, of the memtable being written out and of all runs, from the newest to the
+  //! oldest
+  bool Get(const ARTKey &key, std::vector<idx_t> &result_ids);
+
+  //! Writes the memtable out as a new run, even if it is not full
+  void Flush();
+
+  //! Merges all runs into a single one on the calling thread
+  void Compact();
+
+  //! Blocks until no compaction is running or queued, rethrows the error of a failed one
+  void WaitCompaction();
+
+  idx_t RunCount();
+
+  static std::string RunPath(const std::string &index_path, idx_t run_id);
+  static std::string ManifestPath(const std::string &index_path);
+
+  //! The number of runs skipped by their Bloom filter since construction
+  inline idx_t FilteredCount() const { return filtered_count; }
+
+ private:
+  struct Run {
+    //! Removes the files of an obsolete run once the last reader is done with it
+    ~Run();
+
+    idx_t run_id;
+    std::string path;
+    //! The key filter written next to the run, nullptr if there is none
+    std::unique_ptr<BloomFilter> filter;
+    // NOTE: a lazily loaded ART deserializes nodes on Get, so every lookup takes the lock
+    std::mutex lock;
+    std::unique_ptr<ART> art;
+    //! Set once a compaction replaced the run
+    bool obsolete = false;
+  };
+
+  //! Swaps the memtable for an empty one and writes it out, only_if_full skips a memtable another flush emptied
+  void flushMemtable(bool only_if_full);
+  //! Allocates the id and path of a run that is about to be written
+  std::shared_ptr<Run> newRun();
+  std::shared_ptr<Run> openRun(idx_t run_id);
+  void writeManifest();
+  void readManifest();
+  //! Queues a compaction on the scheduler unless one is queued already
+  void scheduleCompaction();
+
+  std::string index_path;
+  idx_t memtable_limit;
+  idx_t compaction_trigger;
+  idx_t bits_per_key;
+
+  //! Guards memtable, memtable_count and immutable, it is never held while a run is written
+  std::mutex memtable_lock;
+  std::unique_ptr<ART> memtable;
+  idx_t memtable_count;
+  //! The memtable being written out, nullptr if no flush is running. Gets hold a reference while they read it
+  std::shared_ptr<ART> immutable;
+  //! Only one flush runs at a time
+  std::mutex flush_lock;
+
+  //! Guards runs, next_run_id and the manifest file
+  std::mutex runs_lock;
+  //! Ordered from the oldest to the newest
+  std::vector<std::shared_ptr<Run>> runs;
+  idx_t next_run_id;
+
+  //! Only one compaction runs at a time
+  std::mutex compaction_lock;
+
+  //! Guards compaction_queued
+  std::mutex state_lock;
+  //! Set while a compaction waits to start, flushes meanwhile do not queue another one
+  bool compaction_queued;
+
+  std::atomic<idx_t> filtered_count;
+
+  std::shared_ptr<TaskScheduler> scheduler;
+  // NOTE: declared last, destroying the group waits for the queued compactions before any other member goes away
+  TaskGroup compactions;
+};
+
+}  // namespace part
+
+#endif  // PART_TIERED_ART_H
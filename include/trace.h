@@ -0,0 +1,99 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_TRACE_H
+#define PART_TRACE_H
+#include <array>
+#include <atomic>
+
+#include "node.h"
+#include "types.h"
+
+namespace part {
+
+//! Hot path events of ART counted by PART_TRACE. Node visits are counted per NType, from NODE_VISITS on
+enum class TraceEvent : uint8_t {
+  LOOKUPS,
+  INSERTS,
+  PREFIX_BYTES_COMPARED,
+  PREFIX_SPLITS,
+  GROW_NODE4,
+  GROW_NODE16,
+  GROW_NODE48,
+  SHRINK_NODE16,
+  SHRINK_NODE48,
+  SHRINK_NODE256,
+  //! Steps from one node of a leaf chain to the next one on reads
+  LEAF_HOPS,
+  DESERIALIZE_CALLS,
+  DESERIALIZE_BYTES,
+  NODE_VISITS,
+};
+
+static constexpr idx_t TRACE_EVENT_COUNT = static_cast<idx_t>(TraceEvent::NODE_VISITS) + NTYPE_COUNT;
+
+//! The sum of the trace counters of all threads
+struct TraceStats {
+  std::array<uint64_t, TRACE_EVENT_COUNT> counts = {};
+
+  inline uint64_t Get(TraceEvent event) const { return counts[static_cast<idx_t>(event)]; }
+  //! Nodes of the type visited by lookups and inserts
+  inline uint64_t NodeVisits(NType type) const {
+    return counts[static_cast<idx_t>(TraceEvent::NODE_VISITS) + static_cast<idx_t>(type)];
+  }
+};
+
+//! Per thread counters of hot path events, summed up on demand. They only exist in builds with PART_ENABLE_TRACING,
+//! PART_TRACE compiles to nothing otherwise and Snapshot stays empty.
+class Trace {
+ public:
+  static constexpr bool Enabled() {
+#ifdef PART_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static inline void Add(TraceEvent event, uint64_t count) { add(static_cast<idx_t>(event), count); }
+  static inline void AddNodeVisit(NType type) {
+    add(static_cast<idx_t>(TraceEvent::NODE_VISITS) + static_cast<idx_t>(type), 1);
+  }
+
+  static TraceStats Snapshot();
+  //! Counts of threads tracing at the same time may survive the reset
+  static void Reset();
+
+ private:
+  static inline void add(idx_t index, uint64_t count) {
+    // NOTE: only the owning thread writes its counters, the atomics make the reads of Snapshot well defined
+    auto &counter = Local().counts[index];
+    counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+  }
+
+  struct ThreadCounters {
+    ThreadCounters();
+    //! Hands the counts of an exiting thread over to the process totals
+    ~ThreadCounters();
+
+    std::array<std::atomic<uint64_t>, TRACE_EVENT_COUNT> counts = {};
+  };
+
+  static ThreadCounters &Local() {
+    static thread_local ThreadCounters counters;
+    return counters;
+  }
+};
+
+}  // namespace part
+
+#ifdef PART_ENABLE_TRACING
+#define PART_TRACE(event, count) ::part::Trace::Add(::part::TraceEvent::event, count)
+#define PART_TRACE_NODE_VISIT(type) ::part::Trace::AddNodeVisit(type)
+#else
+#define PART_TRACE(event, count) ((void)0)
+#define PART_TRACE_NODE_VISIT(type) ((void)0)
+#endif
+
+#endif  // PART_TRACE_H
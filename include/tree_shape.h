@@ -0,0 +1,68 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+
+#ifndef PART_TREE_SHAPE_H
+#define PART_TREE_SHAPE_H
+#include <array>
+#include <string>
+#include <vector>
+
+#include "art.h"
+#include "node.h"
+
+namespace part {
+
+//! A subtree below the first key bytes of its keys, see TreeShape::Analyze
+struct SubtreeShape {
+  //! The key bytes above the subtree
+  std::vector<uint8_t> key_prefix;
+  //! Nodes of the subtree, leaf chains included
+  idx_t nodes = 0;
+  idx_t keys = 0;
+  idx_t doc_ids = 0;
+};
+
+//! Statistics on the shape of an ART, for choosing key encodings and spotting pathological key distributions where
+//! Draw is too large to look at
+struct TreeShape {
+  //! Inner nodes whose child count is less than this far from a grow or shrink of the node
+  static constexpr idx_t THRESHOLD_DISTANCE = 2;
+
+  //! Nodes by NType, the nodes of leaf chains included
+  std::array<idx_t, NTYPE_COUNT> node_counts = {};
+  idx_t keys = 0;
+  idx_t doc_ids = 0;
+  //! Keys by the number of nodes above their leaf, prefix nodes included
+  std::vector<idx_t> depth_histogram;
+  //! Keys by their length in bytes
+  std::vector<idx_t> key_length_histogram;
+  //! Inner nodes of each NType by their child count, empty for the other types
+  std::array<std::vector<idx_t>, NTYPE_COUNT> fanout_histograms;
+  //! Compressed paths by their length in bytes, a chain of prefix nodes counts as one path
+  std::vector<idx_t> prefix_length_histogram;
+  //! Inner nodes of each NType at most THRESHOLD_DISTANCE - 1 children away from growing into the next larger type
+  std::array<idx_t, NTYPE_COUNT> near_grow = {};
+  //! Inner nodes of each NType at most THRESHOLD_DISTANCE - 1 removals away from shrinking into the next smaller type
+  //! under the shrink policy of the tree
+  std::array<idx_t, NTYPE_COUNT> near_shrink = {};
+  //! The largest subtrees, in descending order of their nodes and of their doc ids
+  std::vector<SubtreeShape> largest_by_nodes;
+  std::vector<SubtreeShape> largest_by_doc_ids;
+
+  //! Walks the whole tree. The subtrees below subtree_bytes key bytes are walked as up to thread_count tasks at a time
+  //! on the task scheduler of art, unless it is lazily loaded, as deserializing nodes modifies the tree. The top_k
+  //! largest of these subtrees are kept
+  static TreeShape Analyze(ART &art, idx_t thread_count = 1, idx_t subtree_bytes = 1, idx_t top_k = 10);
+
+  idx_t NodeCount() const;
+  //! A report of all statistics in a few lines each
+  std::string ToString() const;
+
+  //! Adds the statistics of other, the subtrees are left out
+  void Merge(const TreeShape &other);
+};
+
+}  // namespace part
+
+#endif  // PART_TREE_SHAPE_H
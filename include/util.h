@@ -26,12 +26,18 @@ class Random {
     dist_ = std::make_unique<std::uniform_int_distribution<int64_t>>(0, std::numeric_limits<int64_t>::max());
   }
 
+  //! A generator producing the same sequence on every run
+  explicit Random(uint64_t seed) {
+    gen_ = std::make_unique<std::mt19937_64>(seed);
+    dist_ = std::make_unique<std::uniform_int_distribution<int64_t>>(0, std::numeric_limits<int64_t>::max());
+  }
+
   inline int64_t NextLong() { return (*dist_)(*gen_); }
 
   Vector<ARTKeyInt64Pair> GenKvPairs(int32_t limit, ArenaAllocator& arena_allocator) {
     Vector<ARTKeyInt64Pair> kv_pairs;
     std::unordered_set<int64_t> key_sets;
-    for (idx_t i = 0; i < limit; i++) {
+    for (int32_t i = 0; i < limit; i++) {
       int64_t rk = 0;
       do {
         rk = NextLong();
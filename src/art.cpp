@@ -7,21 +7,29 @@
 #include <node256.h>
 #include <node48.h>
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <queue>
 
+#include "art_iterator.h"
 #include "art_key.h"
 #include "concurrent_node.h"
 #include "fixed_size_allocator.h"
+#include "latency_histogram.h"
 #include "leaf.h"
 #include "node.h"
 #include "node16.h"
 #include "node4.h"
 #include "prefix.h"
+#include "task_scheduler.h"
+#include "trace.h"
 
 namespace part {
 
-ART::ART(const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr)
-    : allocators(allocators_ptr), owns_data(false) {
+ART::ART(const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr, IndexConstraintType constraint_type)
+    : allocators(allocators_ptr), owns_data(false), constraint_type(constraint_type) {
   if (!allocators) {
     owns_data = true;
     allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
@@ -31,14 +39,18 @@ ART::ART(const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr)
     allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
     allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
     allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+    allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+    allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
   }
 
   root = std::make_unique<Node>();
 }
 
-ART::ART(const std::string &index_path, const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr)
-    : ART(allocators_ptr) {
+ART::ART(const std::string &index_path, const std::shared_ptr<std::vector<FixedSizeAllocator>> &allocators_ptr,
+         IndexConstraintType constraint_type, bool lazy_load)
+    : ART(allocators_ptr, constraint_type) {
   index_path_ = index_path;
+  this->lazy_load = lazy_load;
 
   index_fd_ = ::open(index_path.c_str(), O_CREAT | O_RDWR, 0644);
   if (index_fd_ == -1) {
@@ -56,9 +68,13 @@ ART::ART(const std::string &index_path, const std::shared_ptr<std::vector<FixedS
   } catch (std::exception &e) {
     root = std::make_unique<Node>();
   }
+  if (root->IsSet()) {
+    filter = ReadFilter(index_path);
+  }
 }
 
-ART::ART(const std::string &index_path, bool fast_serialize) {
+ART::ART(const std::string &index_path, bool fast_serialize, IndexConstraintType constraint_type)
+    : constraint_type(constraint_type) {
   index_path_ = index_path;
 
   index_fd_ = ::open(index_path.c_str(), O_CREAT | O_RDWR, 0644);
@@ -76,7 +92,7 @@ ART::ART(const std::string &index_path, bool fast_serialize) {
     auto &allocator = Allocator::DefaultAllocator();
     allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
     // NOTE: must need reserve
-    allocators->reserve(6);
+    allocators->reserve(8);
     // prefix
     allocators->emplace_back(reader, allocator);
     // leaf
@@ -89,27 +105,256 @@ ART::ART(const std::string &index_path, bool fast_serialize) {
     allocators->emplace_back(reader, allocator);
     // node256
     allocators->emplace_back(reader, allocator);
+    // leaf segment
+    allocators->emplace_back(reader, allocator);
+    // leaf bitmap
+    allocators->emplace_back(reader, allocator);
   } catch (std::exception &e) {
     root = std::make_unique<Node>();
   }
+  if (root->IsSet()) {
+    filter = ReadFilter(index_path);
+  }
+}
+
+ART::~ART() {
+  root->Reset();
+  if (index_fd_ != -1) {
+    ::close(index_fd_);
+  }
+  if (metadata_fd_ != -1) {
+    ::close(metadata_fd_);
+  }
 }
 
-ART::~ART() { root->Reset(); }
+void ART::Put(const ARTKey &key, idx_t doc_id) {
+  ScopedLatency latency(IndexOperation::PUT);
+  if (IsUnique()) {
+    Insert(key, doc_id);
+    return;
+  }
+  insert(*root, key, 0, doc_id);
+}
 
-void ART::Put(const ARTKey &key, idx_t doc_id) { insert(*root, key, 0, doc_id); }
+void ART::checkUnique(idx_t doc_id) const {
+  if (!IsUnique()) {
+    throw std::invalid_argument("single doc id operations need a unique index");
+  }
+  if (doc_id > Node::AND_RESET) {
+    throw std::invalid_argument(fmt::format("doc id {} does not fit into an inlined leaf", doc_id));
+  }
+}
+
+void ART::Insert(const ARTKey &key, idx_t doc_id) {
+  checkUnique(doc_id);
+  insert(*root, key, 0, doc_id, InsertMode::INSERT);
+}
+
+void ART::Upsert(const ARTKey &key, idx_t doc_id) {
+  checkUnique(doc_id);
+  insert(*root, key, 0, doc_id, InsertMode::UPSERT);
+}
+
+bool ART::InsertIfAbsent(const ARTKey &key, idx_t doc_id) {
+  checkUnique(doc_id);
+  return insert(*root, key, 0, doc_id, InsertMode::INSERT_IF_ABSENT);
+}
+
+bool ART::Get(const ARTKey &key, idx_t &doc_id) {
+  ScopedLatency latency(IndexOperation::GET);
+  checkUnique(0);
+  auto leaf = lookup(*root, key, 0);
+  if (!leaf) {
+    return false;
+  }
+  assert(leaf.value()->GetType() == NType::LEAF_INLINED);
+  doc_id = leaf.value()->GetDocId();
+  return true;
+}
 
 bool ART::Get(const ARTKey &key, std::vector<idx_t> &result_ids) {
+  ScopedLatency latency(IndexOperation::GET);
   auto leaf = lookup(*root, key, 0);
   if (!leaf) {
     return false;
   }
 
-  return Leaf::GetDocIds(*this, *leaf.value(), result_ids, std::numeric_limits<int64_t>::max());
+  return Leaf::GetDocIds(*this, *leaf.value(), result_ids, std::numeric_limits<idx_t>::max());
+}
+
+bool ART::Contains(const ARTKey &key) { return lookup(*root, key, 0).has_value(); }
+
+bool ART::GetFirst(const ARTKey &key, idx_t &doc_id) {
+  auto leaf = lookup(*root, key, 0);
+  if (!leaf) {
+    return false;
+  }
+  doc_id = Leaf::FirstDocId(*this, *leaf.value());
+  return true;
+}
+
+idx_t ART::Count(const ARTKey &key) {
+  auto leaf = lookup(*root, key, 0);
+  if (!leaf) {
+    return 0;
+  }
+  return Leaf::TotalCount(*this, *leaf.value());
+}
+
+//! Intersects bitmap leaves container by container, ANDing whole words instead of probing single doc ids
+static void IntersectBitmaps(std::vector<LeafCursor> &cursors, std::vector<idx_t> &result_ids, idx_t limit) {
+  validity_t words[LeafBitmap::WORD_COUNT];
+  while (true) {
+    // align every cursor on the container with the largest high bits
+    idx_t high = 0;
+    for (auto &cursor : cursors) {
+      if (!cursor.Valid()) {
+        return;
+      }
+      high = std::max(high, cursor.Container()->high);
+    }
+    bool aligned = true;
+    for (auto &cursor : cursors) {
+      cursor.SkipTo(high << LeafBitmap::CONTAINER_BITS);
+      if (!cursor.Valid()) {
+        return;
+      }
+      aligned = aligned && cursor.Container()->high == high;
+    }
+    if (!aligned) {
+      continue;
+    }
+
+    std::memcpy(words, cursors[0].Container()->words, sizeof(words));
+    for (idx_t i = 1; i < cursors.size(); i++) {
+      auto &other_words = cursors[i].Container()->words;
+      for (idx_t w = 0; w < LeafBitmap::WORD_COUNT; w++) {
+        words[w] &= other_words[w];
+      }
+    }
+
+    auto base = high << LeafBitmap::CONTAINER_BITS;
+    for (idx_t w = 0; w < LeafBitmap::WORD_COUNT; w++) {
+      auto word = words[w];
+      while (word) {
+        result_ids.push_back(base + w * 64 + __builtin_ctzll(word));
+        if (result_ids.size() >= limit) {
+          return;
+        }
+        word &= word - 1;
+      }
+    }
+
+    for (auto &cursor : cursors) {
+      cursor.NextContainer();
+    }
+  }
+}
+
+bool ART::Intersect(const std::vector<ARTKey> &keys, std::vector<idx_t> &result_ids, idx_t limit) {
+  if (keys.empty()) {
+    return false;
+  }
+
+  std::vector<std::pair<idx_t, Node *>> leaves;
+  leaves.reserve(keys.size());
+  for (auto &key : keys) {
+    auto leaf = lookup(*root, key, 0);
+    if (!leaf) {
+      return false;
+    }
+    leaves.emplace_back(Leaf::TotalCount(*this, *leaf.value()), leaf.value());
+  }
+
+  // the shortest posting list drives the intersection, the others only skip ahead
+  std::sort(leaves.begin(), leaves.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+  std::vector<LeafCursor> cursors;
+  cursors.reserve(leaves.size());
+  bool all_bitmaps = true;
+  for (auto &leaf : leaves) {
+    cursors.emplace_back(*this, *leaf.second);
+    all_bitmaps = all_bitmaps && cursors.back().Container() != nullptr;
+  }
+
+  if (result_ids.size() >= limit) {
+    return true;
+  }
+  if (all_bitmaps && cursors.size() > 1) {
+    IntersectBitmaps(cursors, result_ids, limit);
+    return true;
+  }
+
+  auto &lead = cursors[0];
+  while (lead.Valid() && result_ids.size() < limit) {
+    auto candidate = lead.Value();
+    bool matched = true;
+    for (idx_t i = 1; i < cursors.size(); i++) {
+      cursors[i].SkipTo(candidate);
+      if (!cursors[i].Valid()) {
+        return true;
+      }
+      if (cursors[i].Value() != candidate) {
+        lead.SkipTo(cursors[i].Value());
+        matched = false;
+        break;
+      }
+    }
+    if (matched) {
+      result_ids.push_back(candidate);
+      lead.SkipTo(candidate + 1);
+    }
+  }
+  return true;
+}
+
+bool ART::Union(const std::vector<ARTKey> &keys, std::vector<idx_t> &result_ids, idx_t limit) {
+  std::vector<LeafCursor> cursors;
+  cursors.reserve(keys.size());
+  for (auto &key : keys) {
+    auto leaf = lookup(*root, key, 0);
+    if (leaf) {
+      cursors.emplace_back(*this, *leaf.value());
+    }
+  }
+  if (cursors.empty()) {
+    return false;
+  }
+
+  // k-way merge over a min heap of (doc id, cursor index)
+  using entry_t = std::pair<idx_t, idx_t>;
+  std::priority_queue<entry_t, std::vector<entry_t>, std::greater<>> heap;
+  for (idx_t i = 0; i < cursors.size(); i++) {
+    if (cursors[i].Valid()) {
+      heap.emplace(cursors[i].Value(), i);
+    }
+  }
+
+  bool has_last = false;
+  idx_t last = 0;
+  while (!heap.empty() && result_ids.size() < limit) {
+    auto [doc_id, i] = heap.top();
+    heap.pop();
+    if (!has_last || last != doc_id) {
+      result_ids.push_back(doc_id);
+      has_last = true;
+      last = doc_id;
+    }
+    cursors[i].SkipTo(doc_id + 1);
+    if (cursors[i].Valid()) {
+      heap.emplace(cursors[i].Value(), i);
+    }
+  }
+  return true;
 }
 
 std::optional<Node *> ART::lookup(Node node, const ARTKey &key, idx_t depth) {
+  PART_TRACE(LOOKUPS, 1);
+  if (depth == 0 && !MayContain(key)) {
+    return std::nullopt;
+  }
   auto next_node = std::ref(node);
   while (next_node.get().IsSet()) {
+    // NOTE: prefixes are counted by Prefix::Traverse
     if (next_node.get().GetType() == NType::PREFIX) {
       Prefix::Traverse(*this, next_node, key, depth);
       if (next_node.get().GetType() == NType::PREFIX) {
@@ -122,6 +367,7 @@ std::optional<Node *> ART::lookup(Node node, const ARTKey &key, idx_t depth) {
     }
 
     assert(depth < key.len);
+    PART_TRACE_NODE_VISIT(next_node.get().GetType());
     auto child = next_node.get().GetChild(*this, key[depth]);
     if (!child) {
       return std::nullopt;
@@ -132,29 +378,35 @@ std::optional<Node *> ART::lookup(Node node, const ARTKey &key, idx_t depth) {
   return std::nullopt;
 }
 
-void ART::insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id) {
+bool ART::insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id, InsertMode mode) {
+  // NOTE: keys added after loading must pass the filter as well
+  if (depth == 0) {
+    PART_TRACE(INSERTS, 1);
+    if (filter) {
+      filter->Add(key);
+    }
+  }
   if (!node.IsSet()) {
     assert(depth <= key.len);
     std::reference_wrapper<Node> ref_node(node);
     Prefix::New(*this, ref_node, key, depth, key.len - depth);
     Leaf::New(ref_node, doc_id);
-    return;
+    return true;
   }
 
   auto node_type = node.GetType();
 
   if (node_type == NType::LEAF || node_type == NType::LEAF_INLINED) {
-    insertToLeaf(node, doc_id);
-    return;
+    return insertToLeaf(node, doc_id, mode);
   }
 
   if (node_type != NType::PREFIX) {
     assert(depth < key.len);
+    PART_TRACE_NODE_VISIT(node_type);
 
     auto child = node.GetChild(*this, key[depth]);
     if (child) {
-      insert(*child.value(), key, depth + 1, doc_id);
-      return;
+      return insert(*child.value(), key, depth + 1, doc_id, mode);
     }
 
     Node leaf_node;
@@ -166,7 +418,7 @@ void ART::insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id
 
     Leaf::New(ref_node, doc_id);
     Node::InsertChild(*this, node, key[depth], leaf_node);
-    return;
+    return true;
   }
 
   // insert to prefix
@@ -175,7 +427,7 @@ void ART::insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id
   auto mismatch_position = Prefix::Traverse(*this, next_node, key, depth);
 
   if (next_node.get().GetType() != NType::PREFIX) {
-    return insert(next_node, key, depth, doc_id);
+    return insert(next_node, key, depth, doc_id, mode);
   }
 
   Node remaining_prefix;
@@ -197,20 +449,36 @@ void ART::insert(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id
 
   Leaf::New(ref_node, doc_id);
   Node4::InsertChild(*this, next_node, key[depth], leaf_node);
+  return true;
 }
 
-bool ART::insertToLeaf(Node &leaf, const idx_t row_id) {
-  // NOTE: no constraints check
-
-  // assert Leaf is RLocked
-  Leaf::Insert(*this, leaf, row_id);
-  // release Lock
-  return true;
+bool ART::insertToLeaf(Node &leaf, const idx_t row_id, InsertMode mode) {
+  switch (mode) {
+    case InsertMode::APPEND:
+      // assert Leaf is RLocked
+      Leaf::Insert(*this, leaf, row_id);
+      // release Lock
+      return true;
+    case InsertMode::UPSERT:
+      // NOTE: leaves of a unique index are always inlined, so replacing the doc id allocates nothing
+      assert(leaf.GetType() == NType::LEAF_INLINED);
+      Leaf::New(leaf, row_id);
+      return true;
+    case InsertMode::INSERT_IF_ABSENT:
+      return false;
+    case InsertMode::INSERT:
+      throw std::invalid_argument(
+          fmt::format("duplicate key in unique index, existing doc id {}, new doc id {}", leaf.GetDocId(), row_id));
+  }
+  return false;
 }
 
-void ART::Delete(const ARTKey &key, idx_t doc_id) { erase(*root, key, 0, doc_id); }
+void ART::Delete(const ARTKey &key, idx_t doc_id) {
+  ScopedLatency latency(IndexOperation::DELETE);
+  erase(*root, key, 0, &doc_id, 1);
+}
 
-void ART::erase(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id) {
+void ART::erase(Node &node, const ARTKey &key, idx_t depth, const idx_t *doc_ids, idx_t count) {
   if (!node.IsSet()) {
     return;
   }
@@ -224,7 +492,7 @@ void ART::erase(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id)
   }
 
   if (next_node.get().GetType() == NType::LEAF || next_node.get().GetType() == NType::LEAF_INLINED) {
-    if (Leaf::Remove(*this, next_node, doc_id)) {
+    if (Leaf::Remove(*this, next_node, doc_ids, count)) {
       Node::Free(*this, node);
     }
     return;
@@ -247,19 +515,197 @@ void ART::erase(Node &node, const ARTKey &key, idx_t depth, const idx_t &doc_id)
     }
 
     if (child_node.get().GetType() == NType::LEAF || child_node.get().GetType() == NType::LEAF_INLINED) {
-      if (Leaf::Remove(*this, child_node, doc_id)) {
+      if (Leaf::Remove(*this, child_node, doc_ids, count)) {
         // NOTE: why is node ??? node is just use for compress
         Node::DeleteChild(*this, next_node, node, key[depth]);
       }
       return;
     }
 
-    erase(*child.value(), key, depth + 1, doc_id);
+    erase(*child.value(), key, depth + 1, doc_ids, count);
     // NOTE: necessary???
     next_node.get().ReplaceChild(*this, key[depth], *child.value());
   }
 }
 
+//! Narrows the bound checks for the keys continuing with byte at depth, returns false if they all lie outside of
+//! [lower, upper]
+static inline bool NarrowRange(uint8_t byte, const ARTKey &lower, const ARTKey &upper, idx_t depth, bool &check_lower,
+                               bool &check_upper) {
+  // a key extending the lower bound is greater, one extending the upper bound is greater as well
+  if (check_lower && depth >= lower.len) {
+    check_lower = false;
+  }
+  if (check_upper && depth >= upper.len) {
+    return false;
+  }
+  if (check_lower) {
+    if (byte < lower[depth]) {
+      return false;
+    }
+    check_lower = byte == lower[depth];
+  }
+  if (check_upper) {
+    if (byte > upper[depth]) {
+      return false;
+    }
+    check_upper = byte == upper[depth];
+  }
+  return true;
+}
+
+void ART::SetShrinkPolicy(const ShrinkPolicy &policy) {
+  if (policy.node16_threshold > Node::NODE_4_CAPACITY + 1 || policy.node48_threshold > Node::NODE_16_CAPACITY + 1 ||
+      policy.node256_threshold > Node::NODE_48_CAPACITY + 1) {
+    throw std::invalid_argument(fmt::format("shrink thresholds {}, {}, {} exceed the capacity of the smaller nodes",
+                                            policy.node16_threshold, policy.node48_threshold,
+                                            policy.node256_threshold));
+  }
+  shrink_policy = policy;
+}
+
+//! Compacts the inner nodes in memory below node bottom up, returns the number of shrinks
+static idx_t CompactNode(ART &art, Node &node) {
+  if (!node.IsSet() || node.IsSerialized()) {
+    return 0;
+  }
+  if (node.GetType() == NType::PREFIX) {
+    return CompactNode(art, Prefix::Get(art, node).ptr);
+  }
+  if (!node.IsInner()) {
+    return 0;
+  }
+
+  idx_t shrinks = 0;
+  uint8_t byte = 0;
+  for (auto child = node.GetNextChild(art, byte); child; child = node.GetNextChild(art, byte)) {
+    shrinks += CompactNode(art, *child.value());
+    if (byte == UINT8_MAX) {
+      break;
+    }
+    byte++;
+  }
+
+  auto &policy = art.GetShrinkPolicy();
+  Node old_node;
+  if (node.GetType() == NType::NODE_256 && node.ChildCount(art) < policy.node256_threshold) {
+    old_node = node;
+    Node48::ShrinkNode256(art, node, old_node);
+    shrinks++;
+  }
+  if (node.GetType() == NType::NODE_48 && node.ChildCount(art) < policy.node48_threshold) {
+    old_node = node;
+    Node16::ShrinkNode48(art, node, old_node);
+    shrinks++;
+  }
+  if (node.GetType() == NType::NODE_16 && node.ChildCount(art) < policy.node16_threshold) {
+    old_node = node;
+    Node4::ShrinkNode16(art, node, old_node);
+    shrinks++;
+  }
+  return shrinks;
+}
+
+idx_t ART::Compact() { return CompactNode(*this, *root); }
+
+void ART::DeleteRange(const ARTKey &lower, const ARTKey &upper) {
+  if (upper < lower) {
+    throw std::invalid_argument("lower bound of the range is greater than its upper bound");
+  }
+  eraseRange(*root, lower, upper, 0, true, true);
+  // NOTE: dropping a large range usually empties the most recently allocated buffers
+  for (auto &allocator : *allocators) {
+    allocator.ReleaseEmptyBuffers();
+  }
+}
+
+void ART::eraseRange(Node &node, const ARTKey &lower, const ARTKey &upper, idx_t depth, bool check_lower,
+                     bool check_upper) {
+  if (!node.IsSet()) {
+    return;
+  }
+  // the whole subtree lies inside the range
+  if (!check_lower && !check_upper) {
+    Node::Free(*this, node);
+    return;
+  }
+  if (node.IsSerialized()) {
+    node.Deserialize(*this);
+  }
+
+  auto next_node = std::ref(node);
+  auto next_depth = depth;
+  auto next_check_lower = check_lower;
+  auto next_check_upper = check_upper;
+  while (next_node.get().GetType() == NType::PREFIX) {
+    auto &prefix = Prefix::Get(*this, next_node);
+    for (idx_t i = 0; i < prefix.data[Node::PREFIX_SIZE]; i++) {
+      if (!NarrowRange(prefix.data[i], lower, upper, next_depth, next_check_lower, next_check_upper)) {
+        return;
+      }
+      next_depth++;
+    }
+    if (!next_check_lower && !next_check_upper) {
+      Node::Free(*this, node);
+      return;
+    }
+    if (prefix.ptr.IsSerialized()) {
+      prefix.ptr.Deserialize(*this);
+    }
+    next_node = prefix.ptr;
+  }
+
+  if (next_node.get().GetType() == NType::LEAF || next_node.get().GetType() == NType::LEAF_INLINED) {
+    // the key matches every bound still checked, so it is only outside if it is a proper prefix of lower
+    if (next_check_lower && next_depth < lower.len) {
+      return;
+    }
+    Node::Free(*this, node);
+    return;
+  }
+
+  if (next_check_lower && next_depth >= lower.len) {
+    next_check_lower = false;
+  }
+  if (next_check_upper && next_depth >= upper.len) {
+    return;
+  }
+  uint8_t low = next_check_lower ? lower[next_depth] : 0;
+  uint8_t high = next_check_upper ? upper[next_depth] : Node::NODE_256_CAPACITY - 1;
+
+  uint8_t byte = low;
+  while (true) {
+    auto child = next_node.get().GetNextChild(*this, byte);
+    if (!child || byte > high) {
+      return;
+    }
+
+    // only the children on the paths of the bounds are visited, the ones in between are freed right away
+    eraseRange(*child.value(), lower, upper, next_depth + 1, next_check_lower && byte == low,
+               next_check_upper && byte == high);
+    if (!child.value()->IsSet()) {
+      auto child_count = next_node.get().ChildCount(*this);
+      if (child_count == 1) {
+        Node::Free(*this, node);
+        return;
+      }
+      // NOTE: a node left with one child is compressed into the prefix, whatever its type
+      auto merges_into_prefix = child_count == 2;
+      Node::DeleteChild(*this, next_node, node, byte);
+      if (merges_into_prefix) {
+        // the remaining child was concatenated with the prefix, start over on the new layout
+        eraseRange(node, lower, upper, depth, check_lower, check_upper);
+        return;
+      }
+    }
+
+    if (byte == high) {
+      return;
+    }
+    byte++;
+  }
+}
+
 idx_t ART::GetMemoryUsage() {
   if (owns_data) {
     idx_t total = 0;
@@ -281,6 +727,7 @@ BlockPointer ART::Serialize(Serializer &writer) {
 }
 
 void ART::Serialize() {
+  ScopedLatency latency(IndexOperation::SERIALIZE);
   if (root->IsSet()) {
     SequentialSerializer data_writer(index_path_, META_OFFSET);
     auto pointer = root->Serialize(*this, data_writer);
@@ -289,6 +736,7 @@ void ART::Serialize() {
     UpdateMetadata(pointer, meta_writer);
     meta_writer.Flush();
   }
+  writeFilter();
 }
 
 void ART::WritePartialBlocks() {
@@ -300,16 +748,101 @@ void ART::WritePartialBlocks() {
 
 // NOTE: leaf inlined node how to serialize, no need to serialize
 void ART::FastSerialize() {
-  SequentialSerializer writer(index_path_);
-  if (root && !root->IsSerialized()) {
-    writer.Write<block_id_t>(root->GetData());
-    for (auto &fixed_size_allocator : *allocators) {
-      fixed_size_allocator.SerializeBuffers(writer);
+  ScopedLatency latency(IndexOperation::SERIALIZE);
+  {
+    SequentialSerializer writer(index_path_);
+    if (root && !root->IsSerialized()) {
+      writer.Write<block_id_t>(root->GetData());
+      for (auto &fixed_size_allocator : *allocators) {
+        fixed_size_allocator.SerializeBuffers(writer);
+      }
     }
+    writer.Flush();
+  }
+  writeFilter();
+}
+
+std::string ART::FilterPath(const std::string &index_path) { return fmt::format("{}.filter", index_path); }
+
+//! The number of leading index file bytes a filter is tied to, they hold the root pointer in both formats
+static constexpr idx_t FILTER_INDEX_HEAD_SIZE = 16;
+
+static void ReadIndexHead(const std::string &index_path, idx_t &index_size, data_t head[]) {
+  memset(head, 0, FILTER_INDEX_HEAD_SIZE);
+  std::error_code ec;
+  index_size = std::filesystem::file_size(index_path, ec);
+  if (ec) {
+    index_size = 0;
+    return;
   }
+  std::ifstream in(index_path, std::ios::binary);
+  in.read(reinterpret_cast<char *>(head), std::min(index_size, FILTER_INDEX_HEAD_SIZE));
+}
+
+void ART::WriteFilter(const std::string &index_path, const BloomFilter &filter) {
+  idx_t index_size;
+  data_t head[FILTER_INDEX_HEAD_SIZE];
+  ReadIndexHead(index_path, index_size, head);
+
+  auto filter_path = FilterPath(index_path);
+  // NOTE: SequentialSerializer does not truncate
+  std::filesystem::remove(filter_path);
+  SequentialSerializer writer(filter_path);
+  writer.Write<idx_t>(index_size);
+  writer.WriteData(head, FILTER_INDEX_HEAD_SIZE);
+  filter.Serialize(writer);
   writer.Flush();
 }
 
+std::unique_ptr<BloomFilter> ART::ReadFilter(const std::string &index_path) {
+  auto filter_path = FilterPath(index_path);
+  std::error_code ec;
+  auto filter_size = std::filesystem::file_size(filter_path, ec);
+  if (ec || filter_size <= sizeof(idx_t) + FILTER_INDEX_HEAD_SIZE) {
+    return nullptr;
+  }
+  BlockDeserializer reader(filter_path, BlockPointer(0, 0));
+
+  // NOTE: a writer that does not know about filters may have replaced the index since, the filter would hide its keys
+  idx_t index_size;
+  data_t head[FILTER_INDEX_HEAD_SIZE];
+  ReadIndexHead(index_path, index_size, head);
+  data_t filter_head[FILTER_INDEX_HEAD_SIZE];
+  auto filter_index_size = reader.Read<idx_t>();
+  reader.ReadData(filter_head, FILTER_INDEX_HEAD_SIZE);
+  if (filter_index_size != index_size || memcmp(filter_head, head, FILTER_INDEX_HEAD_SIZE) != 0) {
+    return nullptr;
+  }
+  return std::make_unique<BloomFilter>(BloomFilter::Deserialize(reader));
+}
+
+void ART::writeFilter() {
+  if (index_path_.empty()) {
+    return;
+  }
+  // NOTE: a stale filter would hide new keys
+  std::filesystem::remove(FilterPath(index_path_));
+  if (filter_bits_per_key == 0 || !root->IsSet()) {
+    filter.reset();
+    return;
+  }
+
+  // NOTE: a loaded filter kept up with every insert since, rebuilding it would deserialize the whole index
+  if (!filter || filter->IsFull()) {
+    std::vector<uint64_t> hashes;
+    ARTIterator it(*this);
+    for (auto valid = it.SeekToFirst(); valid; valid = it.Next()) {
+      hashes.push_back(BloomFilter::Hash(it.Key()));
+    }
+    filter = std::make_unique<BloomFilter>(hashes.size(), filter_bits_per_key);
+    for (auto hash : hashes) {
+      filter->AddHash(hash);
+    }
+  }
+
+  WriteFilter(index_path_, *filter);
+}
+
 void ART::UpdateMetadata(BlockPointer pointer, Serializer &writer) {
   writer.Write<block_id_t>(pointer.block_id);
   writer.Write<uint32_t>(pointer.offset);
@@ -351,9 +884,13 @@ static idx_t SumNoneLeafCount(ART &art, Node &node, bool count_leaf = false) {
         return 0;
       }
       auto &leaf = Leaf::Get(art, node);
+      if (leaf.IsSegmented() || leaf.IsBitmap()) {
+        return 1 + leaf.row_ids[2];
+      }
       idx_t sum = 1;
-      while (leaf.ptr.IsSet()) {
-        leaf = Leaf::Get(art, leaf.ptr);
+      auto next_node = leaf.ptr;
+      while (next_node.IsSet()) {
+        next_node = Leaf::Get(art, next_node).ptr;
         sum += 1;
       }
       return sum;
@@ -363,6 +900,10 @@ static idx_t SumNoneLeafCount(ART &art, Node &node, bool count_leaf = false) {
         return 1;
       }
       return 0;
+    case NType::LEAF_SEGMENT:
+    case NType::LEAF_BITMAP:
+      // NOTE: chain nodes are counted with their head leaf above
+      throw std::invalid_argument(fmt::format("leaf chain node of type {} outside of a leaf", (uint8_t)type));
     case NType::NODE_4: {
       auto &n4 = Node4::Get(art, node);
       idx_t sum = current;
@@ -382,18 +923,16 @@ static idx_t SumNoneLeafCount(ART &art, Node &node, bool count_leaf = false) {
     case NType::NODE_48: {
       auto &n48 = Node48::Get(art, node);
       idx_t sum = current;
-      for (idx_t i = 0; i < n48.count; i++) {
-        sum += SumNoneLeafCount(art, n48.children[i], count_leaf);
+      for (auto i = n48.occupied.First(); i != ChildBitmap::END; i = n48.occupied.Next(i + 1)) {
+        sum += SumNoneLeafCount(art, n48.children[n48.child_index[i]], count_leaf);
       }
       return sum;
     }
     case NType::NODE_256: {
       auto &n256 = Node256::Get(art, node);
       idx_t sum = current;
-      for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-        if (n256.children[i].IsSet()) {
-          sum += SumNoneLeafCount(art, n256.children[i], count_leaf);
-        }
+      for (auto i = n256.occupied.First(); i != ChildBitmap::END; i = n256.occupied.Next(i + 1)) {
+        sum += SumNoneLeafCount(art, n256.children[i], count_leaf);
       }
       return sum;
     }
@@ -405,6 +944,120 @@ idx_t ART::NoneLeafCount() { return SumNoneLeafCount(*this, *root, false); }
 
 idx_t ART::LeafCount() { return SumNoneLeafCount(*this, *root, true); }
 
-void ART::Merge(ART &other) { root->Merge(*this, *other.root); }
+void ART::checkMergeConflicts(ART &other, ART *deletes) {
+  if (!IsUnique() || !root->IsSet()) {
+    return;
+  }
+  // NOTE: other is usually the smaller delta, so its keys are looked up here instead of walking both trees
+  ARTIterator it(other);
+  std::vector<idx_t> deleted_ids;
+  for (bool valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    auto key = it.Key();
+    auto leaf = lookup(*root, key, 0);
+    if (!leaf) {
+      continue;
+    }
+    auto doc_id = Leaf::FirstDocId(*this, *leaf.value());
+    deleted_ids.clear();
+    if (deletes && deletes->Get(key, deleted_ids) &&
+        std::find(deleted_ids.begin(), deleted_ids.end(), doc_id) != deleted_ids.end()) {
+      continue;
+    }
+    throw std::invalid_argument(
+        fmt::format("duplicate key while merging into a unique index, existing doc id {}", doc_id));
+  }
+}
+
+void ART::Merge(ART &other) {
+  ScopedLatency latency(IndexOperation::MERGE);
+  checkMergeConflicts(other, nullptr);
+  merge(other);
+}
+
+void ART::merge(ART &other) {
+  // NOTE: the keys of other are not in the filter, it matches everything until the next serialization
+  filter.reset();
+  root->Merge(*this, *other.root);
+}
+
+void ART::ApplyDeletes(ART &deletes) {
+  ARTIterator it(deletes);
+  std::vector<idx_t> doc_ids;
+  for (bool valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    doc_ids.clear();
+    it.GetDocIds(doc_ids);
+    erase(*root, it.Key(), 0, doc_ids.data(), doc_ids.size());
+  }
+}
+
+void ART::Merge(ART &other, ART &deletes, idx_t thread_count) {
+  ScopedLatency latency(IndexOperation::MERGE);
+  checkMergeConflicts(other, &deletes);
+  ApplyDeletes(deletes);
+  merge(other, thread_count);
+}
+
+//! A parallel merge splits further down until every thread has this many subtree merges to pick from
+static constexpr idx_t MERGE_TASKS_PER_THREAD = 8;
+static constexpr idx_t MAX_MERGE_SPLIT_DEPTH = 3;
+
+void ART::Merge(ART &other, idx_t thread_count) {
+  ScopedLatency latency(IndexOperation::MERGE);
+  checkMergeConflicts(other, nullptr);
+  merge(other, thread_count);
+}
+
+void ART::merge(ART &other, idx_t thread_count) {
+  std::vector<std::pair<Node *, Node *>> tasks;
+  std::vector<Node *> merged;
+  auto l_root = root.get();
+  auto r_root = other.root.get();
+  Node::SkipEqualPrefixes(*this, l_root, r_root, merged);
+  if (thread_count <= 1 || !l_root->IsInner() || !r_root->IsInner()) {
+    return merge(other);
+  }
+  assert(allocators == other.allocators);
+  filter.reset();
+
+  l_root->SplitMerge(*this, *r_root, tasks, merged);
+  for (idx_t depth = 1; depth < MAX_MERGE_SPLIT_DEPTH && tasks.size() < thread_count * MERGE_TASKS_PER_THREAD;
+       depth++) {
+    std::vector<std::pair<Node *, Node *>> next_tasks;
+    for (auto &[l_child, r_child] : tasks) {
+      if (l_child->IsInner() && r_child->IsInner()) {
+        l_child->SplitMerge(*this, *r_child, next_tasks, merged);
+      } else {
+        next_tasks.emplace_back(l_child, r_child);
+      }
+    }
+    tasks.swap(next_tasks);
+  }
+
+  TaskGroup group(GetTaskScheduler(), thread_count, allocators.get());
+  for (auto &[l_child, r_child] : tasks) {
+    group.Run([this, l_child = l_child, r_child = r_child] { l_child->ResolvePrefixes(*this, *r_child); });
+  }
+  std::exception_ptr error;
+  try {
+    group.Wait();
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  // the split nodes of other only hold moved or merged children now, the deepest ones are freed first
+  for (auto it = merged.rbegin(); it != merged.rend(); it++) {
+    Node::Free(*this, **it);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+TaskScheduler &ART::GetTaskScheduler() {
+  if (!scheduler) {
+    scheduler = TaskScheduler::Default();
+  }
+  return *scheduler;
+}
 
 }  // namespace part
@@ -0,0 +1,144 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "art_iterator.h"
+
+#include <limits>
+
+#include "leaf.h"
+#include "prefix.h"
+
+namespace part {
+
+ARTIterator::ARTIterator(ART &art) : art(art), leaf(nullptr) {}
+
+static inline bool IsLeaf(const Node *node) {
+  return node->GetType() == NType::LEAF || node->GetType() == NType::LEAF_INLINED;
+}
+
+Node *ARTIterator::skipPrefixes(Node *node) {
+  if (node->IsSerialized()) {
+    node->Deserialize(art);
+  }
+  while (node->GetType() == NType::PREFIX) {
+    auto &prefix = Prefix::Get(art, *node);
+    key.insert(key.end(), prefix.data, prefix.data + prefix.data[Node::PREFIX_SIZE]);
+    if (prefix.ptr.IsSerialized()) {
+      prefix.ptr.Deserialize(art);
+    }
+    node = &prefix.ptr;
+  }
+  return node;
+}
+
+void ARTIterator::descendLeftmost(Node *node) {
+  while (true) {
+    node = skipPrefixes(node);
+    if (IsLeaf(node)) {
+      leaf = node;
+      return;
+    }
+    uint8_t byte = 0;
+    auto child = node->GetNextChild(art, byte);
+    assert(child);
+    stack.push_back({node, byte, key.size()});
+    key.push_back(byte);
+    node = child.value();
+  }
+}
+
+bool ARTIterator::advance() {
+  leaf = nullptr;
+  while (!stack.empty()) {
+    auto &frame = stack.back();
+    key.resize(frame.depth);
+    if (frame.byte < Node::NODE_256_CAPACITY - 1) {
+      uint8_t byte = frame.byte + 1;
+      auto child = frame.node->GetNextChild(art, byte);
+      if (child) {
+        frame.byte = byte;
+        key.push_back(byte);
+        descendLeftmost(child.value());
+        return true;
+      }
+    }
+    stack.pop_back();
+  }
+  key.clear();
+  return false;
+}
+
+bool ARTIterator::SeekToFirst() {
+  stack.clear();
+  key.clear();
+  leaf = nullptr;
+  if (!art.root->IsSet()) {
+    return false;
+  }
+  descendLeftmost(art.root.get());
+  return true;
+}
+
+bool ARTIterator::Next() {
+  assert(Valid());
+  return advance();
+}
+
+bool ARTIterator::Seek(const ARTKey &lower) {
+  stack.clear();
+  key.clear();
+  leaf = nullptr;
+  if (!art.root->IsSet()) {
+    return false;
+  }
+
+  auto node = art.root.get();
+  while (true) {
+    auto depth = key.size();
+    node = skipPrefixes(node);
+    for (idx_t i = depth; i < key.size(); i++) {
+      // every key below extends lower or is greater at this byte
+      if (i >= lower.len || key[i] > lower[i]) {
+        descendLeftmost(node);
+        return true;
+      }
+      // every key below is smaller than lower
+      if (key[i] < lower[i]) {
+        return advance();
+      }
+    }
+
+    if (IsLeaf(node)) {
+      // the key is lower itself or a proper prefix of it
+      if (key.size() < lower.len) {
+        return advance();
+      }
+      leaf = node;
+      return true;
+    }
+    if (key.size() >= lower.len) {
+      descendLeftmost(node);
+      return true;
+    }
+
+    uint8_t byte = lower[key.size()];
+    auto child = node->GetNextChild(art, byte);
+    if (!child) {
+      return advance();
+    }
+    stack.push_back({node, byte, key.size()});
+    key.push_back(byte);
+    if (byte > lower[key.size() - 1]) {
+      descendLeftmost(child.value());
+      return true;
+    }
+    node = child.value();
+  }
+}
+
+bool ARTIterator::GetDocIds(std::vector<idx_t> &result_ids) {
+  assert(Valid());
+  return Leaf::GetDocIds(art, *leaf, result_ids, std::numeric_limits<idx_t>::max());
+}
+
+}  // namespace part
@@ -42,7 +42,7 @@ bool ARTKey::operator==(const ARTKey &k) const {
   return std::memcmp(data, k.data, len) == 0;
 }
 
-bool ARTKey::operator<(const ARTKey &k) const { return k >= *this; }
+bool ARTKey::operator<(const ARTKey &k) const { return !(*this >= k); }
 
 // NOTE: 终于知道为什么要加0了
 template <>
@@ -0,0 +1,404 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "art_stream.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <queue>
+
+#include "art.h"
+
+namespace part {
+
+//! A serialized child pointer, block id followed by the offset
+static constexpr idx_t POINTER_SIZE = sizeof(block_id_t) + sizeof(uint32_t);
+
+static inline BlockPointer LoadPointer(const_data_ptr_t ptr) {
+  return BlockPointer(Load<block_id_t>(ptr), Load<uint32_t>(ptr + sizeof(block_id_t)));
+}
+
+ARTStreamReader::ARTStreamReader(const std::string &index_path)
+    : index_path(index_path), buffer_offset(0), buffer_size(0), valid(false) {
+  fd = ::open(index_path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::invalid_argument(fmt::format("cannot open {} index file, error: {}", index_path, strerror(errno)));
+  }
+}
+
+ARTStreamReader::~ARTStreamReader() { ::close(fd); }
+
+const_data_ptr_t ARTStreamReader::read(BlockPointer pointer, idx_t size) {
+  idx_t offset = pointer.block_id * BLOCK_SIZE + pointer.offset;
+  if (offset >= buffer_offset && offset + size <= buffer_offset + buffer_size) {
+    return buffer.data() + (offset - buffer_offset);
+  }
+  buffer.resize(std::max(size, WINDOW_SIZE));
+  auto r = ::pread(fd, buffer.data(), buffer.size(), offset);
+  if (r < 0 || idx_t(r) < size) {
+    throw std::invalid_argument(fmt::format("cannot read {} bytes at {} of {}", size, offset, index_path));
+  }
+  buffer_offset = offset;
+  buffer_size = r;
+  return buffer.data();
+}
+
+bool ARTStreamReader::SeekToFirst() {
+  stack.clear();
+  key.clear();
+  valid = false;
+
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(index_path, ec);
+  // NOTE: ART::Serialize writes nothing for an empty tree
+  if (ec || file_size < META_OFFSET) {
+    return false;
+  }
+  auto root = LoadPointer(read(BlockPointer(0, 0), POINTER_SIZE));
+  if (!root.IsValid()) {
+    return false;
+  }
+  descend(root);
+  return true;
+}
+
+bool ARTStreamReader::Next() {
+  assert(valid);
+  return advance();
+}
+
+void ARTStreamReader::descend(BlockPointer pointer) {
+  while (true) {
+    auto type = NType(*read(pointer, 1));
+    switch (type) {
+      case NType::PREFIX: {
+        auto count = Load<idx_t>(read(pointer, 1 + sizeof(idx_t)) + 1);
+        auto data = read(pointer, 1 + sizeof(idx_t) + count + POINTER_SIZE) + 1 + sizeof(idx_t);
+        key.insert(key.end(), data, data + count);
+        pointer = LoadPointer(data + count);
+        continue;
+      }
+      case NType::LEAF_INLINED: {
+        doc_ids.assign(1, Load<idx_t>(read(pointer, 1 + sizeof(idx_t)) + 1));
+        valid = true;
+        return;
+      }
+      case NType::LEAF: {
+        auto count = Load<idx_t>(read(pointer, 1 + sizeof(idx_t)) + 1);
+        auto data = read(pointer, 1 + sizeof(idx_t) + count * sizeof(idx_t)) + 1 + sizeof(idx_t);
+        doc_ids.resize(count);
+        memcpy(doc_ids.data(), data, count * sizeof(idx_t));
+        valid = true;
+        return;
+      }
+      default:
+        break;
+    }
+
+    Frame frame{{}, 0, key.size()};
+    switch (type) {
+      case NType::NODE_4:
+      case NType::NODE_16: {
+        idx_t capacity = type == NType::NODE_4 ? Node::NODE_4_CAPACITY : Node::NODE_16_CAPACITY;
+        auto data = read(pointer, 2 + capacity + capacity * POINTER_SIZE) + 1;
+        auto count = data[0];
+        for (idx_t i = 0; i < count; i++) {
+          auto child = LoadPointer(data + 1 + capacity + i * POINTER_SIZE);
+          if (child.IsValid()) {
+            frame.children.emplace_back(data[1 + i], child);
+          }
+        }
+        std::sort(frame.children.begin(), frame.children.end(),
+                  [](const auto &a, const auto &b) { return a.first < b.first; });
+        break;
+      }
+      case NType::NODE_48: {
+        auto data = read(pointer, 2 + Node::NODE_256_CAPACITY + Node::NODE_48_CAPACITY * POINTER_SIZE) + 2;
+        for (idx_t byte = 0; byte < Node::NODE_256_CAPACITY; byte++) {
+          auto index = data[byte];
+          if (index == Node::EMPTY_MARKER) {
+            continue;
+          }
+          auto child = LoadPointer(data + Node::NODE_256_CAPACITY + index * POINTER_SIZE);
+          if (child.IsValid()) {
+            frame.children.emplace_back(byte, child);
+          }
+        }
+        break;
+      }
+      case NType::NODE_256: {
+        auto data = read(pointer, 1 + sizeof(uint16_t) + Node::NODE_256_CAPACITY * POINTER_SIZE) + 1 + sizeof(uint16_t);
+        for (idx_t byte = 0; byte < Node::NODE_256_CAPACITY; byte++) {
+          auto child = LoadPointer(data + byte * POINTER_SIZE);
+          if (child.IsValid()) {
+            frame.children.emplace_back(byte, child);
+          }
+        }
+        break;
+      }
+      default:
+        throw std::invalid_argument(fmt::format("unexpected node type {} in {}", uint8_t(type), index_path));
+    }
+
+    if (frame.children.empty()) {
+      throw std::invalid_argument(fmt::format("inner node without children in {}", index_path));
+    }
+    key.push_back(frame.children[0].first);
+    pointer = frame.children[0].second;
+    stack.push_back(std::move(frame));
+  }
+}
+
+bool ARTStreamReader::advance() {
+  valid = false;
+  while (!stack.empty()) {
+    auto &frame = stack.back();
+    key.resize(frame.depth);
+    frame.pos++;
+    if (frame.pos < frame.children.size()) {
+      key.push_back(frame.children[frame.pos].first);
+      // NOTE: descend pushes onto the stack, which invalidates frame
+      descend(frame.children[frame.pos].second);
+      return true;
+    }
+    stack.pop_back();
+  }
+  key.clear();
+  return false;
+}
+
+ARTStreamWriter::ARTStreamWriter(const std::string &index_path, idx_t expected_keys, idx_t bits_per_key)
+    : index_path(index_path), key_count(0), finished(false), bits_per_key(bits_per_key) {
+  // NOTE: SequentialSerializer does not truncate
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+  writer = std::make_unique<SequentialSerializer>(index_path, META_OFFSET);
+  if (expected_keys > 0 && bits_per_key > 0) {
+    filter = std::make_unique<BloomFilter>(expected_keys, bits_per_key);
+  }
+}
+
+void ARTStreamWriter::writePointer(const BlockPointer &pointer) {
+  writer->Write<block_id_t>(pointer.block_id);
+  writer->Write<uint32_t>(pointer.offset);
+}
+
+BlockPointer ARTStreamWriter::writeLeaf(const std::vector<idx_t> &doc_ids) {
+  auto pointer = writer->GetBlockPointer();
+  if (doc_ids.size() == 1 && doc_ids[0] <= Node::AND_RESET) {
+    writer->Write(NType::LEAF_INLINED);
+    writer->Write<idx_t>(doc_ids[0]);
+    return pointer;
+  }
+  writer->Write(NType::LEAF);
+  writer->Write<idx_t>(doc_ids.size());
+  writer->WriteData(const_data_ptr_cast(doc_ids.data()), doc_ids.size() * sizeof(idx_t));
+  return pointer;
+}
+
+BlockPointer ARTStreamWriter::writeInner(const OpenNode &node) {
+  auto pointer = writer->GetBlockPointer();
+  auto count = node.children.size();
+  assert(count >= 2);
+
+  // NOTE: the smallest node type that fits, the same layouts Node4 to Node256 serialize
+  if (count <= Node::NODE_16_CAPACITY) {
+    idx_t capacity = count <= Node::NODE_4_CAPACITY ? Node::NODE_4_CAPACITY : Node::NODE_16_CAPACITY;
+    writer->Write(count <= Node::NODE_4_CAPACITY ? NType::NODE_4 : NType::NODE_16);
+    writer->Write<uint8_t>(count);
+    for (idx_t i = 0; i < capacity; i++) {
+      writer->Write<uint8_t>(i < count ? node.children[i].first : 0);
+    }
+    for (idx_t i = 0; i < capacity; i++) {
+      writePointer(i < count ? node.children[i].second : BlockPointer());
+    }
+    return pointer;
+  }
+
+  if (count <= Node::NODE_48_CAPACITY) {
+    uint8_t child_index[Node::NODE_256_CAPACITY];
+    memset(child_index, Node::EMPTY_MARKER, sizeof(child_index));
+    for (idx_t i = 0; i < count; i++) {
+      child_index[node.children[i].first] = i;
+    }
+    writer->Write(NType::NODE_48);
+    writer->Write<uint8_t>(count);
+    writer->WriteData(child_index, sizeof(child_index));
+    for (idx_t i = 0; i < Node::NODE_48_CAPACITY; i++) {
+      writePointer(i < count ? node.children[i].second : BlockPointer());
+    }
+    return pointer;
+  }
+
+  BlockPointer children[Node::NODE_256_CAPACITY];
+  for (auto &child : node.children) {
+    children[child.first] = child.second;
+  }
+  writer->Write(NType::NODE_256);
+  writer->Write<uint16_t>(count);
+  for (auto &child : children) {
+    writePointer(child);
+  }
+  return pointer;
+}
+
+BlockPointer ARTStreamWriter::attach(const Pending &pending, idx_t start) {
+  if (pending.depth <= start) {
+    return pending.pointer;
+  }
+  auto pointer = writer->GetBlockPointer();
+  writer->Write(NType::PREFIX);
+  writer->Write<idx_t>(pending.depth - start);
+  writer->WriteData(last_key.data() + start, pending.depth - start);
+  writePointer(pending.pointer);
+  return pointer;
+}
+
+void ARTStreamWriter::Append(const ARTKey &key, const std::vector<idx_t> &doc_ids) {
+  if (finished) {
+    throw std::invalid_argument("cannot append to a finished ARTStreamWriter");
+  }
+  if (doc_ids.empty()) {
+    throw std::invalid_argument("cannot append a key without doc ids");
+  }
+
+  if (key_count > 0) {
+    idx_t lcp = 0;
+    while (lcp < key.len && lcp < last_key.size() && key[lcp] == last_key[lcp]) {
+      lcp++;
+    }
+    if (lcp == key.len || lcp == last_key.size()) {
+      throw std::invalid_argument("a key must not be a prefix of another key");
+    }
+    if (key[lcp] < last_key[lcp]) {
+      throw std::invalid_argument("keys must be appended in ascending order");
+    }
+
+    // every open node below the first differing byte is complete now
+    while (!stack.empty() && stack.back().depth > lcp) {
+      auto &node = stack.back();
+      node.children.emplace_back(last_key[node.depth], attach(pending, node.depth + 1));
+      pending = {writeInner(node), node.depth};
+      stack.pop_back();
+    }
+    if (stack.empty() || stack.back().depth < lcp) {
+      stack.push_back({lcp, {}});
+    }
+    stack.back().children.emplace_back(last_key[lcp], attach(pending, lcp + 1));
+  }
+
+  pending = {writeLeaf(doc_ids), key.len};
+  last_key.assign(key.data, key.data + key.len);
+  key_count++;
+
+  if (filter) {
+    filter->Add(key);
+  } else if (bits_per_key > 0) {
+    hashes.push_back(BloomFilter::Hash(key));
+  }
+}
+
+void ARTStreamWriter::Finish() {
+  if (finished) {
+    return;
+  }
+  finished = true;
+  if (key_count == 0) {
+    writer->Flush();
+    writer.reset();
+    return;
+  }
+
+  while (!stack.empty()) {
+    auto &node = stack.back();
+    node.children.emplace_back(last_key[node.depth], attach(pending, node.depth + 1));
+    pending = {writeInner(node), node.depth};
+    stack.pop_back();
+  }
+  auto root = attach(pending, 0);
+  writer->Flush();
+  writer.reset();
+
+  SequentialSerializer meta_writer(index_path);
+  meta_writer.Write<block_id_t>(root.block_id);
+  meta_writer.Write<uint32_t>(root.offset);
+  meta_writer.Flush();
+
+  if (!filter && bits_per_key > 0) {
+    filter = std::make_unique<BloomFilter>(hashes.size(), bits_per_key);
+    for (auto hash : hashes) {
+      filter->AddHash(hash);
+    }
+    hashes = std::vector<uint64_t>();
+  }
+  if (filter) {
+    ART::WriteFilter(index_path, *filter);
+  }
+}
+
+idx_t ARTStreamWriter::MergeFiles(const std::vector<std::string> &input_paths, const std::string &output_path,
+                                  idx_t bits_per_key) {
+  if (std::find(input_paths.begin(), input_paths.end(), output_path) != input_paths.end()) {
+    throw std::invalid_argument(fmt::format("cannot merge {} into itself", output_path));
+  }
+
+  // the input filters bound the number of distinct keys, so the output filter is sized without a hash per key
+  idx_t expected_keys = 0;
+  for (auto &input_path : input_paths) {
+    auto input_filter = ART::ReadFilter(input_path);
+    if (!input_filter) {
+      expected_keys = 0;
+      break;
+    }
+    expected_keys += input_filter->Capacity();
+  }
+
+  std::vector<std::unique_ptr<ARTStreamReader>> readers;
+  for (auto &input_path : input_paths) {
+    readers.push_back(std::make_unique<ARTStreamReader>(input_path));
+  }
+
+  // k-way merge over the inputs, the smallest key on top and the first input first among equal keys
+  auto greater = [&](idx_t a, idx_t b) {
+    auto a_key = readers[a]->Key();
+    auto b_key = readers[b]->Key();
+    return b_key < a_key || (a_key == b_key && b < a);
+  };
+  std::priority_queue<idx_t, std::vector<idx_t>, decltype(greater)> heap(greater);
+  for (idx_t i = 0; i < readers.size(); i++) {
+    if (readers[i]->SeekToFirst()) {
+      heap.push(i);
+    }
+  }
+
+  ARTStreamWriter writer(output_path, expected_keys, bits_per_key);
+  std::vector<data_t> key_data;
+  std::vector<idx_t> doc_ids;
+  while (!heap.empty()) {
+    auto i = heap.top();
+    heap.pop();
+    auto key = readers[i]->Key();
+    key_data.assign(key.data, key.data + key.len);
+    doc_ids = readers[i]->DocIds();
+    if (readers[i]->Next()) {
+      heap.push(i);
+    }
+    ARTKey current(key_data.data(), key_data.size());
+    while (!heap.empty() && readers[heap.top()]->Key() == current) {
+      auto j = heap.top();
+      heap.pop();
+      auto &other_ids = readers[j]->DocIds();
+      doc_ids.insert(doc_ids.end(), other_ids.begin(), other_ids.end());
+      if (readers[j]->Next()) {
+        heap.push(j);
+      }
+    }
+    writer.Append(current, doc_ids);
+  }
+  writer.Finish();
+  return writer.KeyCount();
+}
+
+}  // namespace part
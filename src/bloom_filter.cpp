@@ -0,0 +1,90 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "bloom_filter.h"
+
+#include <algorithm>
+
+namespace part {
+
+BloomFilter::BloomFilter(idx_t expected_keys, idx_t bits_per_key) : capacity(expected_keys) {
+  bits_per_key = std::max<idx_t>(bits_per_key, 1);
+  // k = bits_per_key * ln(2) minimizes the false positive rate
+  probe_count = std::clamp<uint32_t>(static_cast<uint32_t>(bits_per_key * 69 / 100), 1, 16);
+  auto block_count = std::max<idx_t>((expected_keys * bits_per_key + BLOCK_BITS - 1) / BLOCK_BITS, 1);
+  words.resize(block_count * WORDS_PER_BLOCK, 0);
+}
+
+uint64_t BloomFilter::Hash(const ARTKey &key) {
+  // FNV-1a followed by the murmur3 finalizer, so short integer keys still spread over all bits
+  uint64_t hash = 14695981039346656037ULL;
+  for (idx_t i = 0; i < key.len; i++) {
+    hash ^= key.data[i];
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+const uint64_t *BloomFilter::block(uint64_t hash) const {
+  auto block_count = words.size() / WORDS_PER_BLOCK;
+  // NOTE: multiply and shift maps the high bits onto the block range without a division
+  auto block_id = static_cast<idx_t>((static_cast<__uint128_t>(hash >> 32) * block_count) >> 32);
+  return words.data() + block_id * WORDS_PER_BLOCK;
+}
+
+void BloomFilter::AddHash(uint64_t hash) {
+  assert(!IsEmpty());
+  count++;
+  auto target = const_cast<uint64_t *>(block(hash));
+  auto h1 = static_cast<uint32_t>(hash);
+  auto h2 = static_cast<uint32_t>((hash >> 32) | 1);
+  for (uint32_t i = 0; i < probe_count; i++) {
+    auto bit = (h1 + i * h2) % BLOCK_BITS;
+    target[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+}
+
+bool BloomFilter::MayContainHash(uint64_t hash) const {
+  if (IsEmpty()) {
+    return true;
+  }
+  auto target = block(hash);
+  auto h1 = static_cast<uint32_t>(hash);
+  auto h2 = static_cast<uint32_t>((hash >> 32) | 1);
+  for (uint32_t i = 0; i < probe_count; i++) {
+    auto bit = (h1 + i * h2) % BLOCK_BITS;
+    if (!(target[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BloomFilter::Serialize(Serializer &writer) const {
+  writer.Write<uint32_t>(probe_count);
+  writer.Write<idx_t>(capacity);
+  writer.Write<idx_t>(count);
+  writer.Write<idx_t>(words.size());
+  writer.WriteData(reinterpret_cast<const_data_ptr_t>(words.data()), words.size() * sizeof(uint64_t));
+}
+
+BloomFilter BloomFilter::Deserialize(Deserializer &reader) {
+  BloomFilter filter;
+  filter.probe_count = reader.Read<uint32_t>();
+  filter.capacity = reader.Read<idx_t>();
+  filter.count = reader.Read<idx_t>();
+  auto word_count = reader.Read<idx_t>();
+  if (word_count % WORDS_PER_BLOCK != 0) {
+    throw std::invalid_argument(fmt::format("corrupted bloom filter with {} words", word_count));
+  }
+  filter.words.resize(word_count);
+  reader.ReadData(reinterpret_cast<data_ptr_t>(filter.words.data()), word_count * sizeof(uint64_t));
+  return filter;
+}
+
+}  // namespace part
@@ -0,0 +1,122 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "buffered_concurrent_art.h"
+
+#include <algorithm>
+
+namespace part {
+
+BufferedConcurrentART::Writer::Writer(BufferedConcurrentART &owner)
+    : owner(owner), memtable(std::make_unique<ART>()), count(0) {}
+
+BufferedConcurrentART::Writer::~Writer() { Flush(); }
+
+void BufferedConcurrentART::Writer::Put(const ARTKey &key, idx_t doc_id) {
+  memtable->Put(key, doc_id);
+  count++;
+  if (count >= owner.memtable_limit) {
+    Flush();
+  }
+}
+
+void BufferedConcurrentART::Writer::Flush() {
+  if (count == 0) {
+    return;
+  }
+  owner.handOff(std::move(memtable));
+  memtable = std::make_unique<ART>();
+  count = 0;
+}
+
+BufferedConcurrentART::BufferedConcurrentART(ConcurrentART &cart, idx_t memtable_limit, idx_t max_pending,
+                                             std::shared_ptr<TaskScheduler> scheduler_p)
+    : cart(cart),
+      memtable_limit(std::max<idx_t>(memtable_limit, 1)),
+      max_pending(std::max<idx_t>(max_pending, 1)),
+      merged_count(0),
+      scheduler(scheduler_p ? std::move(scheduler_p) : TaskScheduler::Default()),
+      merges(*scheduler, 1) {}
+
+std::unique_ptr<BufferedConcurrentART::Writer> BufferedConcurrentART::NewWriter() {
+  return std::make_unique<Writer>(*this);
+}
+
+void BufferedConcurrentART::handOff(std::unique_ptr<ART> art) {
+  auto memtable = std::make_shared<Memtable>();
+  memtable->art = std::move(art);
+
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    merged_cv.wait(guard, [this] { return pending.size() < max_pending; });
+    pending.push_back(std::move(memtable));
+  }
+  // NOTE: the group runs one merge at a time in the order they were queued, so every task merges the memtable it
+  // was queued for
+  merges.Run([this] { mergeFront(); });
+}
+
+void BufferedConcurrentART::mergeFront() {
+  std::shared_ptr<Memtable> memtable;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    memtable = pending.front();
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> memtable_guard(memtable->lock);
+    cart.Merge(*memtable->art);
+    memtable->merged = true;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.pop_front();
+    merged_count++;
+  }
+  merged_cv.notify_all();
+}
+
+bool BufferedConcurrentART::Get(const ARTKey &key, std::vector<idx_t> &result_ids) {
+  std::vector<std::shared_ptr<Memtable>> snapshot;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    snapshot.assign(pending.begin(), pending.end());
+  }
+
+  // NOTE: the memtables stay read locked until the concurrent tree is read as well. A memtable which is already merged
+  // is skipped, its doc ids are in the concurrent tree by then, any other cannot be merged in between, so every doc
+  // id is read exactly once
+  std::vector<std::shared_lock<std::shared_mutex>> memtable_guards;
+  memtable_guards.reserve(snapshot.size());
+  std::vector<idx_t> pending_ids;
+  for (auto &memtable : snapshot) {
+    memtable_guards.emplace_back(memtable->lock);
+    if (!memtable->merged) {
+      memtable->art->Get(key, pending_ids);
+    }
+  }
+
+  // NOTE: ConcurrentART::Get clears its result on a retry
+  std::vector<idx_t> merged_ids;
+  cart.Get(key, merged_ids);
+  memtable_guards.clear();
+
+  result_ids.insert(result_ids.end(), merged_ids.begin(), merged_ids.end());
+  result_ids.insert(result_ids.end(), pending_ids.begin(), pending_ids.end());
+  return !merged_ids.empty() || !pending_ids.empty();
+}
+
+void BufferedConcurrentART::WaitMerged() { merges.Wait(); }
+
+idx_t BufferedConcurrentART::PendingCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  return pending.size();
+}
+
+idx_t BufferedConcurrentART::MergedCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  return merged_count;
+}
+
+}  // namespace part
@@ -5,8 +5,10 @@
 
 #include <fmt/core.h>
 
+#include <filesystem>
 #include <thread>
 
+#include "latency_histogram.h"
 #include "leaf.h"
 #include "node16.h"
 #include "node256.h"
@@ -16,17 +18,106 @@
 
 namespace part {
 
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+//! Waits before a restart: spins for twice as long as before on every restart up to MAX_SPINS, then yields
+class RestartBackoff {
+ public:
+  void Wait() {
+    if (spins <= MAX_SPINS) {
+      for (idx_t i = 0; i < spins; i++) {
+        CpuRelax();
+      }
+      spins <<= 1;
+      return;
+    }
+    ContentionCounters::Global().yields.fetch_add(1, std::memory_order_relaxed);
+    std::this_thread::yield();
+  }
+
+ private:
+  static constexpr idx_t MIN_SPINS = 4;
+  static constexpr idx_t MAX_SPINS = 1024;
+  idx_t spins = MIN_SPINS;
+};
+
+//! Counted as each restart happens rather than once the operation is done, a thread stuck retrying is visible
+static void RecordRestart(std::atomic<uint64_t>& counter, bool from_root) {
+  counter.fetch_add(1, std::memory_order_relaxed);
+  if (from_root) {
+    ContentionCounters::Global().root_restarts.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
 bool ConcurrentART::Get(const part::ARTKey& key, std::vector<idx_t>& result_ids) {
-  //  fmt::println("root readers: {}", root->Readers());
-  while (lookup(root.get(), key, 0, result_ids)) {
+  ScopedLatency latency(IndexOperation::GET);
+  return get(key, result_ids, std::numeric_limits<idx_t>::max());
+}
+
+bool ConcurrentART::Contains(const ARTKey& key) {
+  idx_t doc_id;
+  return GetFirst(key, doc_id);
+}
+
+bool ConcurrentART::GetFirst(const ARTKey& key, idx_t& doc_id) {
+  ScopedLatency latency(IndexOperation::GET);
+  std::vector<idx_t> result_ids;
+  result_ids.reserve(1);
+  if (!get(key, result_ids, 1)) {
+    return false;
+  }
+  doc_id = result_ids[0];
+  return true;
+}
+
+bool ConcurrentART::get(const ARTKey& key, std::vector<idx_t>& result_ids, idx_t max_count) {
+  RestartPoint restart;
+  RestartBackoff backoff;
+  idx_t depth;
+  auto node = lockRestartNode(restart, depth);
+  while (lookup(node, key, depth, result_ids, restart, max_count)) {
     result_ids.clear();
-    std::this_thread::yield();
+    backoff.Wait();
+    node = lockRestartNode(restart, depth);
+    RecordRestart(ContentionCounters::Global().get_restarts, node == root.get());
   }
   return !result_ids.empty();
 }
 
-bool ConcurrentART::lookup(ConcurrentNode* next_node, const ARTKey& key, idx_t depth, std::vector<idx_t>& result_ids) {
-  next_node->RLock();
+ConcurrentNode* ConcurrentART::lockRestartNode(RestartPoint& restart, idx_t& depth) {
+  if (restart.node && restart.epoch != INVALID_INDEX && restart.epoch == merge_epoch_.load()) {
+    restart.node->RLock();
+    // NOTE: a deleted node may be reused elsewhere, only a live inner node is still where it was passed
+    if (!restart.node->IsDeleted() && restart.node->IsInner()) {
+      depth = restart.depth;
+      return restart.node;
+    }
+    restart.node->RUnlock();
+  }
+  restart.node = nullptr;
+  // NOTE: the epoch is read before the running merges, a merge beginning in between bumps the epoch
+  restart.epoch = merge_epoch_.load();
+  if (active_merges_.load() > 0) {
+    restart.epoch = INVALID_INDEX;
+  }
+  root->RLock();
+  depth = 0;
+  return root.get();
+}
+
+ContentionStats ConcurrentART::GetContentionStats() { return ContentionCounters::Global().Snapshot(); }
+
+void ConcurrentART::ResetContentionStats() { ContentionCounters::Global().Reset(); }
+
+bool ConcurrentART::lookup(ConcurrentNode* next_node, const ARTKey& key, idx_t depth, std::vector<idx_t>& result_ids,
+                           RestartPoint& restart, idx_t max_count) {
+  assert(next_node->RLocked());
   if (!next_node->IsSet()) {
     next_node->RUnlock();
     return false;
@@ -65,11 +156,13 @@ bool ConcurrentART::lookup(ConcurrentNode* next_node, const ARTKey& key, idx_t d
     if (next_node->GetType() == NType::LEAF) {
       auto& cleaf = CLeaf::Get(*this, *next_node);
       // NOTE: GetDocIds already released lock
-      cleaf.GetDocIds(*this, *next_node, result_ids, std::numeric_limits<int64_t>::max(), retry);
+      cleaf.GetDocIds(*this, *next_node, result_ids, max_count, retry);
       return retry;
     }
 
     assert(depth < key.len);
+    restart.node = next_node;
+    restart.depth = depth;
     auto child = next_node->GetChild(*this, key[depth]);
     if (!child) {
       // cannot found node
@@ -98,18 +191,30 @@ bool ConcurrentART::lookup(ConcurrentNode* next_node, const ARTKey& key, idx_t d
 }
 
 void ConcurrentART::Put(const ARTKey& key, idx_t doc_id) {
-  bool retry = false;
-  do {
-    root->RLock();
-    retry = insert(*root, key, 0, doc_id);
-    if (retry) {
-      std::this_thread::yield();
-    }
-  } while (retry);
+  ScopedLatency latency(IndexOperation::PUT);
+  put(key, doc_id, false);
+}
+
+void ConcurrentART::Upsert(const ARTKey& key, idx_t doc_id) {
+  ScopedLatency latency(IndexOperation::PUT);
+  put(key, doc_id, true);
+}
+
+void ConcurrentART::put(const ARTKey& key, idx_t doc_id, bool replace) {
+  RestartPoint restart;
+  RestartBackoff backoff;
+  idx_t depth;
+  auto node = lockRestartNode(restart, depth);
+  while (insert(*node, key, depth, doc_id, restart, replace)) {
+    backoff.Wait();
+    node = lockRestartNode(restart, depth);
+    RecordRestart(ContentionCounters::Global().put_restarts, node == root.get());
+  }
 }
 
 // NOTE: never hold locks after the insert
-bool ConcurrentART::insert(ConcurrentNode& node, const ARTKey& key, idx_t depth, const idx_t& doc_id) {
+bool ConcurrentART::insert(ConcurrentNode& node, const ARTKey& key, idx_t depth, const idx_t& doc_id,
+                           RestartPoint& restart, bool replace) {
   assert(node.RLocked());
   if (node.IsDeleted()) {
     node.RUnlock();
@@ -134,7 +239,7 @@ bool ConcurrentART::insert(ConcurrentNode& node, const ARTKey& key, idx_t depth,
 
   if (node_type == NType::LEAF || node_type == NType::LEAF_INLINED) {
     // insert into leaf
-    return insertToLeaf(&node, doc_id);
+    return insertToLeaf(&node, doc_id, replace);
   }
 
   if (node_type != NType::PREFIX) {
@@ -143,9 +248,11 @@ bool ConcurrentART::insert(ConcurrentNode& node, const ARTKey& key, idx_t depth,
     node.Upgrade();
     auto child = node.GetChild(*this, key[depth]);
     if (child) {
+      restart.node = &node;
+      restart.depth = depth;
       node.Unlock();
       child.value()->RLock();
-      return insert(*child.value(), key, depth + 1, doc_id);
+      return insert(*child.value(), key, depth + 1, doc_id, restart, replace);
     }
     ConcurrentNode* new_node = AllocateNode();
     ConcurrentNode* next_node = new_node;
@@ -178,7 +285,7 @@ bool ConcurrentART::insert(ConcurrentNode& node, const ARTKey& key, idx_t depth,
 
   assert(next_node->RLocked());
   if (next_node->GetType() != NType::PREFIX) {
-    return insert(*next_node, key, depth, doc_id);
+    return insert(*next_node, key, depth, doc_id, restart, replace);
   }
 
   ConcurrentNode* remaining_prefix_node = nullptr;
@@ -291,11 +398,16 @@ ConcurrentART::~ConcurrentART() {
   }
 }
 
-bool ConcurrentART::insertToLeaf(ConcurrentNode* leaf, idx_t doc_id) {
+bool ConcurrentART::insertToLeaf(ConcurrentNode* leaf, idx_t doc_id, bool replace) {
   assert(leaf->RLocked());
   bool retry = false;
   // make sure leaf unlocked after insert
   leaf->Upgrade();
+  if (replace) {
+    CLeaf::Replace(*this, leaf, doc_id);
+    leaf->Unlock();
+    return false;
+  }
   CLeaf::Insert(*this, leaf, doc_id, retry);
   assert(!leaf->Locked());
   return retry;
@@ -309,6 +421,9 @@ ConcurrentNode* ConcurrentART::AllocateNode() {
 }
 
 void ConcurrentART::Serialize() {
+  ScopedLatency latency(IndexOperation::SERIALIZE);
+  // NOTE: no key filter is written, the filter of an index written before to the same path would hide new keys
+  std::filesystem::remove(ART::FilterPath(index_path_));
   root->RLock();
   if (root->IsSet()) {
     SequentialSerializer data_writer(index_path_, META_OFFSET);
@@ -329,12 +444,20 @@ void ConcurrentART::UpdateMetadata(BlockPointer pointer, Serializer& writer) {
 
 // NOTE: no need to retry ???
 void ConcurrentART::Merge(ART& other) {
+  ScopedLatency latency(IndexOperation::MERGE);
+  // NOTE: merging moves subtrees without deleting their nodes, retries of the meantime go back to the root
+  active_merges_.fetch_add(1);
+  merge_epoch_.fetch_add(1);
   root->RLock();
   root->Merge(*this, other, *other.root);
+  merge_epoch_.fetch_add(1);
+  active_merges_.fetch_sub(1);
 }
 
 void ConcurrentART::FastSerialize() {
+  ScopedLatency latency(IndexOperation::SERIALIZE);
   assert(index_fd_ != -1);
+  std::filesystem::remove(ART::FilterPath(index_path_));
   SequentialSerializer writer(index_path_);
 
   if (root) {
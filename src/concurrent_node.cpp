@@ -26,111 +26,110 @@ static std::string ToStr(uint8_t byte) {
   return std::to_string((uint32_t)byte);
 }
 
+ContentionCounters& ContentionCounters::Global() {
+  static ContentionCounters counters;
+  return counters;
+}
+
+ContentionStats ContentionCounters::Snapshot() const {
+  ContentionStats stats;
+  stats.rlock_spins = rlock_spins.load(std::memory_order_relaxed);
+  stats.lock_spins = lock_spins.load(std::memory_order_relaxed);
+  stats.upgrade_spins = upgrade_spins.load(std::memory_order_relaxed);
+  stats.unlock_spins = unlock_spins.load(std::memory_order_relaxed);
+  stats.yields = yields.load(std::memory_order_relaxed);
+  stats.get_restarts = get_restarts.load(std::memory_order_relaxed);
+  stats.put_restarts = put_restarts.load(std::memory_order_relaxed);
+  stats.root_restarts = root_restarts.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void ContentionCounters::Reset() {
+  rlock_spins = 0;
+  lock_spins = 0;
+  upgrade_spins = 0;
+  unlock_spins = 0;
+  yields = 0;
+  get_restarts = 0;
+  put_restarts = 0;
+  root_restarts = 0;
+}
+
+//! Called after a failed attempt, yields every RETRY_THRESHOLD spins
+static inline void Backoff(uint64_t& spins) {
+  spins++;
+  if (spins % RETRY_THRESHOLD == 0) {
+    std::this_thread::yield();
+  }
+}
+
+//! Publishes the spins of one lock call, the counters are shared so they are only touched after a wait
+static inline void RecordSpins(std::atomic<uint64_t>& counter, uint64_t spins) {
+  if (spins == 0) {
+    return;
+  }
+  auto& counters = ContentionCounters::Global();
+  counter.fetch_add(spins, std::memory_order_relaxed);
+  if (spins >= RETRY_THRESHOLD) {
+    counters.yields.fetch_add(spins / RETRY_THRESHOLD, std::memory_order_relaxed);
+  }
+}
+
 void ConcurrentNode::RLock() {
-  int retry = 0;
-  auto start = std::chrono::high_resolution_clock::now();
+  uint64_t spins = 0;
   while (true) {
     uint64_t prev = lock_.load();
     if (prev != HAS_WRITER) {
       uint64_t next = prev + 1;
       if (lock_.compare_exchange_weak(prev, next)) {
+        RecordSpins(ContentionCounters::Global().rlock_spins, spins);
         return;
       }
     }
-    retry++;
-    if (retry > RETRY_THRESHOLD) {
-      retry = 0;
-      std::this_thread::yield();
-      auto end = std::chrono::high_resolution_clock::now();
-
-      // 计算耗时
-      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-      if (duration > 100) {
-        fmt::println("debug point RLock");
-      }
-    }
+    Backoff(spins);
   }
 }
 
 void ConcurrentNode::RUnlock() {
-  int retry = 0;
-  //  fmt::println("debug RUnlock {}", static_cast<void *>(this));
-  auto start = std::chrono::high_resolution_clock::now();
+  uint64_t spins = 0;
   while (true) {
     uint64_t prev = lock_;
     if (prev != HAS_WRITER && prev > 0) {
       uint64_t next = prev - 1;
       if (lock_.compare_exchange_weak(prev, next)) {
+        RecordSpins(ContentionCounters::Global().unlock_spins, spins);
         return;
       }
     }
-    retry++;
-    if (retry > RETRY_THRESHOLD) {
-      retry = 0;
-      std::this_thread::yield();
-      auto end = std::chrono::high_resolution_clock::now();
-
-      // 计算耗时
-      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-      if (duration > 100) {
-        fmt::println("debug point RUnlock");
-      }
-    }
+    Backoff(spins);
   }
 }
 
 void ConcurrentNode::Lock() {
-  int retry = 0;
-  auto start = std::chrono::high_resolution_clock::now();
-
+  uint64_t spins = 0;
   while (true) {
     uint64_t prev = lock_;
     if (prev == 0) {
       if (lock_.compare_exchange_weak(prev, HAS_WRITER)) {
+        RecordSpins(ContentionCounters::Global().lock_spins, spins);
         return;
       }
     }
-
-    retry++;
-    if (retry > RETRY_THRESHOLD) {
-      retry = 0;
-      std::this_thread::yield();
-
-      auto end = std::chrono::high_resolution_clock::now();
-
-      // 计算耗时
-      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-      if (duration > 100) {
-        fmt::println("debug point Lock");
-      }
-    }
+    Backoff(spins);
   }
 }
 
 void ConcurrentNode::Unlock() {
-  int retry = 0;
-  //  fmt::println("debug Unlock {}", static_cast<void *>(this));
-  auto start = std::chrono::high_resolution_clock::now();
+  uint64_t spins = 0;
   while (true) {
     uint64_t prev = lock_;
     if (prev == HAS_WRITER) {
       if (lock_.compare_exchange_weak(prev, 0)) {
+        RecordSpins(ContentionCounters::Global().unlock_spins, spins);
         return;
       }
     }
-    retry++;
-    if (retry > RETRY_THRESHOLD) {
-      retry = 0;
-      std::this_thread::yield();
-
-      auto end = std::chrono::high_resolution_clock::now();
-
-      // 计算耗时
-      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-      if (duration > 100) {
-        fmt::println("debug point Unlock");
-      }
-    }
+    Backoff(spins);
   }
 }
 
@@ -140,26 +139,15 @@ void ConcurrentNode::Downgrade() {
 }
 
 void ConcurrentNode::Upgrade() {
-  int retry = 0;
-  auto start = std::chrono::high_resolution_clock::now();
+  uint64_t spins = 0;
   while (true) {
     // NOTE: only one reader can upgrade to writer
     uint64_t prev = 1;
     if (lock_.compare_exchange_weak(prev, HAS_WRITER)) {
+      RecordSpins(ContentionCounters::Global().upgrade_spins, spins);
       return;
     }
-    retry++;
-    if (retry > RETRY_THRESHOLD) {
-      retry = 0;
-      std::this_thread::yield();
-      auto end = std::chrono::high_resolution_clock::now();
-
-      // 计算耗时
-      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-      if (duration > 100) {
-        fmt::println("debug point Upgrade");
-      }
-    }
+    Backoff(spins);
   }
 }
 
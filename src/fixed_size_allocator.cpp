@@ -14,6 +14,8 @@ namespace part {
 constexpr idx_t FixedSizeAllocator::BASE[];
 constexpr uint8_t FixedSizeAllocator::SHIFT[];
 
+thread_local AllocatorCache *FixedSizeAllocator::thread_cache = nullptr;
+
 FixedSizeAllocator::FixedSizeAllocator(const idx_t allocation_size, Allocator &allocator)
     : allocation_size(allocation_size), total_allocations(0), allocator(allocator) {
   initMaskData();
@@ -42,9 +44,29 @@ void FixedSizeAllocator::initMaskData() {
   allocation_offset = bitmask_count * sizeof(validity_t);
 }
 
+BufferTable::BufferTable(const BufferTable &other) {
+  for (idx_t i = 0; i < other.size(); i++) {
+    emplace_back(other[i].ptr, other[i].allocation_count);
+  }
+}
+
+void BufferTable::emplace_back(data_ptr_t ptr, idx_t allocation_count) {
+  auto index = size();
+  auto chunk = std::bit_width(index + FIRST_CHUNK_SIZE) - 1 - FIRST_CHUNK_BITS;
+  if (chunk >= MAX_CHUNKS) {
+    throw std::invalid_argument(fmt::format("buffer list exceeds {} buffers", index));
+  }
+  if (!chunks[chunk]) {
+    chunks[chunk] = std::make_unique<BufferEntry[]>(FIRST_CHUNK_SIZE << chunk);
+  }
+  (*this)[index] = BufferEntry(ptr, allocation_count);
+  // NOTE: published last, a reader never sees an index before its entry
+  count.store(index + 1, std::memory_order_release);
+}
+
 FixedSizeAllocator::~FixedSizeAllocator() {
-  for (auto &buffer : buffers) {
-    allocator.FreeData(buffer.ptr, BUFFER_ALLOC_SIZE);
+  for (idx_t i = 0; i < buffers.size(); i++) {
+    allocator.FreeData(buffers[i].ptr, BUFFER_ALLOC_SIZE);
   }
 }
 
@@ -94,6 +116,13 @@ uint32_t FixedSizeAllocator::GetOffset(ValidityMask &mask, idx_t allocation_coun
 }
 
 Node FixedSizeAllocator::New() {
+  if (thread_cache && thread_cache->Covers(*this)) {
+    return thread_cache->New(*this);
+  }
+  return newNode();
+}
+
+Node FixedSizeAllocator::newNode() {
   if (buffers_with_free_space.empty()) {
     idx_t buffer_id = buffers.size();
     auto buffer = allocator.AllocateData(BUFFER_ALLOC_SIZE);
@@ -145,6 +174,13 @@ ConcurrentNode FixedSizeAllocator::ConcNew() {
 
 // not reclaim memory
 void FixedSizeAllocator::Free(const Node ptr) {
+  if (thread_cache && thread_cache->Covers(*this)) {
+    return thread_cache->Free(*this, ptr);
+  }
+  freeNode(ptr);
+}
+
+void FixedSizeAllocator::freeNode(const Node ptr) {
   auto buffer_id = ptr.GetBufferId();
   auto offset = ptr.GetOffset();
 
@@ -162,6 +198,54 @@ void FixedSizeAllocator::Free(const Node ptr) {
   buffers_with_free_space.insert(buffer_id);
 }
 
+AllocatorCache::AllocatorCache(std::vector<FixedSizeAllocator> &allocators, std::mutex &lock)
+    : allocators(allocators), lock(lock), slots(allocators.size()) {}
+
+AllocatorCache::~AllocatorCache() {
+  for (idx_t i = 0; i < slots.size(); i++) {
+    release(i, slots[i].size());
+  }
+}
+
+Node AllocatorCache::New(FixedSizeAllocator &allocator) {
+  auto index = &allocator - allocators.data();
+  auto &free_slots = slots[index];
+  if (free_slots.empty()) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (idx_t i = 0; i < BATCH_SIZE; i++) {
+      free_slots.push_back(allocator.newNode());
+    }
+  }
+  auto ptr = free_slots.back();
+  free_slots.pop_back();
+  return ptr;
+}
+
+void AllocatorCache::Free(FixedSizeAllocator &allocator, const Node ptr) {
+  auto index = &allocator - allocators.data();
+  slots[index].emplace_back(ptr.GetBufferId(), ptr.GetOffset());
+  if (slots[index].size() > 4 * BATCH_SIZE) {
+    release(index, 2 * BATCH_SIZE);
+  }
+}
+
+void AllocatorCache::release(idx_t index, idx_t count) {
+  auto &free_slots = slots[index];
+  std::lock_guard<std::mutex> guard(lock);
+  for (idx_t i = 0; i < count; i++) {
+    allocators[index].freeNode(free_slots.back());
+    free_slots.pop_back();
+  }
+}
+
+void FixedSizeAllocator::ReleaseEmptyBuffers() {
+  while (!buffers.empty() && buffers.back().allocation_count == 0) {
+    buffers_with_free_space.erase(buffers.size() - 1);
+    allocator.FreeData(buffers.back().ptr, BUFFER_ALLOC_SIZE);
+    buffers.pop_back();
+  }
+}
+
 void FixedSizeAllocator::ConcFree(const ConcurrentNode *ptr) {
   assert(ptr->Locked());
   auto buffer_id = ptr->GetBufferId();
@@ -186,7 +270,8 @@ void FixedSizeAllocator::SerializeBuffers(SequentialSerializer &writer) {
   writer.WriteData(const_data_ptr_cast(&buf_size), sizeof(buf_size));
   writer.WriteData(const_data_ptr_cast(&allocation_size), sizeof(allocation_size));
 
-  for (auto &buffer : buffers) {
+  for (idx_t buffer_id = 0; buffer_id < buffers.size(); buffer_id++) {
+    auto &buffer = buffers[buffer_id];
     // NOTE: mask and data are need to write files???
     // and allocation_size, allocation_count are needed to write to files
     //    ValidityMask mask(bitmask_ptr);
@@ -211,8 +296,7 @@ FixedSizeAllocator::FixedSizeAllocator(Deserializer &reader, Allocator &allocato
     total_allocations += allocation_count;
     auto ptr = allocator.AllocateData(BUFFER_ALLOC_SIZE);
     reader.ReadData(ptr, BUFFER_ALLOC_SIZE);
-    BufferEntry entry(ptr, allocation_count);
-    buffers.emplace_back(std::move(entry));
+    buffers.emplace_back(ptr, allocation_count);
   }
 }
 
@@ -225,7 +309,8 @@ void FixedSizeAllocator::SerializeBuffers(SequentialSerializer &writer, NType no
   // Node: different from ART
   writer.Write<uint8_t>(static_cast<uint8_t>(node_type));
 
-  for (auto &buffer : buffers) {
+  for (idx_t buffer_id = 0; buffer_id < buffers.size(); buffer_id++) {
+    auto &buffer = buffers[buffer_id];
     writer.Write<idx_t>(buffer.allocation_count);
     auto bitmask_ptr = reinterpret_cast<validity_t *>(buffer.ptr);
     ValidityMask mask(bitmask_ptr);
@@ -243,6 +328,12 @@ void FixedSizeAllocator::SerializeBuffers(SequentialSerializer &writer, NType no
           }
           break;
         }
+        case NType::LEAF_SEGMENT:
+        case NType::LEAF_BITMAP:
+          // NOTE: leaves of ConcurrentART are never segmented or bitmap encoded
+          throw std::invalid_argument(fmt::format("unexpected leaf chain type {}", (uint8_t)node_type));
+        default:
+          break;
       }
     }
   }
@@ -0,0 +1,147 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
+
+namespace part {
+
+idx_t LatencyHistogram::BucketIndex(uint64_t value) {
+  value = std::min(value, MAX_VALUE);
+  if (value < SUB_BUCKET_COUNT) {
+    return value;
+  }
+  idx_t magnitude = std::bit_width(value) - 1;
+  idx_t shift = magnitude - (SUB_BUCKET_BITS - 1);
+  return SUB_BUCKET_COUNT + (magnitude - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT +
+         ((value >> shift) - HALF_SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::BucketLowerBound(idx_t bucket) {
+  if (bucket < SUB_BUCKET_COUNT) {
+    return bucket;
+  }
+  auto offset = bucket - SUB_BUCKET_COUNT;
+  idx_t shift = offset / HALF_SUB_BUCKET_COUNT + 1;
+  return (offset % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT) << shift;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(idx_t bucket) {
+  if (bucket < SUB_BUCKET_COUNT) {
+    return bucket;
+  }
+  idx_t shift = (bucket - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + 1;
+  return BucketLowerBound(bucket) + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value, uint64_t count) {
+  if (count == 0) {
+    return;
+  }
+  value = std::min(value, MAX_VALUE);
+  counts[BucketIndex(value)] += count;
+  total_count += count;
+  sum += value * count;
+  min = std::min(min, value);
+  max = std::max(max, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (idx_t i = 0; i < BUCKET_COUNT; i++) {
+    counts[i] += other.counts[i];
+  }
+  total_count += other.total_count;
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+}
+
+void LatencyHistogram::Reset() { *this = LatencyHistogram(); }
+
+double LatencyHistogram::Mean() const { return total_count ? static_cast<double>(sum) / total_count : 0; }
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  if (total_count == 0) {
+    return 0;
+  }
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  auto rank = std::max<uint64_t>(1, std::ceil(percentile / 100 * total_count));
+  uint64_t seen = 0;
+  for (idx_t i = 0; i < BUCKET_COUNT; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // NOTE: the bounds of the bucket are no better than the exact extremes
+      return std::clamp(BucketUpperBound(i), Min(), max);
+    }
+  }
+  return max;
+}
+
+std::atomic<idx_t> LatencyMetrics::sample_rate = 0;
+
+//! The histograms of the live threads and the merged histograms of the threads that exited
+struct LatencyRegistry {
+  std::mutex lock;
+  std::vector<LatencyMetrics::ThreadHistograms *> threads;
+  std::array<LatencyHistogram, INDEX_OPERATION_COUNT> exited;
+};
+
+static LatencyRegistry &Registry() {
+  // NOTE: never destroyed, threads may exit after the static destructors ran
+  static auto *registry = new LatencyRegistry();
+  return *registry;
+}
+
+LatencyMetrics::ThreadHistograms::ThreadHistograms() {
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.threads.push_back(this);
+}
+
+LatencyMetrics::ThreadHistograms::~ThreadHistograms() {
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  for (idx_t i = 0; i < INDEX_OPERATION_COUNT; i++) {
+    registry.exited[i].Merge(histograms[i]);
+  }
+  registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+}
+
+void LatencyMetrics::SetSampleRate(idx_t rate) { sample_rate.store(rate, std::memory_order_relaxed); }
+
+void LatencyMetrics::record(ThreadHistograms &local, IndexOperation operation, uint64_t nanos) {
+  std::lock_guard<std::mutex> guard(local.lock);
+  local.histograms[static_cast<idx_t>(operation)].Record(nanos);
+}
+
+LatencyHistogram LatencyMetrics::Snapshot(IndexOperation operation) {
+  auto index = static_cast<idx_t>(operation);
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  LatencyHistogram histogram = registry.exited[index];
+  for (auto *thread : registry.threads) {
+    std::lock_guard<std::mutex> thread_guard(thread->lock);
+    histogram.Merge(thread->histograms[index]);
+  }
+  return histogram;
+}
+
+void LatencyMetrics::Reset() {
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  for (auto &histogram : registry.exited) {
+    histogram.Reset();
+  }
+  for (auto *thread : registry.threads) {
+    std::lock_guard<std::mutex> thread_guard(thread->lock);
+    for (auto &histogram : thread->histograms) {
+      histogram.Reset();
+    }
+  }
+}
+
+}  // namespace part
@@ -3,14 +3,220 @@
 //
 #include "leaf.h"
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "trace.h"
+
 namespace part {
 
+static_assert(sizeof(LeafSegment) == LeafSegment::SEGMENT_SIZE, "LeafSegment must fill exactly one allocation");
+
+//! Rough size of a doc id inside a segment, used to guess what a bitmap leaf would take as segments
+static constexpr idx_t SEGMENT_BYTES_PER_DOC_ID = 2;
+
+static inline idx_t VarintSize(idx_t value) {
+  idx_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+static inline idx_t WriteVarint(data_ptr_t ptr, idx_t value) {
+  idx_t size = 0;
+  while (value >= 0x80) {
+    ptr[size++] = static_cast<data_t>(value | 0x80);
+    value >>= 7;
+  }
+  ptr[size++] = static_cast<data_t>(value);
+  return size;
+}
+
+static inline idx_t ReadVarint(const_data_ptr_t ptr, idx_t &value) {
+  idx_t size = 0;
+  uint32_t shift = 0;
+  value = 0;
+  while (ptr[size] & 0x80) {
+    value |= idx_t(ptr[size] & 0x7F) << shift;
+    shift += 7;
+    size++;
+  }
+  value |= idx_t(ptr[size]) << shift;
+  return size + 1;
+}
+
+//! Bitmap containers only pay off once they replace a good number of segments
+static inline bool PreferBitmap(idx_t segment_count, idx_t container_count) {
+  return segment_count * LeafSegment::SEGMENT_SIZE > container_count * sizeof(LeafBitmap);
+}
+
+//! Sorted doc_ids are moved back to segments if those take less than half the memory of the containers
+static inline bool PreferSegments(idx_t doc_count, idx_t container_count) {
+  return 2 * doc_count * SEGMENT_BYTES_PER_DOC_ID < container_count * sizeof(LeafBitmap);
+}
+
+LeafSegment &LeafSegment::New(ART &art, Node &node) {
+  node = Node::GetAllocator(art, NType::LEAF_SEGMENT).New();
+  node.SetType((uint8_t)NType::LEAF_SEGMENT);
+
+  auto &segment = LeafSegment::Get(art, node);
+  segment.count = 0;
+  segment.size = 0;
+  segment.ptr.Reset();
+  return segment;
+}
+
+idx_t LeafSegment::Decode(idx_t *doc_ids) const {
+  if (count == 0) {
+    return 0;
+  }
+  doc_ids[0] = first;
+  idx_t offset = 0;
+  for (idx_t i = 1; i < count; i++) {
+    idx_t delta;
+    offset += ReadVarint(data + offset, delta);
+    doc_ids[i] = doc_ids[i - 1] + delta;
+  }
+  assert(offset == size);
+  return count;
+}
+
+idx_t LeafSegment::Encode(const idx_t *doc_ids, idx_t doc_count, idx_t byte_budget) {
+  assert(doc_count > 0 && byte_budget <= DATA_SIZE);
+  count = 1;
+  size = 0;
+  first = doc_ids[0];
+  last = doc_ids[0];
+  for (idx_t i = 1; i < doc_count; i++) {
+    auto delta = doc_ids[i] - doc_ids[i - 1];
+    if (size + VarintSize(delta) > byte_budget) {
+      break;
+    }
+    size += WriteVarint(data + size, delta);
+    last = doc_ids[i];
+    count++;
+  }
+  return count;
+}
+
+bool LeafSegment::Append(idx_t doc_id) {
+  assert(count > 0 && doc_id >= last);
+  auto delta = doc_id - last;
+  if (size + VarintSize(delta) > DATA_SIZE) {
+    return false;
+  }
+  size += WriteVarint(data + size, delta);
+  last = doc_id;
+  count++;
+  return true;
+}
+
+LeafBitmap &LeafBitmap::New(ART &art, Node &node, idx_t high) {
+  node = Node::GetAllocator(art, NType::LEAF_BITMAP).New();
+  node.SetType((uint8_t)NType::LEAF_BITMAP);
+
+  auto &container = LeafBitmap::Get(art, node);
+  container.high = high;
+  container.count = 0;
+  container.ptr.Reset();
+  memset(container.words, 0, sizeof(container.words));
+  return container;
+}
+
+bool LeafBitmap::Set(idx_t doc_id) {
+  assert(High(doc_id) == high);
+  auto bit = doc_id & (CONTAINER_SIZE - 1);
+  auto &word = words[bit / 64];
+  auto mask = validity_t(1) << (bit % 64);
+  if (word & mask) {
+    return false;
+  }
+  word |= mask;
+  count++;
+  return true;
+}
+
+bool LeafBitmap::Clear(idx_t doc_id) {
+  assert(High(doc_id) == high);
+  auto bit = doc_id & (CONTAINER_SIZE - 1);
+  auto &word = words[bit / 64];
+  auto mask = validity_t(1) << (bit % 64);
+  if (!(word & mask)) {
+    return false;
+  }
+  word &= ~mask;
+  count--;
+  return true;
+}
+
+void LeafBitmap::Decode(std::vector<idx_t> &doc_ids) const {
+  auto base = high << CONTAINER_BITS;
+  for (idx_t i = 0; i < WORD_COUNT; i++) {
+    auto word = words[i];
+    while (word) {
+      doc_ids.push_back(base + i * 64 + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+}
+
+void LeafBitmap::Union(const LeafBitmap &other) {
+  assert(high == other.high);
+  count = 0;
+  for (idx_t i = 0; i < WORD_COUNT; i++) {
+    words[i] |= other.words[i];
+    count += __builtin_popcountll(words[i]);
+  }
+}
+
 void Leaf::New(Node &node, const idx_t doc_id) {
   node.Reset();
   node.SetType((uint8_t)NType::LEAF_INLINED);
   node.SetDocID(doc_id);
 }
 
+void Leaf::New(ART &art, Node &node, std::vector<idx_t> &doc_ids) {
+  assert(!doc_ids.empty());
+  if (doc_ids.size() == 1) {
+    Leaf::New(node, doc_ids[0]);
+    return;
+  }
+
+  node = Node::GetAllocator(art, NType::LEAF).New();
+  node.SetType((uint8_t)NType::LEAF);
+
+  auto &leaf = Leaf::Get(art, node);
+  leaf.ptr.Reset();
+  if (doc_ids.size() <= Node::LEAF_SIZE) {
+    leaf.count = doc_ids.size();
+    std::copy(doc_ids.begin(), doc_ids.end(), leaf.row_ids);
+    return;
+  }
+
+  std::sort(doc_ids.begin(), doc_ids.end());
+
+  // size both layouts up front
+  bool has_duplicates = false;
+  idx_t segment_bytes = 0;
+  idx_t container_count = 1;
+  for (idx_t i = 1; i < doc_ids.size(); i++) {
+    segment_bytes += VarintSize(doc_ids[i] - doc_ids[i - 1]);
+    container_count += LeafBitmap::High(doc_ids[i]) != LeafBitmap::High(doc_ids[i - 1]);
+    has_duplicates |= doc_ids[i] == doc_ids[i - 1];
+  }
+
+  if (!has_duplicates && PreferBitmap(segment_bytes / LeafSegment::DATA_SIZE + 1, container_count)) {
+    leaf.count = BITMAP;
+    leaf.BuildBitmap(art, doc_ids.data(), doc_ids.size());
+  } else {
+    leaf.count = SEGMENTED;
+    leaf.BuildSegments(art, doc_ids.data(), doc_ids.size());
+  }
+}
+
 idx_t Leaf::TotalCount(ART &art, Node &node) {
   // NOTE: first leaf in the leaf chain is already deserialized
   assert(node.IsSet() && !node.IsSerialized());
@@ -19,6 +225,11 @@ idx_t Leaf::TotalCount(ART &art, Node &node) {
     return 1;
   }
 
+  auto &head = Leaf::Get(art, node);
+  if (head.IsSegmented() || head.IsBitmap()) {
+    return head.row_ids[0];
+  }
+
   idx_t count = 0;
   auto node_ref = std::ref(node);
   while (node_ref.get().IsSet()) {
@@ -28,6 +239,7 @@ idx_t Leaf::TotalCount(ART &art, Node &node) {
     if (leaf.ptr.IsSerialized()) {
       leaf.ptr.Deserialize(art);
     }
+    PART_TRACE(LEAF_HOPS, leaf.ptr.IsSet());
     node_ref = leaf.ptr;
   }
   return count;
@@ -36,33 +248,87 @@ idx_t Leaf::TotalCount(ART &art, Node &node) {
 bool Leaf::GetDocIds(ART &art, Node &node, std::vector<idx_t> &result_ids, idx_t max_count) {
   assert(node.IsSet());
 
-  if (result_ids.size() + Leaf::TotalCount(art, node) > max_count) {
+  // NOTE: only count when there is a limit, a plain leaf chain would be walked twice otherwise
+  if (max_count != std::numeric_limits<idx_t>::max() && result_ids.size() + Leaf::TotalCount(art, node) > max_count) {
     return false;
   }
-
-  // NOTE: Leaf::TotalCount fully deserializes the leaf
   assert(!node.IsSerialized());
 
   if (node.GetType() == NType::LEAF_INLINED) {
     // push back the inlined row ID of this leaf
     result_ids.push_back(node.GetDocId());
+    return true;
+  }
 
-  } else {
-    // push back all the row IDs of this leaf
-    std::reference_wrapper<Node> last_leaf_ref(node);
-    while (last_leaf_ref.get().IsSet()) {
-      auto &leaf = Leaf::Get(art, last_leaf_ref);
-      for (idx_t i = 0; i < leaf.count; i++) {
-        result_ids.push_back(leaf.row_ids[i]);
-      }
+  auto &head = Leaf::Get(art, node);
+  if (head.IsSegmented()) {
+    // decode every segment straight into the result
+    result_ids.reserve(result_ids.size() + head.row_ids[0]);
+    auto segment_node = head.ptr;
+    while (segment_node.IsSet()) {
+      auto &segment = LeafSegment::Get(art, segment_node);
+      auto offset = result_ids.size();
+      result_ids.resize(offset + segment.count);
+      segment.Decode(result_ids.data() + offset);
+      PART_TRACE(LEAF_HOPS, 1);
+      segment_node = segment.ptr;
+    }
+    return true;
+  }
 
-      assert(!leaf.ptr.IsSerialized());
-      last_leaf_ref = leaf.ptr;
+  if (head.IsBitmap()) {
+    result_ids.reserve(result_ids.size() + head.row_ids[0]);
+    auto container_node = head.ptr;
+    while (container_node.IsSet()) {
+      auto &container = LeafBitmap::Get(art, container_node);
+      container.Decode(result_ids);
+      PART_TRACE(LEAF_HOPS, 1);
+      container_node = container.ptr;
     }
+    return true;
+  }
+
+  // push back all the row IDs of this leaf
+  std::reference_wrapper<Node> last_leaf_ref(node);
+  while (last_leaf_ref.get().IsSet()) {
+    auto &leaf = Leaf::Get(art, last_leaf_ref);
+    for (idx_t i = 0; i < leaf.count; i++) {
+      result_ids.push_back(leaf.row_ids[i]);
+    }
+
+    if (leaf.ptr.IsSerialized()) {
+      leaf.ptr.Deserialize(art);
+    }
+    PART_TRACE(LEAF_HOPS, leaf.ptr.IsSet());
+    last_leaf_ref = leaf.ptr;
   }
   return true;
 }
 
+idx_t Leaf::FirstDocId(ART &art, Node &node) {
+  assert(node.IsSet() && !node.IsSerialized());
+
+  if (node.GetType() == NType::LEAF_INLINED) {
+    return node.GetDocId();
+  }
+
+  auto &head = Leaf::Get(art, node);
+  if (head.IsSegmented()) {
+    return LeafSegment::Get(art, head.ptr).first;
+  }
+  if (head.IsBitmap()) {
+    auto &container = LeafBitmap::Get(art, head.ptr);
+    for (idx_t i = 0; i < LeafBitmap::WORD_COUNT; i++) {
+      if (container.words[i]) {
+        return (container.high << LeafBitmap::CONTAINER_BITS) + i * 64 + __builtin_ctzll(container.words[i]);
+      }
+    }
+    throw std::invalid_argument("empty bitmap container in leaf");
+  }
+  assert(head.count > 0);
+  return head.row_ids[0];
+}
+
 void Leaf::Insert(ART &art, Node &node, const idx_t row_id) {
   assert(node.IsSet() && !node.IsSerialized());
 
@@ -72,15 +338,29 @@ void Leaf::Insert(ART &art, Node &node, const idx_t row_id) {
     return;
   }
 
-  // assert
-  std::reference_wrapper<Leaf> leaf = Leaf::Get(art, node);
-  while (leaf.get().ptr.IsSet()) {
-    if (leaf.get().ptr.IsSerialized()) {
-      leaf.get().ptr.Deserialize(art);
+  auto &leaf = Leaf::Get(art, node);
+  if (!leaf.IsSegmented() && !leaf.IsBitmap()) {
+    if (leaf.count < Node::LEAF_SIZE && !leaf.ptr.IsSet()) {
+      leaf.row_ids[leaf.count] = row_id;
+      leaf.count++;
+      return;
     }
-    leaf = Leaf::Get(art, leaf.get().ptr);
+    // NOTE: the posting list outgrew a single leaf
+    Leaf::MoveToSegments(art, node);
+  }
+
+  auto chain_length = leaf.row_ids[2];
+  if (leaf.IsBitmap() && !leaf.InsertBitmap(art, row_id)) {
+    // NOTE: containers cannot hold the doc id twice
+    Leaf::MoveToSegments(art, node);
+  }
+  if (leaf.IsSegmented()) {
+    leaf.InsertSegmented(art, row_id);
+  }
+  // NOTE: only a new segment or container can change which layout is smaller
+  if (leaf.row_ids[2] != chain_length) {
+    Leaf::Reorganize(art, node);
   }
-  leaf.get().Append(art, row_id);
 }
 
 void Leaf::MoveInlinedToLeaf(ART &art, Node &node) {
@@ -95,6 +375,495 @@ void Leaf::MoveInlinedToLeaf(ART &art, Node &node) {
   leaf.ptr.Reset();
 }
 
+void Leaf::MoveToSegments(ART &art, Node &node) {
+  std::vector<idx_t> doc_ids;
+  Leaf::GetDocIds(art, node, doc_ids, std::numeric_limits<idx_t>::max());
+  std::sort(doc_ids.begin(), doc_ids.end());
+
+  // keep the head leaf, it becomes the entry of the segment chain
+  auto &leaf = Leaf::Get(art, node);
+  leaf.FreeChain(art);
+  leaf.count = SEGMENTED;
+  leaf.BuildSegments(art, doc_ids.data(), doc_ids.size());
+}
+
+void Leaf::MoveToBitmap(ART &art, Node &node) {
+  std::vector<idx_t> doc_ids;
+  Leaf::GetDocIds(art, node, doc_ids, std::numeric_limits<idx_t>::max());
+  std::sort(doc_ids.begin(), doc_ids.end());
+
+  auto &leaf = Leaf::Get(art, node);
+  leaf.FreeChain(art);
+  leaf.count = BITMAP;
+  leaf.BuildBitmap(art, doc_ids.data(), doc_ids.size());
+}
+
+void Leaf::Reorganize(ART &art, Node &node) {
+  auto &leaf = Leaf::Get(art, node);
+  if (leaf.IsSegmented()) {
+    if (leaf.row_ids[3]) {
+      return;
+    }
+    Node tail;
+    tail.SetData(leaf.row_ids[1]);
+    auto low = LeafBitmap::High(LeafSegment::Get(art, leaf.ptr).first);
+    auto high = LeafBitmap::High(LeafSegment::Get(art, tail).last);
+    // NOTE: an upper bound, every doc id may live in its own container
+    auto container_count = std::min(high - low + 1, leaf.row_ids[0]);
+    if (PreferBitmap(leaf.row_ids[2], container_count)) {
+      Leaf::MoveToBitmap(art, node);
+    }
+    return;
+  }
+
+  if (leaf.IsBitmap() && PreferSegments(leaf.row_ids[0], leaf.row_ids[2])) {
+    Leaf::MoveToSegments(art, node);
+  }
+}
+
+void Leaf::FreeChain(ART &art) {
+  if (!IsSegmented() && !IsBitmap()) {
+    Node::Free(art, ptr);
+    return;
+  }
+
+  auto type = IsSegmented() ? NType::LEAF_SEGMENT : NType::LEAF_BITMAP;
+  auto chain_node = ptr;
+  while (chain_node.IsSet()) {
+    auto next_node = IsSegmented() ? LeafSegment::Get(art, chain_node).ptr : LeafBitmap::Get(art, chain_node).ptr;
+    Node::GetAllocator(art, type).Free(chain_node);
+    chain_node = next_node;
+  }
+  ptr.Reset();
+}
+
+void Leaf::BuildSegments(ART &art, const idx_t *doc_ids, idx_t doc_count) {
+  assert(IsSegmented() && !ptr.IsSet() && doc_count > 0);
+  row_ids[0] = doc_count;
+  row_ids[2] = 0;
+  row_ids[3] = std::adjacent_find(doc_ids, doc_ids + doc_count) != doc_ids + doc_count;
+
+  Node tail;
+  auto ref_node = std::ref(ptr);
+  while (doc_count > 0) {
+    auto &segment = LeafSegment::New(art, ref_node);
+    auto encoded = segment.Encode(doc_ids, doc_count);
+    doc_ids += encoded;
+    doc_count -= encoded;
+    row_ids[2]++;
+
+    tail = ref_node;
+    ref_node = segment.ptr;
+  }
+  row_ids[1] = tail.GetData();
+}
+
+void Leaf::InsertSegmented(ART &art, const idx_t doc_id) {
+  assert(IsSegmented());
+  row_ids[0]++;
+
+  Node tail;
+  tail.SetData(row_ids[1]);
+  auto &tail_segment = LeafSegment::Get(art, tail);
+
+  // NOTE: doc ids mostly arrive in ascending order, which only touches the last segment
+  if (doc_id >= tail_segment.last) {
+    row_ids[3] |= doc_id == tail_segment.last;
+    if (!tail_segment.Append(doc_id)) {
+      auto &segment = LeafSegment::New(art, tail_segment.ptr);
+      segment.Encode(&doc_id, 1);
+      row_ids[1] = tail_segment.ptr.GetData();
+      row_ids[2]++;
+    }
+    return;
+  }
+
+  // the first segment whose last doc id is not smaller than doc_id
+  auto segment = std::ref(LeafSegment::Get(art, ptr));
+  while (segment.get().last < doc_id) {
+    segment = LeafSegment::Get(art, segment.get().ptr);
+  }
+
+  idx_t doc_ids[LeafSegment::MAX_COUNT + 1];
+  auto doc_count = segment.get().Decode(doc_ids);
+  auto pos = std::upper_bound(doc_ids, doc_ids + doc_count, doc_id) - doc_ids;
+  // NOTE: earlier segments end below doc_id, so an equal doc id can only be in this one
+  row_ids[3] |= pos > 0 && doc_ids[pos - 1] == doc_id;
+  memmove(doc_ids + pos + 1, doc_ids + pos, (doc_count - pos) * sizeof(idx_t));
+  doc_ids[pos] = doc_id;
+  doc_count++;
+
+  auto encoded = segment.get().Encode(doc_ids, doc_count);
+  if (encoded == doc_count) {
+    return;
+  }
+
+  // split the full segment, leaving room in both halves for the following inserts
+  encoded = segment.get().Encode(doc_ids, doc_count, LeafSegment::DATA_SIZE / 2);
+  while (encoded < doc_count) {
+    auto next_node = segment.get().ptr;
+    auto &new_segment = LeafSegment::New(art, segment.get().ptr);
+    new_segment.ptr = next_node;
+    encoded += new_segment.Encode(doc_ids + encoded, doc_count - encoded);
+    row_ids[2]++;
+
+    if (!next_node.IsSet()) {
+      row_ids[1] = segment.get().ptr.GetData();
+    }
+    segment = new_segment;
+  }
+}
+
+bool Leaf::RemoveSegmented(ART &art, const idx_t doc_id) {
+  assert(IsSegmented());
+
+  // the node pointing to the first segment whose last doc id is not smaller than doc_id
+  Node prev_node;
+  auto segment_node = std::ref(ptr);
+  while (segment_node.get().IsSet() && LeafSegment::Get(art, segment_node).last < doc_id) {
+    prev_node = segment_node;
+    segment_node = LeafSegment::Get(art, segment_node).ptr;
+  }
+  if (!segment_node.get().IsSet()) {
+    return false;
+  }
+
+  auto &segment = LeafSegment::Get(art, segment_node);
+  idx_t doc_ids[LeafSegment::MAX_COUNT];
+  auto doc_count = segment.Decode(doc_ids);
+  auto it = std::lower_bound(doc_ids, doc_ids + doc_count, doc_id);
+  if (it == doc_ids + doc_count || *it != doc_id) {
+    return false;
+  }
+  row_ids[0]--;
+
+  if (doc_count > 1) {
+    memmove(it, it + 1, (doc_ids + doc_count - it - 1) * sizeof(idx_t));
+    // NOTE: removing never grows the encoding
+    segment.Encode(doc_ids, doc_count - 1);
+
+    // merge with a neighbour once both fit into one segment, so removals do not leave a chain of empty segments
+    if (!prev_node.IsSet() || !CoalesceSegments(art, prev_node)) {
+      CoalesceSegments(art, segment_node);
+    }
+    return true;
+  }
+
+  // unlink the emptied segment
+  auto next_node = segment.ptr;
+  Node::GetAllocator(art, NType::LEAF_SEGMENT).Free(segment_node);
+  segment_node.get() = next_node;
+  row_ids[2]--;
+
+  if (!next_node.IsSet() && prev_node.IsSet()) {
+    row_ids[1] = prev_node.GetData();
+  }
+  return true;
+}
+
+idx_t Leaf::RemoveSegmented(ART &art, const idx_t *doc_ids, idx_t count) {
+  assert(IsSegmented());
+
+  idx_t removed = 0;
+  idx_t buffer[LeafSegment::MAX_COUNT];
+  Node prev_node;
+  auto segment_node = std::ref(ptr);
+  idx_t i = 0;
+  while (i < count && segment_node.get().IsSet()) {
+    auto &segment = LeafSegment::Get(art, segment_node);
+    if (segment.last < doc_ids[i]) {
+      prev_node = segment_node;
+      segment_node = segment.ptr;
+      continue;
+    }
+
+    // remove the doc ids up to the last one of this segment, a doc id held twice needs two of them
+    auto end = i;
+    while (end < count && doc_ids[end] <= segment.last) {
+      end++;
+    }
+    auto doc_count = segment.Decode(buffer);
+    idx_t kept = 0;
+    for (idx_t j = 0; j < doc_count; j++) {
+      while (i < end && doc_ids[i] < buffer[j]) {
+        i++;
+      }
+      if (i < end && doc_ids[i] == buffer[j]) {
+        i++;
+        continue;
+      }
+      buffer[kept++] = buffer[j];
+    }
+    i = end;
+    if (kept == doc_count) {
+      prev_node = segment_node;
+      segment_node = segment.ptr;
+      continue;
+    }
+    removed += doc_count - kept;
+
+    if (kept == 0) {
+      // unlink the emptied segment
+      auto next_node = segment.ptr;
+      Node::GetAllocator(art, NType::LEAF_SEGMENT).Free(segment_node);
+      segment_node.get() = next_node;
+      row_ids[2]--;
+      if (!next_node.IsSet() && prev_node.IsSet()) {
+        row_ids[1] = prev_node.GetData();
+      }
+      continue;
+    }
+
+    // NOTE: removing never grows the encoding. After coalescing the segment is visited again, it may hold doc ids
+    // of the next one now
+    segment.Encode(buffer, kept);
+    if (prev_node.IsSet() && CoalesceSegments(art, prev_node)) {
+      continue;
+    }
+    if (CoalesceSegments(art, segment_node)) {
+      continue;
+    }
+    prev_node = segment_node;
+    segment_node = segment.ptr;
+  }
+  row_ids[0] -= removed;
+  return removed;
+}
+
+bool Leaf::CoalesceSegments(ART &art, const Node node) {
+  auto &segment = LeafSegment::Get(art, node);
+  if (!segment.ptr.IsSet()) {
+    return false;
+  }
+
+  auto &next_segment = LeafSegment::Get(art, segment.ptr);
+  if (segment.size + VarintSize(next_segment.first - segment.last) + next_segment.size > LeafSegment::DATA_SIZE) {
+    return false;
+  }
+
+  idx_t doc_ids[LeafSegment::MAX_COUNT];
+  auto doc_count = next_segment.Decode(doc_ids);
+  for (idx_t i = 0; i < doc_count; i++) {
+    auto appended = segment.Append(doc_ids[i]);
+    assert(appended);
+    (void)appended;
+  }
+
+  auto next_node = segment.ptr;
+  segment.ptr = next_segment.ptr;
+  Node::GetAllocator(art, NType::LEAF_SEGMENT).Free(next_node);
+  row_ids[2]--;
+
+  if (!segment.ptr.IsSet()) {
+    row_ids[1] = node.GetData();
+  }
+  return true;
+}
+
+void Leaf::BuildBitmap(ART &art, const idx_t *doc_ids, idx_t doc_count) {
+  assert(IsBitmap() && !ptr.IsSet() && doc_count > 0);
+  row_ids[0] = 0;
+  row_ids[2] = 0;
+
+  Node tail;
+  auto ref_node = std::ref(ptr);
+  for (idx_t i = 0; i < doc_count; i++) {
+    auto high = LeafBitmap::High(doc_ids[i]);
+    if (!tail.IsSet() || LeafBitmap::Get(art, tail).high != high) {
+      LeafBitmap::New(art, ref_node, high);
+      tail = ref_node;
+      ref_node = LeafBitmap::Get(art, tail).ptr;
+      row_ids[2]++;
+    }
+    row_ids[0] += LeafBitmap::Get(art, tail).Set(doc_ids[i]);
+  }
+  row_ids[1] = tail.GetData();
+}
+
+bool Leaf::InsertBitmap(ART &art, const idx_t doc_id) {
+  assert(IsBitmap());
+  auto high = LeafBitmap::High(doc_id);
+
+  Node tail;
+  tail.SetData(row_ids[1]);
+  auto &tail_container = LeafBitmap::Get(art, tail);
+
+  if (high > tail_container.high) {
+    auto &container = LeafBitmap::New(art, tail_container.ptr, high);
+    row_ids[1] = tail_container.ptr.GetData();
+    row_ids[2]++;
+    row_ids[0] += container.Set(doc_id);
+    return true;
+  }
+
+  // the node pointing to the first container whose high bits are not smaller than those of doc_id
+  auto container_node = std::ref(ptr);
+  while (LeafBitmap::Get(art, container_node).high < high) {
+    container_node = LeafBitmap::Get(art, container_node).ptr;
+  }
+
+  if (LeafBitmap::Get(art, container_node).high != high) {
+    auto next_node = container_node.get();
+    LeafBitmap::New(art, container_node, high).ptr = next_node;
+    row_ids[2]++;
+  }
+  if (!LeafBitmap::Get(art, container_node).Set(doc_id)) {
+    return false;
+  }
+  row_ids[0]++;
+  return true;
+}
+
+bool Leaf::RemoveBitmap(ART &art, const idx_t doc_id) {
+  assert(IsBitmap());
+  auto high = LeafBitmap::High(doc_id);
+
+  auto container_node = std::ref(ptr);
+  while (container_node.get().IsSet() && LeafBitmap::Get(art, container_node).high < high) {
+    container_node = LeafBitmap::Get(art, container_node).ptr;
+  }
+  if (!container_node.get().IsSet()) {
+    return false;
+  }
+
+  auto &container = LeafBitmap::Get(art, container_node);
+  if (container.high != high || !container.Clear(doc_id)) {
+    return false;
+  }
+  row_ids[0]--;
+
+  if (container.count > 0) {
+    return true;
+  }
+
+  // unlink the emptied container
+  auto next_node = container.ptr;
+  Node::GetAllocator(art, NType::LEAF_BITMAP).Free(container_node);
+  container_node.get() = next_node;
+  row_ids[2]--;
+
+  if (!next_node.IsSet() && ptr.IsSet()) {
+    Node tail = ptr;
+    while (LeafBitmap::Get(art, tail).ptr.IsSet()) {
+      tail = LeafBitmap::Get(art, tail).ptr;
+    }
+    row_ids[1] = tail.GetData();
+  }
+  return true;
+}
+
+bool Leaf::IntersectsBitmap(ART &art, const Leaf &other) const {
+  assert(IsBitmap() && other.IsBitmap());
+
+  auto l_node = ptr;
+  auto r_node = other.ptr;
+  while (l_node.IsSet() && r_node.IsSet()) {
+    auto &l_container = LeafBitmap::Get(art, l_node);
+    auto &r_container = LeafBitmap::Get(art, r_node);
+    if (l_container.high < r_container.high) {
+      l_node = l_container.ptr;
+      continue;
+    }
+    if (r_container.high < l_container.high) {
+      r_node = r_container.ptr;
+      continue;
+    }
+    for (idx_t i = 0; i < LeafBitmap::WORD_COUNT; i++) {
+      if (l_container.words[i] & r_container.words[i]) {
+        return true;
+      }
+    }
+    l_node = l_container.ptr;
+    r_node = r_container.ptr;
+  }
+  return false;
+}
+
+idx_t Leaf::RemoveBitmap(ART &art, const idx_t *doc_ids, idx_t count) {
+  assert(IsBitmap());
+
+  idx_t removed = 0;
+  bool unlinked = false;
+  auto container_node = std::ref(ptr);
+  idx_t i = 0;
+  while (i < count && container_node.get().IsSet()) {
+    auto &container = LeafBitmap::Get(art, container_node);
+    auto high = LeafBitmap::High(doc_ids[i]);
+    if (container.high < high) {
+      container_node = container.ptr;
+      continue;
+    }
+    if (container.high > high) {
+      i++;
+      continue;
+    }
+
+    while (i < count && LeafBitmap::High(doc_ids[i]) == high) {
+      removed += container.Clear(doc_ids[i]);
+      i++;
+    }
+    if (container.count > 0) {
+      container_node = container.ptr;
+      continue;
+    }
+
+    // unlink the emptied container
+    auto next_node = container.ptr;
+    Node::GetAllocator(art, NType::LEAF_BITMAP).Free(container_node);
+    container_node.get() = next_node;
+    row_ids[2]--;
+    unlinked = true;
+  }
+  row_ids[0] -= removed;
+
+  if (unlinked && ptr.IsSet()) {
+    Node tail = ptr;
+    while (LeafBitmap::Get(art, tail).ptr.IsSet()) {
+      tail = LeafBitmap::Get(art, tail).ptr;
+    }
+    row_ids[1] = tail.GetData();
+  }
+  return removed;
+}
+
+void Leaf::MergeBitmap(ART &art, Leaf &other) {
+  assert(IsBitmap() && other.IsBitmap());
+
+  // both chains are ordered by their high bits, so walk them side by side
+  auto l_node = std::ref(ptr);
+  auto r_node = other.ptr;
+  while (r_node.IsSet()) {
+    auto &r_container = LeafBitmap::Get(art, r_node);
+    auto next_node = r_container.ptr;
+
+    while (l_node.get().IsSet() && LeafBitmap::Get(art, l_node).high < r_container.high) {
+      l_node = LeafBitmap::Get(art, l_node).ptr;
+    }
+
+    if (l_node.get().IsSet() && LeafBitmap::Get(art, l_node).high == r_container.high) {
+      auto &l_container = LeafBitmap::Get(art, l_node);
+      row_ids[0] -= l_container.count;
+      l_container.Union(r_container);
+      row_ids[0] += l_container.count;
+      Node::GetAllocator(art, NType::LEAF_BITMAP).Free(r_node);
+    } else {
+      // NOTE: the containers come from the same allocator, so they are simply relinked
+      r_container.ptr = l_node.get();
+      l_node.get() = r_node;
+      row_ids[0] += r_container.count;
+      row_ids[2]++;
+    }
+    r_node = next_node;
+  }
+  other.ptr.Reset();
+
+  Node tail = ptr;
+  while (LeafBitmap::Get(art, tail).ptr.IsSet()) {
+    tail = LeafBitmap::Get(art, tail).ptr;
+  }
+  row_ids[1] = tail.GetData();
+}
+
 // TODO: bug?
 Leaf &Leaf::Append(ART &art, const idx_t row_id) {
   auto leaf = std::ref(*this);
@@ -117,7 +886,11 @@ void Leaf::Free(ART &art, Node &node) {
   Node next_node;
 
   while (current_node.IsSet() && !current_node.IsSerialized()) {
-    next_node = Leaf::Get(art, current_node).ptr;
+    auto &leaf = Leaf::Get(art, current_node);
+    if (leaf.IsSegmented() || leaf.IsBitmap()) {
+      leaf.FreeChain(art);
+    }
+    next_node = leaf.ptr;
     Node::GetAllocator(art, NType::LEAF).Free(current_node);
     current_node = next_node;
   }
@@ -140,6 +913,35 @@ BlockPointer Leaf::Serialize(ART &art, Node &node, Serializer &writer) {
   idx_t total_count = Leaf::TotalCount(art, node);
   writer.Write<idx_t>(total_count);
 
+  // NOTE: segments and containers are written as plain row IDs, so the file format does not depend on the
+  // in-memory layout
+  auto &head = Leaf::Get(art, node);
+  if (head.IsSegmented()) {
+    idx_t doc_ids[LeafSegment::MAX_COUNT];
+    auto segment_node = head.ptr;
+    while (segment_node.IsSet()) {
+      auto &segment = LeafSegment::Get(art, segment_node);
+      auto doc_count = segment.Decode(doc_ids);
+      writer.WriteData(const_data_ptr_cast(doc_ids), doc_count * sizeof(idx_t));
+      segment_node = segment.ptr;
+    }
+    return block_pointer;
+  }
+
+  if (head.IsBitmap()) {
+    std::vector<idx_t> doc_ids;
+    doc_ids.reserve(LeafBitmap::CONTAINER_SIZE);
+    auto container_node = head.ptr;
+    while (container_node.IsSet()) {
+      auto &container = LeafBitmap::Get(art, container_node);
+      doc_ids.clear();
+      container.Decode(doc_ids);
+      writer.WriteData(const_data_ptr_cast(doc_ids.data()), doc_ids.size() * sizeof(idx_t));
+      container_node = container.ptr;
+    }
+    return block_pointer;
+  }
+
   // iterate all leaves and write their row IDs
   auto ref_node = std::ref(node);
   while (ref_node.get().IsSet()) {
@@ -157,69 +959,125 @@ BlockPointer Leaf::Serialize(ART &art, Node &node, Serializer &writer) {
 
 void Leaf::Deserialize(ART &art, Node &node, Deserializer &reader) {
   auto total_count = reader.Read<idx_t>();
-  auto ref_node = std::ref(node);
+  std::vector<idx_t> doc_ids(total_count);
+  reader.ReadData(data_ptr_cast(doc_ids.data()), total_count * sizeof(idx_t));
+  Leaf::New(art, node, doc_ids);
+}
 
-  while (total_count > 0) {
-    ref_node.get() = Node::GetAllocator(art, NType::LEAF).New();
-    ref_node.get().SetType((uint8_t)NType::LEAF);
+bool Leaf::Remove(ART &art, std::reference_wrapper<Node> &node, const idx_t row_id) {
+  assert(node.get().IsSet() && !node.get().IsSerialized());
 
-    auto &leaf = Leaf::Get(art, ref_node);
-    leaf.count = std::min((idx_t)Node::LEAF_SIZE, total_count);
+  if (node.get().GetType() == NType::LEAF_INLINED) {
+    return node.get().GetDocId() == row_id;
+  }
 
+  auto &leaf = Leaf::Get(art, node);
+  if (leaf.IsSegmented() || leaf.IsBitmap()) {
+    auto removed = leaf.IsSegmented() ? leaf.RemoveSegmented(art, row_id) : leaf.RemoveBitmap(art, row_id);
+    if (!removed) {
+      return false;
+    }
+    if (leaf.row_ids[0] > Node::LEAF_SIZE / 2) {
+      Leaf::Reorganize(art, node);
+      return false;
+    }
+    // NOTE: shrink only well below LEAF_SIZE, so a list around the boundary does not convert back and forth
+    std::vector<idx_t> doc_ids;
+    Leaf::GetDocIds(art, node, doc_ids, std::numeric_limits<idx_t>::max());
+    Node::Free(art, node);
+    Leaf::New(art, node, doc_ids);
+    return false;
+  }
+
+  if (!leaf.ptr.IsSet()) {
     for (idx_t i = 0; i < leaf.count; i++) {
-      leaf.row_ids[i] = reader.Read<idx_t>();
+      if (leaf.row_ids[i] != row_id) {
+        continue;
+      }
+      memmove(leaf.row_ids + i, leaf.row_ids + i + 1, (leaf.count - i - 1) * sizeof(idx_t));
+      leaf.count--;
+      if (leaf.count == 0) {
+        return true;
+      }
+      if (leaf.count == 1) {
+        auto doc_id = leaf.row_ids[0];
+        Node::Free(art, node);
+        Leaf::New(node, doc_id);
+      }
+      return false;
     }
+    return false;
+  }
 
-    total_count -= leaf.count;
-    ref_node = leaf.ptr;
-    leaf.ptr.Reset();
+  // a chain of leaves, rebuild it without the row ID
+  std::vector<idx_t> doc_ids;
+  Leaf::GetDocIds(art, node, doc_ids, std::numeric_limits<idx_t>::max());
+  auto it = std::find(doc_ids.begin(), doc_ids.end(), row_id);
+  if (it == doc_ids.end()) {
+    return false;
   }
+  doc_ids.erase(it);
+  Node::Free(art, node);
+  Leaf::New(art, node, doc_ids);
+  return false;
 }
 
-// TODO: a lot of improvements todo
-bool Leaf::Remove(ART &art, std::reference_wrapper<Node> &node, const idx_t row_id) {
+bool Leaf::Remove(ART &art, std::reference_wrapper<Node> &node, const idx_t *doc_ids, idx_t count) {
   assert(node.get().IsSet() && !node.get().IsSerialized());
 
-  if (node.get().GetType() == NType::LEAF_INLINED) {
-    return node.get().GetDocId() == row_id;
+  // NOTE: an inlined or a single plain leaf holds at most LEAF_SIZE doc ids
+  auto plain = node.get().GetType() == NType::LEAF_INLINED;
+  if (!plain) {
+    auto &leaf = Leaf::Get(art, node);
+    plain = !leaf.IsSegmented() && !leaf.IsBitmap() && !leaf.ptr.IsSet();
   }
-
-  auto leaf = std::ref(Leaf::Get(art, node));
-  auto prev_leaf = std::ref(leaf);
-
-  while (leaf.get().ptr.IsSet()) {
-    prev_leaf = leaf;
-    if (leaf.get().ptr.IsSerialized()) {
-      leaf.get().ptr.Deserialize(art);
+  if (plain || count == 1) {
+    for (idx_t i = 0; i < count; i++) {
+      if (Leaf::Remove(art, node, doc_ids[i])) {
+        return true;
+      }
     }
-    leaf = Leaf::Get(art, leaf.get().ptr);
+    return false;
   }
 
-  auto last_idx = leaf.get().count;
-  auto last_row_id = leaf.get().row_ids[last_idx - 1];
+  std::vector<idx_t> sorted_ids(doc_ids, doc_ids + count);
+  std::sort(sorted_ids.begin(), sorted_ids.end());
 
-  if (leaf.get().count == 1) {
-    Node::Free(art, prev_leaf.get().ptr);
-    if (last_row_id == row_id) {
+  std::vector<idx_t> leaf_ids;
+  auto &leaf = Leaf::Get(art, node);
+  if (leaf.IsSegmented() || leaf.IsBitmap()) {
+    auto removed = leaf.IsSegmented() ? leaf.RemoveSegmented(art, sorted_ids.data(), count)
+                                      : leaf.RemoveBitmap(art, sorted_ids.data(), count);
+    if (removed == 0) {
+      return false;
+    }
+    if (leaf.row_ids[0] == 0) {
+      return true;
+    }
+    if (leaf.row_ids[0] > Node::LEAF_SIZE / 2) {
+      Leaf::Reorganize(art, node);
       return false;
     }
+    Leaf::GetDocIds(art, node, leaf_ids, std::numeric_limits<idx_t>::max());
   } else {
-    leaf.get().count--;
-  }
-  while (node.get().IsSet()) {
-    assert(!node.get().IsSerialized());
-    for (idx_t i = 0; i < leaf.get().count; i++) {
-      if (leaf.get().row_ids[i] == row_id) {
-        leaf.get().row_ids[i] = last_row_id;
-        return false;
-      }
+    // a chain of leaves, rebuild it without the doc ids
+    std::vector<idx_t> chain_ids;
+    Leaf::GetDocIds(art, node, chain_ids, std::numeric_limits<idx_t>::max());
+    std::sort(chain_ids.begin(), chain_ids.end());
+    std::set_difference(chain_ids.begin(), chain_ids.end(), sorted_ids.begin(), sorted_ids.end(),
+                        std::back_inserter(leaf_ids));
+    if (leaf_ids.size() == chain_ids.size()) {
+      return false;
+    }
+    if (leaf_ids.empty()) {
+      return true;
     }
-    node = leaf.get().ptr;
   }
+  Node::Free(art, node);
+  Leaf::New(art, node, leaf_ids);
   return false;
 }
 
-// NOTE: 这个效率实在是太低了啊
 void Leaf::Merge(ART &art, Node &l_node, Node &r_node) {
   assert(l_node.IsSet() && r_node.IsSet());
 
@@ -232,41 +1090,178 @@ void Leaf::Merge(ART &art, Node &l_node, Node &r_node) {
   if (l_node.GetType() == NType::LEAF_INLINED) {
     auto doc_id = l_node.GetDocId();
     l_node = r_node;
-    Insert(art, l_node, doc_id);
     r_node.Reset();
+    Insert(art, l_node, doc_id);
+    return;
+  }
+
+  auto l_count = Leaf::TotalCount(art, l_node);
+  auto r_count = Leaf::TotalCount(art, r_node);
+
+  // insert the doc ids of the smaller leaf into the bigger one
+  if (l_count < r_count && r_count > Node::LEAF_SIZE) {
+    std::swap(l_node, r_node);
   }
 
-  assert(l_node.GetType() != NType::LEAF_INLINED);
-  assert(r_node.GetType() != NType::LEAF_INLINED);
+  auto &l_leaf = Leaf::Get(art, l_node);
+  auto &r_leaf = Leaf::Get(art, r_node);
+  if (!r_leaf.IsSegmented() && !r_leaf.IsBitmap()) {
+    std::vector<idx_t> doc_ids;
+    Leaf::GetDocIds(art, r_node, doc_ids, std::numeric_limits<idx_t>::max());
+    Node::Free(art, r_node);
+    for (auto doc_id : doc_ids) {
+      Insert(art, l_node, doc_id);
+    }
+    return;
+  }
 
-  auto l_node_ref = std::ref(l_node);
-  auto &l_leaf = Leaf::Get(art, l_node_ref);
+  if (l_leaf.IsBitmap() && r_leaf.IsBitmap() && !l_leaf.IntersectsBitmap(art, r_leaf)) {
+    l_leaf.MergeBitmap(art, r_leaf);
+    Node::Free(art, r_node);
+    return;
+  }
 
-  while (l_leaf.count == Node::LEAF_SIZE) {
-    l_node_ref = l_leaf.ptr;
+  // merge the sorted lists and rebuild the leaf
+  std::vector<idx_t> l_doc_ids;
+  std::vector<idx_t> r_doc_ids;
+  Leaf::GetDocIds(art, l_node, l_doc_ids, std::numeric_limits<idx_t>::max());
+  Leaf::GetDocIds(art, r_node, r_doc_ids, std::numeric_limits<idx_t>::max());
+  if (!l_leaf.IsSegmented() && !l_leaf.IsBitmap()) {
+    std::sort(l_doc_ids.begin(), l_doc_ids.end());
+  }
+  Node::Free(art, l_node);
+  Node::Free(art, r_node);
 
-    if (!l_leaf.ptr.IsSet()) {
-      break;
+  std::vector<idx_t> doc_ids(l_doc_ids.size() + r_doc_ids.size());
+  std::merge(l_doc_ids.begin(), l_doc_ids.end(), r_doc_ids.begin(), r_doc_ids.end(), doc_ids.begin());
+  Leaf::New(art, l_node, doc_ids);
+}
+
+LeafCursor::LeafCursor(ART &art, Node &node)
+    : art(art), count(0), valid(false), value(0), pos(0), container(nullptr), bit(0) {
+  assert(node.IsSet() && !node.IsSerialized());
+  count = Leaf::TotalCount(art, node);
+
+  if (node.GetType() == NType::LEAF) {
+    auto &leaf = Leaf::Get(art, node);
+    if (leaf.IsSegmented()) {
+      buffer.resize(LeafSegment::MAX_COUNT);
+      next_segment = leaf.ptr;
+      loadSegment();
+      return;
+    }
+    if (leaf.IsBitmap()) {
+      container = &LeafBitmap::Get(art, leaf.ptr);
+      seekBit();
+      return;
+    }
+  }
+
+  // NOTE: plain leaves keep their row IDs in insertion order, but they hold only a few of them
+  Leaf::GetDocIds(art, node, buffer, std::numeric_limits<idx_t>::max());
+  std::sort(buffer.begin(), buffer.end());
+  update();
+}
+
+void LeafCursor::loadSegment() {
+  pos = 0;
+  if (!next_segment.IsSet()) {
+    buffer.clear();
+    valid = false;
+    return;
+  }
+  auto &segment = LeafSegment::Get(art, next_segment);
+  buffer.resize(LeafSegment::MAX_COUNT);
+  buffer.resize(segment.Decode(buffer.data()));
+  next_segment = segment.ptr;
+  update();
+}
+
+void LeafCursor::seekBit() {
+  while (container) {
+    if (bit < LeafBitmap::CONTAINER_SIZE) {
+      auto word_idx = bit / 64;
+      auto word = container->words[word_idx] & (~validity_t(0) << (bit % 64));
+      while (true) {
+        if (word) {
+          bit = word_idx * 64 + __builtin_ctzll(word);
+          value = (container->high << LeafBitmap::CONTAINER_BITS) + bit;
+          valid = true;
+          return;
+        }
+        if (++word_idx == LeafBitmap::WORD_COUNT) {
+          break;
+        }
+        word = container->words[word_idx];
+      }
     }
+    container = container->ptr.IsSet() ? &LeafBitmap::Get(art, container->ptr) : nullptr;
+    bit = 0;
+  }
+  valid = false;
+}
 
-    l_leaf = Leaf::Get(art, l_node_ref);
+void LeafCursor::Next() {
+  assert(valid);
+  if (container) {
+    bit++;
+    seekBit();
+    return;
   }
+  pos++;
+  if (pos == buffer.size() && next_segment.IsSet()) {
+    loadSegment();
+    return;
+  }
+  update();
+}
+
+void LeafCursor::NextContainer() {
+  assert(container);
+  container = container->ptr.IsSet() ? &LeafBitmap::Get(art, container->ptr) : nullptr;
+  bit = 0;
+  seekBit();
+}
 
-  auto last_leaf_node = l_node_ref.get();
-  l_node_ref.get() = r_node;
-  r_node.Reset();
+void LeafCursor::SkipTo(idx_t target) {
+  if (!valid || value >= target) {
+    return;
+  }
 
-  if (last_leaf_node.IsSet()) {
-    l_leaf = Leaf::Get(art, l_node_ref);
-    while (l_leaf.ptr.IsSet()) {
-      l_leaf = Leaf::Get(art, l_leaf.ptr);
+  if (container) {
+    auto high = LeafBitmap::High(target);
+    while (container && container->high < high) {
+      container = container->ptr.IsSet() ? &LeafBitmap::Get(art, container->ptr) : nullptr;
+      bit = 0;
     }
-    auto &last_leaf = Leaf::Get(art, last_leaf_node);
-    for (idx_t i = 0; i < last_leaf.count; i++) {
-      l_leaf = l_leaf.Append(art, last_leaf.row_ids[i]);
+    if (container && container->high == high) {
+      bit = target & (LeafBitmap::CONTAINER_SIZE - 1);
+    }
+    seekBit();
+    return;
+  }
+
+  if (buffer.back() < target) {
+    // skip whole segments by their last doc id without decoding them
+    while (next_segment.IsSet() && LeafSegment::Get(art, next_segment).last < target) {
+      next_segment = LeafSegment::Get(art, next_segment).ptr;
+    }
+    loadSegment();
+    if (!valid) {
+      return;
     }
-    Node::GetAllocator(art, NType::LEAF).Free(last_leaf_node);
   }
+
+  // galloping search, then binary search inside the last step
+  idx_t low = pos;
+  idx_t step = 1;
+  while (low + step < buffer.size() && buffer[low + step] < target) {
+    low += step;
+    step <<= 1;
+  }
+  auto high = std::min(low + step + 1, buffer.size());
+  pos = std::lower_bound(buffer.begin() + low, buffer.begin() + high, target) - buffer.begin();
+  update();
 }
 
 // node is not updated, so need unlock in this method internally
@@ -300,12 +1295,13 @@ bool CLeaf::GetDocIds(ConcurrentART &art, ConcurrentNode &node, std::vector<idx_
       }
     }
 
-    // NOTE: release lock asap
-    last_leaf_ref.get().RUnlock();
+    // NOTE: the next one is locked first, a leaf replaced meanwhile frees the chain behind
     assert(leaf.ptr);
-    leaf.ptr->RLock();
-    assert(!leaf.ptr->IsSerialized());
-    last_leaf_ref = *leaf.ptr;
+    auto next_leaf = leaf.ptr;
+    next_leaf->RLock();
+    last_leaf_ref.get().RUnlock();
+    assert(!next_leaf->IsSerialized());
+    last_leaf_ref = *next_leaf;
   }
   last_leaf_ref.get().RUnlock();
   return true;
@@ -391,6 +1387,30 @@ void CLeaf::Insert(ConcurrentART &art, ConcurrentNode *&node, const idx_t row_id
   ref.get().Append(art, node, row_id);
 }
 
+void CLeaf::Replace(ConcurrentART &art, ConcurrentNode *node, idx_t doc_id) {
+  assert(node->Locked() && !node->IsDeleted());
+  assert(node->IsSet() && !node->IsSerialized());
+  if (node->GetType() == NType::LEAF) {
+    auto &allocator = ConcurrentNode::GetAllocator(art, NType::LEAF);
+    // NOTE: readers and writers lock the chain hand over hand in the same order, so none is left behind a node once
+    // it is locked here
+    auto current_node = CLeaf::Get(art, *node).ptr;
+    current_node->Lock();
+    while (current_node->IsSet()) {
+      auto next_node = CLeaf::Get(art, *current_node).ptr;
+      next_node->Lock();
+      allocator.Free(*current_node);
+      current_node->Reset();
+      current_node->SetDeleted();
+      current_node->Unlock();
+      current_node = next_node;
+    }
+    current_node->Unlock();
+    allocator.Free(*node);
+  }
+  CLeaf::New(*node, doc_id);
+}
+
 void CLeaf::MoveInlinedToLeaf(ConcurrentART &art, ConcurrentNode &node) {
   assert(node.GetType() == NType::LEAF_INLINED && node.Locked() && !node.IsDeleted());
   auto doc_id = node.GetDocId();
@@ -557,22 +1577,25 @@ void CLeaf::MergeUpdate(ConcurrentART &cart, ART &art, ConcurrentNode *node, Nod
     return;
   }
 
+  // NOTE: the leaf may be segmented, so copy its doc ids instead of walking the chain
+  std::vector<idx_t> doc_ids;
+  Leaf::GetDocIds(art, other, doc_ids, std::numeric_limits<idx_t>::max());
+
   auto current_node = node;
-  auto ref_node = std::ref(other);
+  idx_t offset = 0;
 
-  while (ref_node.get().IsSet()) {
+  while (offset < doc_ids.size()) {
     assert(current_node->Locked());
     current_node->Update(ConcurrentNode::GetAllocator(cart, NType::LEAF).ConcNew());
     current_node->SetType((uint8_t)NType::LEAF);
     auto &cleaf = CLeaf::Get(cart, *current_node);
-    auto &leaf = Leaf::Get(art, ref_node.get());
-    cleaf.count = leaf.count;
-    for (idx_t i = 0; i < leaf.count; i++) {
-      cleaf.row_ids[i] = leaf.row_ids[i];
+    cleaf.count = std::min((idx_t)Node::LEAF_SIZE, doc_ids.size() - offset);
+    for (idx_t i = 0; i < cleaf.count; i++) {
+      cleaf.row_ids[i] = doc_ids[offset + i];
     }
+    offset += cleaf.count;
     cleaf.ptr = cart.AllocateNode();
     cleaf.ptr->ResetAll();
-    ref_node = leaf.ptr;
 
     cleaf.ptr->Lock();
     current_node->Unlock();
@@ -590,24 +1613,19 @@ void CLeaf::ConvertToNode(ConcurrentART &cart, ART &art, ConcurrentNode *src, No
     src->RUnlock();
     return;
   }
+  std::vector<idx_t> doc_ids;
   ConcurrentNode *current_node = src;
-  auto ref_node = std::ref(dst);
   while (current_node->IsSet()) {
     auto &cleaf = CLeaf::Get(cart, *current_node);
-    ref_node.get() = Node::GetAllocator(art, NType::LEAF).New();
-    ref_node.get().SetType((uint8_t)NType::LEAF);
-
-    auto &leaf = Leaf::Get(art, ref_node.get());
-    leaf.count = cleaf.count;
     for (idx_t i = 0; i < cleaf.count; i++) {
-      leaf.row_ids[i] = cleaf.row_ids[i];
+      doc_ids.push_back(cleaf.row_ids[i]);
     }
     cleaf.ptr->RLock();
     current_node->RUnlock();
     current_node = cleaf.ptr;
-    ref_node = leaf.ptr;
   }
   current_node->RUnlock();
+  Leaf::New(art, dst, doc_ids);
 }
 
 void CLeaf::Merge(ConcurrentART &cart, ART &art, ConcurrentNode *src, Node &other) {
@@ -616,13 +1634,8 @@ void CLeaf::Merge(ConcurrentART &cart, ART &art, ConcurrentNode *src, Node &othe
   if (src->GetType() == NType::LEAF_INLINED) {
     MoveInlinedToLeaf(cart, *src);
   }
-  auto &cleaf = CLeaf::Get(cart, *src);
-  if (other.GetType() == NType::LEAF_INLINED) {
-    cleaf.Append(cart, src, other.GetDocId());
-    return;
-  }
-  auto ref_node = std::ref(other);
-
+  // NOTE: CLeaf::Append(cart, node, doc_id) only works on the last leaf of the chain, so inlined doc ids walk the
+  // chain as well
   CLeaf::Append(cart, art, src, other);
   assert(!src->Locked());
 }
@@ -630,33 +1643,30 @@ void CLeaf::Merge(ConcurrentART &cart, ART &art, ConcurrentNode *src, Node &othe
 void CLeaf::Append(ConcurrentART &cart, ART &art, ConcurrentNode *node, Node &other) {
   assert(node->Locked());
 
-  auto ref_node = std::ref(other);
+  std::vector<idx_t> doc_ids;
+  Leaf::GetDocIds(art, other, doc_ids, std::numeric_limits<idx_t>::max());
   auto cleaf = CLeaf::GetPtr(cart, *node);
 
-  while (ref_node.get().IsSet()) {
-    auto &leaf = Leaf::Get(art, ref_node.get());
-    for (idx_t i = 0; i < leaf.count; i++) {
-      while (node->IsSet()) {
+  for (auto doc_id : doc_ids) {
+    while (node->IsSet()) {
+      cleaf = CLeaf::GetPtr(cart, *node);
+      if (cleaf->count < Node::LEAF_SIZE) {
+        break;
+      }
+      cleaf->ptr->Lock();
+      node->Unlock();
+      node = cleaf->ptr;
+      if (!node->IsSet()) {
+        node->Update(ConcurrentNode::GetAllocator(cart, NType::LEAF).ConcNew());
+        node->SetType((uint8_t)NType::LEAF);
         cleaf = CLeaf::GetPtr(cart, *node);
-        if (cleaf->count < Node::LEAF_SIZE) {
-          break;
-        }
-        cleaf->ptr->Lock();
-        node->Unlock();
-        node = cleaf->ptr;
-        if (!node->IsSet()) {
-          node->Update(ConcurrentNode::GetAllocator(cart, NType::LEAF).ConcNew());
-          node->SetType((uint8_t)NType::LEAF);
-          cleaf = CLeaf::GetPtr(cart, *node);
-          cleaf->count = 0;
-          cleaf->ptr = cart.AllocateNode();
-          break;
-        }
+        cleaf->count = 0;
+        cleaf->ptr = cart.AllocateNode();
+        break;
       }
-      cleaf->row_ids[cleaf->count] = leaf.row_ids[i];
-      cleaf->count++;
     }
-    ref_node = leaf.ptr;
+    cleaf->row_ids[cleaf->count] = doc_id;
+    cleaf->count++;
   }
   node->Unlock();
 }
@@ -8,10 +8,12 @@
 
 #include "art.h"
 #include "fixed_size_allocator.h"
+#include "latency_histogram.h"
 #include "leaf.h"
 #include "node16.h"
 #include "node4.h"
 #include "prefix.h"
+#include "trace.h"
 
 namespace part {
 
@@ -30,12 +32,19 @@ Node::Node(Deserializer &reader) {
 }
 
 Node::Node(ART &art, Deserializer &reader) : Node(reader) {
-  if (IsSet() && IsSerialized()) {
+  if (IsSet() && IsSerialized() && !art.lazy_load) {
     Deserialize(art);
   }
 }
 
-FixedSizeAllocator &Node::GetAllocator(const ART &art, NType type) { return (*art.allocators)[(uint8_t)type - 1]; }
+FixedSizeAllocator &Node::GetAllocator(const ART &art, NType type) {
+  auto index = (uint8_t)type - 1;
+  // NOTE: LEAF_INLINED owns no allocator, the types after it take over its slot
+  if (type > NType::LEAF_INLINED) {
+    index--;
+  }
+  return (*art.allocators)[index];
+}
 
 std::optional<Node *> Node::GetChild(ART &art, const uint8_t byte) const {
   std::optional<Node *> child;
@@ -107,6 +116,10 @@ void Node::Free(ART &art, Node &node) {
       case NType::NODE_256:
         Node256::Free(art, node);
         break;
+      case NType::LEAF_SEGMENT:
+      case NType::LEAF_BITMAP:
+        // NOTE: chain nodes are only referenced by their head leaf, which frees them in Leaf::Free
+        throw std::invalid_argument(fmt::format("leaf chain node of type {} freed on its own", (uint8_t)type));
     }
 
     Node::GetAllocator(art, type).Free(node);
@@ -146,6 +159,8 @@ BlockPointer Node::Serialize(ART &art, Serializer &serializer) {
 
 void Node::Deserialize(ART &art) {
   assert(IsSet() && IsSerialized());
+  PART_TRACE(DESERIALIZE_CALLS, 1);
+  ScopedLatency latency(IndexOperation::DESERIALIZE_NODE);
 
   BlockPointer pointer(GetBufferId(), GetOffset());
   BlockDeserializer reader(art.GetIndexFileFd(), pointer);
@@ -186,19 +201,86 @@ void Node::Deserialize(ART &art) {
   }
 }
 
+//! Replaces an inner node holding a single child by that child, concatenated to prefix
+static void CompressSingleChild(ART &art, Node &node, Node &prefix) {
+  uint8_t byte = 0;
+  auto child = *node.GetNextChild(art, byte).value();
+  auto old_node = node;
+  Prefix::Concatenate(art, prefix, byte, child);
+
+  // the child lives on, the node is freed without it
+  switch (old_node.GetType()) {
+    case NType::NODE_4:
+      Node4::Get(art, old_node).count = 0;
+      break;
+    case NType::NODE_16:
+      Node16::Get(art, old_node).count = 0;
+      break;
+    case NType::NODE_48:
+      Node48::Get(art, old_node).count = 0;
+      break;
+    default:
+      Node256::Get(art, old_node).count = 0;
+  }
+  Node::Free(art, old_node);
+}
+
 void Node::DeleteChild(ART &art, Node &node, Node &prefix, const uint8_t byte) {
   switch (node.GetType()) {
     case NType::NODE_4:
       return Node4::DeleteChild(art, node, prefix, byte);
     case NType::NODE_16:
-      return Node16::DeleteChild(art, node, byte);
+      Node16::DeleteChild(art, node, byte);
+      break;
     case NType::NODE_48:
-      return Node48::DeleteChild(art, node, byte);
+      Node48::DeleteChild(art, node, byte);
+      break;
     case NType::NODE_256:
-      return Node256::DeleteChild(art, node, byte);
+      Node256::DeleteChild(art, node, byte);
+      break;
     default:
       throw std::invalid_argument("Invalid node type for DeleteChild.");
   }
+  // NOTE: only with deferred or lowered shrink thresholds a larger node is left with a single child, or shrinks into a
+  // smaller one holding a single child, which is compressed into the prefix the same way node4 does it
+  if (node.ChildCount(art) == 1) {
+    CompressSingleChild(art, node, prefix);
+  }
+}
+
+idx_t Node::ChildCount(const ART &art) const {
+  switch (GetType()) {
+    case NType::NODE_4:
+      return Node4::Get(art, *this).count;
+    case NType::NODE_16:
+      return Node16::Get(art, *this).count;
+    case NType::NODE_48:
+      return Node48::Get(art, *this).count;
+    case NType::NODE_256:
+      return Node256::Get(art, *this).count;
+    default:
+      throw std::invalid_argument("Invalid node type for ChildCount");
+  }
+}
+
+NodeTransitionStats NodeTransitionCounters::Snapshot() const {
+  NodeTransitionStats stats;
+  stats.grow_node4 = grow_node4.load(std::memory_order_relaxed);
+  stats.grow_node16 = grow_node16.load(std::memory_order_relaxed);
+  stats.grow_node48 = grow_node48.load(std::memory_order_relaxed);
+  stats.shrink_node16 = shrink_node16.load(std::memory_order_relaxed);
+  stats.shrink_node48 = shrink_node48.load(std::memory_order_relaxed);
+  stats.shrink_node256 = shrink_node256.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void NodeTransitionCounters::Reset() {
+  grow_node4 = 0;
+  grow_node16 = 0;
+  grow_node48 = 0;
+  shrink_node16 = 0;
+  shrink_node48 = 0;
+  shrink_node256 = 0;
 }
 
 void Node::ReplaceChild(const ART &art, const uint8_t byte, const Node child) {
@@ -281,8 +363,11 @@ bool Node::MergeInternal(ART &art, Node &other) {
   auto &r_node = other;
 
   // l->GetType() >= r->GetType()
-  if (l_node.GetType() == NType::LEAF || r_node.GetType() == NType::LEAF_INLINED) {
-    assert(r_node.GetType() == NType::LEAF || l_node.GetType() == NType::LEAF_INLINED);
+  if (l_node.GetType() == NType::LEAF || l_node.GetType() == NType::LEAF_INLINED) {
+    assert(r_node.GetType() == NType::LEAF || r_node.GetType() == NType::LEAF_INLINED);
+    if (art.IsUnique()) {
+      throw std::invalid_argument("duplicate key while merging into a unique index");
+    }
 
     Leaf::Merge(art, l_node, r_node);
     return true;
@@ -314,6 +399,61 @@ bool Node::MergeInternal(ART &art, Node &other) {
   return true;
 }
 
+void Node::SplitMerge(ART &art, Node &other, std::vector<std::pair<Node *, Node *>> &tasks,
+                      std::vector<Node *> &merged) {
+  assert(IsInner() && other.IsInner());
+
+  // merge smaller nodes into bigger node
+  if (GetType() < other.GetType()) {
+    std::swap(*this, other);
+  }
+
+  // NOTE: inserting may grow this node, so the children are only taken once all inserts are done
+  std::vector<uint8_t> shared_bytes;
+  uint8_t byte = 0;
+  auto r_child = other.GetNextChild(art, byte);
+  while (r_child) {
+    if (GetChild(art, byte)) {
+      shared_bytes.push_back(byte);
+    } else {
+      InsertChild(art, *this, byte, *r_child.value());
+      other.ReplaceChild(art, byte, Node());
+    }
+    if (byte == std::numeric_limits<uint8_t>::max()) {
+      break;
+    }
+    byte++;
+    r_child = other.GetNextChild(art, byte);
+  }
+  merged.push_back(&other);
+
+  for (auto shared_byte : shared_bytes) {
+    auto l_child = GetChild(art, shared_byte).value();
+    auto r_child_node = other.GetChild(art, shared_byte).value();
+    SkipEqualPrefixes(art, l_child, r_child_node, merged);
+    tasks.emplace_back(l_child, r_child_node);
+  }
+}
+
+void Node::SkipEqualPrefixes(ART &art, Node *&l_node, Node *&r_node, std::vector<Node *> &merged) {
+  auto r_start = r_node;
+  while (l_node->IsSet() && r_node->IsSet() && !l_node->IsSerialized() && !r_node->IsSerialized() &&
+         l_node->GetType() == NType::PREFIX && r_node->GetType() == NType::PREFIX) {
+    auto &l_prefix = Prefix::Get(art, *l_node);
+    auto &r_prefix = Prefix::Get(art, *r_node);
+    auto count = l_prefix.data[Node::PREFIX_SIZE];
+    if (count != r_prefix.data[Node::PREFIX_SIZE] || memcmp(l_prefix.data, r_prefix.data, count) != 0) {
+      break;
+    }
+    l_node = &l_prefix.ptr;
+    r_node = &r_prefix.ptr;
+  }
+  // NOTE: freeing the first prefix frees the whole chain, down to the already merged node below it
+  if (r_node != r_start) {
+    merged.push_back(r_start);
+  }
+}
+
 std::optional<Node *> Node::GetNextChild(ART &art, uint8_t &byte) const {
   assert(IsSet());
   switch (GetType()) {
@@ -378,11 +518,33 @@ void Node::ToGraph(ART &art, std::ofstream &out, idx_t &id, std::string parent_i
       out << leaf_prefix << id;
       out << "[shape=plain color=green ";
       out << "label=<<TABLE BORDER=\"0\" CELLBORDER=\"1\" CELLSPACING=\"0\" CELLPADDING=\"4\">\n";
-      out << "<TR><TD COLSPAN=\"" << (uint32_t)leaf.count << "\">leaf_" << id << "</TD></TR><TR>\n";
-      for (int i = 0; i < leaf.count; i++) {
-        out << "<TD>" << leaf.row_ids[i] << "</TD>\n";
+      if (leaf.IsSegmented()) {
+        // one cell per segment with its doc id range
+        out << "<TR><TD COLSPAN=\"" << 1 << "\">leaf_" << id << " (" << leaf.row_ids[0] << ")</TD></TR>\n";
+        auto segment_node = leaf.ptr;
+        while (segment_node.IsSet()) {
+          auto &segment = LeafSegment::Get(art, segment_node);
+          out << "<TR><TD>" << segment.first << ".." << segment.last << " x" << segment.count << "</TD></TR>\n";
+          segment_node = segment.ptr;
+        }
+        out << "</TABLE>>];\n";
+      } else if (leaf.IsBitmap()) {
+        // one cell per container with its high bits
+        out << "<TR><TD COLSPAN=\"" << 1 << "\">leaf_" << id << " (" << leaf.row_ids[0] << ")</TD></TR>\n";
+        auto container_node = leaf.ptr;
+        while (container_node.IsSet()) {
+          auto &container = LeafBitmap::Get(art, container_node);
+          out << "<TR><TD>bitmap " << container.high << " x" << container.count << "</TD></TR>\n";
+          container_node = container.ptr;
+        }
+        out << "</TABLE>>];\n";
+      } else {
+        out << "<TR><TD COLSPAN=\"" << (uint32_t)leaf.count << "\">leaf_" << id << "</TD></TR><TR>\n";
+        for (int i = 0; i < leaf.count; i++) {
+          out << "<TD>" << leaf.row_ids[i] << "</TD>\n";
+        }
+        out << "</TR></TABLE>>];\n";
       }
-      out << "</TR></TABLE>>];\n";
       if (!parent_id.empty()) {
         out << parent_id << "->" << leaf_prefix << id << ";\n";
       }
@@ -7,6 +7,7 @@
 #include "node4.h"
 #include "node48.h"
 #include "prefix.h"
+#include "trace.h"
 
 namespace part {
 
@@ -20,6 +21,8 @@ Node16 &Node16::New(ART &art, Node &node) {
 }
 
 Node16 &part::Node16::GrowNode4(ART &art, Node &node16, Node &node4) {
+  PART_TRACE(GROW_NODE4, 1);
+  NodeTransitionCounters::Add(art.transitions.grow_node4);
   auto &n4 = Node4::Get(art, node4);
   auto &n16 = Node16::New(art, node16);
 
@@ -154,7 +157,8 @@ void Node16::DeleteChild(ART &art, Node &node, const uint8_t byte) {
     n16.children[i] = n16.children[i + 1];
   }
 
-  if (n16.count < Node::NODE_4_CAPACITY) {
+  auto &policy = art.GetShrinkPolicy();
+  if (!policy.deferred && n16.count < policy.node16_threshold) {
     auto node16 = node;
     Node4::ShrinkNode16(art, node, node16);
   }
@@ -170,19 +174,19 @@ void Node16::ReplaceChild(const uint8_t byte, const Node child) {
 }
 
 Node16 &Node16::ShrinkNode48(ART &art, Node &node16, Node &node48) {
+  PART_TRACE(SHRINK_NODE48, 1);
+  NodeTransitionCounters::Add(art.transitions.shrink_node48);
   // TODO: order matters
   auto &n48 = Node48::Get(art, node48);
   auto &n16 = Node16::New(art, node16);
 
   n16.count = 0;
 
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    assert(n16.count <= Node::NODE_16_CAPACITY);
-    if (n48.child_index[i] != Node::EMPTY_MARKER) {
-      n16.key[n16.count] = i;
-      n16.children[n16.count] = n48.children[n48.child_index[i]];
-      n16.count++;
-    }
+  for (auto i = n48.occupied.First(); i != ChildBitmap::END; i = n48.occupied.Next(i + 1)) {
+    assert(n16.count < Node::NODE_16_CAPACITY);
+    n16.key[n16.count] = i;
+    n16.children[n16.count] = n48.children[n48.child_index[i]];
+    n16.count++;
   }
 
   n48.count = 0;
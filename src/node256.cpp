@@ -5,6 +5,7 @@
 #include <node48.h>
 
 #include "prefix.h"
+#include "trace.h"
 
 namespace part {
 
@@ -13,6 +14,7 @@ Node256 &Node256::New(ART &art, Node &node) {
   node.SetType((uint8_t)NType::NODE_256);
 
   auto &n256 = Node256::Get(art, node);
+  n256.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n256.children[i].Reset();
   }
@@ -29,24 +31,21 @@ void Node256::Free(ART &art, Node &node) {
     return;
   }
 
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    if (n256.children[i].IsSet()) {
-      Node::Free(art, n256.children[i]);
-    }
+  for (auto i = n256.occupied.First(); i != ChildBitmap::END; i = n256.occupied.Next(i + 1)) {
+    Node::Free(art, n256.children[i]);
   }
 }
 
 Node256 &Node256::GrowNode48(ART &art, Node &node256, Node &node48) {
+  PART_TRACE(GROW_NODE48, 1);
+  NodeTransitionCounters::Add(art.transitions.grow_node48);
   auto &n48 = Node48::Get(art, node48);
   auto &n256 = Node256::New(art, node256);
 
   n256.count = n48.count;
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    if (n48.child_index[i] != Node::EMPTY_MARKER) {
-      n256.children[i] = n48.children[n48.child_index[i]];
-    } else {
-      n256.children[i].Reset();
-    }
+  n256.occupied = n48.occupied;
+  for (auto i = n48.occupied.First(); i != ChildBitmap::END; i = n48.occupied.Next(i + 1)) {
+    n256.children[i] = n48.children[n48.child_index[i]];
   }
 
   n48.count = 0;
@@ -63,6 +62,7 @@ void Node256::InsertChild(ART &art, Node &node, const uint8_t byte, const Node c
   n256.count++;
   assert(n256.count <= Node::NODE_256_CAPACITY);
   n256.children[byte] = child;
+  n256.occupied.Set(byte);
 }
 
 std::optional<Node *> Node256::GetChild(const uint8_t byte) {
@@ -77,9 +77,9 @@ BlockPointer Node256::Serialize(ART &art, Node &node, Serializer &writer) {
   assert(node.IsSet() && !node.IsSerialized());
   auto &n256 = Node256::Get(art, node);
 
-  std::vector<BlockPointer> child_block_pointers;
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    child_block_pointers.emplace_back(n256.children[i].Serialize(art, writer));
+  std::vector<BlockPointer> child_block_pointers(Node::NODE_256_CAPACITY);
+  for (auto i = n256.occupied.First(); i != ChildBitmap::END; i = n256.occupied.Next(i + 1)) {
+    child_block_pointers[i] = n256.children[i].Serialize(art, writer);
   }
 
   auto block_pointer = writer.GetBlockPointer();
@@ -98,8 +98,12 @@ void Node256::Deserialize(ART &art, Node &node, Deserializer &reader) {
   auto &n256 = Node256::Get(art, node);
   n256.count = reader.Read<uint16_t>();
 
+  n256.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n256.children[i] = Node(art, reader);
+    if (n256.children[i].IsSet()) {
+      n256.occupied.Set(i);
+    }
   }
 }
 
@@ -109,9 +113,11 @@ void Node256::DeleteChild(ART &art, Node &node, const uint8_t byte) {
 
   Node::Free(art, n256.children[byte]);
   n256.children[byte].Reset();
+  n256.occupied.Clear(byte);
   n256.count--;
 
-  if (n256.count < Node::NODE_256_SHRINK_THRESHOLD) {
+  auto &policy = art.GetShrinkPolicy();
+  if (!policy.deferred && n256.count < policy.node256_threshold) {
     // NOTE: important cannot pass reference
     auto node256 = node;
     Node48::ShrinkNode256(art, node, node256);
@@ -119,13 +125,12 @@ void Node256::DeleteChild(ART &art, Node &node, const uint8_t byte) {
 }
 
 std::optional<Node *> Node256::GetNextChild(uint8_t &byte) {
-  for (idx_t i = byte; i < Node::NODE_256_CAPACITY; i++) {
-    if (children[i].IsSet()) {
-      byte = i;
-      return &children[i];
-    }
+  auto next = occupied.Next(byte);
+  if (next == ChildBitmap::END) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  byte = next;
+  return &children[next];
 }
 
 CNode256 &CNode256::New(ConcurrentART &art, ConcurrentNode &node) {
@@ -135,6 +140,7 @@ CNode256 &CNode256::New(ConcurrentART &art, ConcurrentNode &node) {
 
   auto &n256 = CNode256::Get(art, &node);
   n256.count = 0;
+  n256.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n256.children[i] = nullptr;
   }
@@ -146,12 +152,10 @@ void CNode256::Free(ConcurrentART &art, ConcurrentNode *node) {
   assert(node->IsSet() && !node->IsSerialized());
 
   auto &n256 = CNode256::Get(art, node);
-  for (idx_t i = 0; i < n256.count; i++) {
-    if (n256.children[i]) {
-      n256.children[i]->Lock();
-      ConcurrentNode::Free(art, n256.children[i]);
-      n256.children[i]->Unlock();
-    }
+  for (auto i = n256.occupied.First(); i != ChildBitmap::END; i = n256.occupied.Next(i + 1)) {
+    n256.children[i]->Lock();
+    ConcurrentNode::Free(art, n256.children[i]);
+    n256.children[i]->Unlock();
   }
 }
 
@@ -163,10 +167,9 @@ CNode256 &CNode256::GrowNode48(ConcurrentART &art, ConcurrentNode *node48) {
   auto &n256 = CNode256::New(art, *node256);
   node256->Unlock();
   n256.count = n48.count;
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    if (n48.child_index[i] != Node::EMPTY_MARKER) {
-      n256.children[i] = n48.children[n48.child_index[i]];
-    }
+  n256.occupied = n48.occupied;
+  for (auto i = n48.occupied.First(); i != ChildBitmap::END; i = n48.occupied.Next(i + 1)) {
+    n256.children[i] = n48.children[n48.child_index[i]];
   }
   n48.count = 0;
   n48.ShallowFree(art, node48);
@@ -188,6 +191,7 @@ void CNode256::InsertChild(ConcurrentART &art, ConcurrentNode *node, const uint8
   n256.count++;
   assert(n256.count <= Node::NODE_256_CAPACITY);
   n256.children[byte] = child;
+  n256.occupied.Set(byte);
 }
 
 std::optional<ConcurrentNode *> CNode256::GetChild(const uint8_t byte) {
@@ -209,6 +213,7 @@ void CNode256::MergeUpdate(ConcurrentART &cart, ART &art, ConcurrentNode *node,
   auto &n256 = Node256::Get(art, other);
   auto &cn256 = CNode256::Get(cart, node);
   cn256.count = n256.count;
+  cn256.occupied = n256.occupied;
 
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     if (n256.children[i].IsSet()) {
@@ -238,7 +243,6 @@ bool CNode256::TraversePrefix(ConcurrentART &cart, ART &art, ConcurrentNode *nod
     if (pos < prefix.data[Node::PREFIX_SIZE]) {
       return ConcurrentNode::TraversePrefix(cart, art, new_node, other, pos);
     } else {
-      new_node->RLock();
       new_node->Merge(cart, art, prefix.ptr);
       return true;
     }
@@ -256,11 +260,10 @@ void CNode256::ConvertToNode(ConcurrentART &cart, ART &art, ConcurrentNode *src,
   auto &cn256 = CNode256::Get(cart, src);
   auto &n256 = Node256::New(art, dst);
   n256.count = cn256.count;
+  n256.occupied = cn256.occupied;
 
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    if (cn256.children[i]) {
-      ConcurrentNode::ConvertToNode(cart, art, cn256.children[i], n256.children[i]);
-    }
+  for (auto i = cn256.occupied.First(); i != ChildBitmap::END; i = cn256.occupied.Next(i + 1)) {
+    ConcurrentNode::ConvertToNode(cart, art, cn256.children[i], n256.children[i]);
   }
 
   src->RUnlock();
@@ -301,12 +304,15 @@ void CNode256::Deserialize(ConcurrentART &art, ConcurrentNode *node, Deserialize
 
   auto &n256 = CNode256::Get(art, node);
   n256.count = reader.Read<uint16_t>();
+  n256.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n256.children[i] = art.AllocateNode();
     n256.children[i]->Lock();
     bool valid = n256.children[i]->Deserialize(art, reader);
     if (!valid) {
       n256.children[i] = nullptr;
+    } else {
+      n256.occupied.Set(i);
     }
   }
   node->Unlock();
@@ -5,6 +5,7 @@
 #include <node4.h>
 
 #include "prefix.h"
+#include "trace.h"
 
 namespace part {
 
@@ -159,6 +160,8 @@ void Node4::ReplaceChild(const uint8_t byte, const Node child) {
 }
 
 Node4 &Node4::ShrinkNode16(ART &art, Node &node4, Node &node16) {
+  PART_TRACE(SHRINK_NODE16, 1);
+  NodeTransitionCounters::Add(art.transitions.shrink_node16);
   auto &n4 = Node4::New(art, node4);
   auto &n16 = Node16::Get(art, node16);
 
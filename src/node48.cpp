@@ -6,6 +6,7 @@
 #include <node48.h>
 
 #include "prefix.h"
+#include "trace.h"
 
 namespace part {
 
@@ -15,6 +16,7 @@ Node48 &Node48::New(ART &art, Node &node) {
   auto &n48 = Node48::Get(art, node);
 
   n48.count = 0;
+  n48.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n48.child_index[i] = Node::EMPTY_MARKER;
   }
@@ -35,24 +37,21 @@ void Node48::Free(ART &art, Node &node) {
     return;
   }
 
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    if (n48.child_index[i] != Node::EMPTY_MARKER) {
-      Node::Free(art, n48.children[n48.child_index[i]]);
-    }
+  for (auto i = n48.occupied.First(); i != ChildBitmap::END; i = n48.occupied.Next(i + 1)) {
+    Node::Free(art, n48.children[n48.child_index[i]]);
   }
 }
 
 Node48 &Node48::GrowNode16(ART &art, Node &node48, Node &node16) {
+  PART_TRACE(GROW_NODE16, 1);
+  NodeTransitionCounters::Add(art.transitions.grow_node16);
   auto &n16 = Node16::Get(art, node16);
   auto &n48 = Node48::New(art, node48);
 
   n48.count = n16.count;
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    n48.child_index[i] = Node::EMPTY_MARKER;
-  }
-
   for (idx_t i = 0; i < n16.count; i++) {
     n48.child_index[n16.key[i]] = i;
+    n48.occupied.Set(n16.key[i]);
     n48.children[i] = n16.children[i];
   }
 
@@ -82,6 +81,7 @@ void Node48::InsertChild(ART &art, Node &node, const uint8_t byte, const Node ch
     }
     n48.children[child_pos] = child;
     n48.child_index[byte] = child_pos;
+    n48.occupied.Set(byte);
     n48.count++;
   } else {
     auto node48 = node;
@@ -127,8 +127,12 @@ void Node48::Deserialize(ART &art, Node &node, Deserializer &reader) {
   auto &n48 = Node48::Get(art, node);
   n48.count = reader.Read<uint8_t>();
 
+  n48.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n48.child_index[i] = reader.Read<uint8_t>();
+    if (n48.child_index[i] != Node::EMPTY_MARKER) {
+      n48.occupied.Set(i);
+    }
   }
 
   for (idx_t i = 0; i < Node::NODE_48_CAPACITY; i++) {
@@ -143,9 +147,11 @@ void Node48::DeleteChild(ART &art, Node &node, const uint8_t byte) {
 
   Node::Free(art, n48.children[n48.child_index[byte]]);
   n48.child_index[byte] = Node::EMPTY_MARKER;
+  n48.occupied.Clear(byte);
   n48.count--;
 
-  if (n48.count < Node::NODE_48_SHRINK_THRESHOLD) {
+  auto &policy = art.GetShrinkPolicy();
+  if (!policy.deferred && n48.count < policy.node48_threshold) {
     auto node48 = node;
     Node16::ShrinkNode48(art, node, node48);
   }
@@ -157,20 +163,18 @@ void Node48::ReplaceChild(const uint8_t byte, const Node child) {
 }
 
 Node48 &Node48::ShrinkNode256(ART &art, Node &node48, Node &node256) {
+  PART_TRACE(SHRINK_NODE256, 1);
+  NodeTransitionCounters::Add(art.transitions.shrink_node256);
   auto &n48 = Node48::New(art, node48);
   auto &n256 = Node256::Get(art, node256);
 
   n48.count = 0;
-
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
+  n48.occupied = n256.occupied;
+  for (auto i = n256.occupied.First(); i != ChildBitmap::END; i = n256.occupied.Next(i + 1)) {
     assert(n48.count < Node::NODE_48_CAPACITY);
-    if (n256.children[i].IsSet()) {
-      n48.child_index[i] = n48.count;
-      n48.children[n48.count] = n256.children[i];
-      n48.count++;
-    } else {
-      n48.child_index[i] = Node::EMPTY_MARKER;
-    }
+    n48.child_index[i] = n48.count;
+    n48.children[n48.count] = n256.children[i];
+    n48.count++;
   }
 
   for (idx_t i = n48.count; i < Node::NODE_48_CAPACITY; i++) {
@@ -184,14 +188,13 @@ Node48 &Node48::ShrinkNode256(ART &art, Node &node48, Node &node256) {
 }
 
 std::optional<Node *> Node48::GetNextChild(uint8_t &byte) {
-  for (idx_t i = byte; i < Node::NODE_256_CAPACITY; i++) {
-    if (child_index[i] != Node::EMPTY_MARKER) {
-      byte = i;
-      assert(children[child_index[i]].IsSet());
-      return &children[child_index[i]];
-    }
+  auto next = occupied.Next(byte);
+  if (next == ChildBitmap::END) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  byte = next;
+  assert(children[child_index[next]].IsSet());
+  return &children[child_index[next]];
 }
 
 CNode48 &CNode48::New(ConcurrentART &art, ConcurrentNode &node) {
@@ -201,6 +204,7 @@ CNode48 &CNode48::New(ConcurrentART &art, ConcurrentNode &node) {
 
   auto &n48 = CNode48::Get(art, &node);
   n48.count = 0;
+  n48.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n48.child_index[i] = Node::EMPTY_MARKER;
   }
@@ -240,6 +244,7 @@ CNode48 &CNode48::GrowNode16(ConcurrentART &art, ConcurrentNode *node16) {
   n48.count = n16.count;
   for (idx_t i = 0; i < n16.count; i++) {
     n48.child_index[n16.key[i]] = i;
+    n48.occupied.Set(n16.key[i]);
     n48.children[i] = n16.children[i];
   }
 
@@ -278,6 +283,7 @@ void CNode48::InsertChild(ConcurrentART &art, ConcurrentNode *node, const uint8_
     }
     n48.children[child_pos] = child;
     n48.child_index[byte] = child_pos;
+    n48.occupied.Set(byte);
     n48.count++;
   } else {
     CNode256::GrowNode48(art, node);
@@ -304,6 +310,7 @@ void CNode48::MergeUpdate(ConcurrentART &cart, ART &art, ConcurrentNode *node, N
   auto &cn48 = CNode48::Get(cart, node);
 
   cn48.count = n48.count;
+  cn48.occupied = n48.occupied;
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     cn48.child_index[i] = n48.child_index[i];
     if (cn48.child_index[i] != Node::EMPTY_MARKER) {
@@ -349,11 +356,10 @@ void CNode48::ConvertToNode(ConcurrentART &cart, ART &art, ConcurrentNode *src,
   auto &n48 = Node48::New(art, dst);
 
   n48.count = cn48.count;
+  n48.occupied = cn48.occupied;
   std::memcpy(n48.child_index, cn48.child_index, sizeof(cn48.child_index));
-  for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
-    if (cn48.child_index[i] != Node::EMPTY_MARKER) {
-      ConcurrentNode::ConvertToNode(cart, art, cn48.children[cn48.child_index[i]], n48.children[n48.child_index[i]]);
-    }
+  for (auto i = cn48.occupied.First(); i != ChildBitmap::END; i = cn48.occupied.Next(i + 1)) {
+    ConcurrentNode::ConvertToNode(cart, art, cn48.children[cn48.child_index[i]], n48.children[n48.child_index[i]]);
   }
   src->RUnlock();
 }
@@ -399,8 +405,12 @@ void CNode48::Deserialize(ConcurrentART &art, ConcurrentNode *node, Deserializer
   auto &n48 = CNode48::Get(art, node);
   n48.count = reader.Read<uint8_t>();
 
+  n48.occupied.Reset();
   for (idx_t i = 0; i < Node::NODE_256_CAPACITY; i++) {
     n48.child_index[i] = reader.Read<uint8_t>();
+    if (n48.child_index[i] != Node::EMPTY_MARKER) {
+      n48.occupied.Set(i);
+    }
   }
 
   for (idx_t i = 0; i < Node::NODE_48_CAPACITY; i++) {
@@ -7,6 +7,7 @@
 #include "art_key.h"
 #include "concurrent_art.h"
 #include "node.h"
+#include "trace.h"
 
 namespace part {
 
@@ -46,13 +47,16 @@ idx_t Prefix::Traverse(ART &art, std::reference_wrapper<Node> &prefix_node, cons
   assert(prefix_node.get().GetType() == NType::PREFIX);
 
   while (prefix_node.get().GetType() == NType::PREFIX) {
+    PART_TRACE_NODE_VISIT(NType::PREFIX);
     auto &prefix = Prefix::Get(art, prefix_node);
     for (idx_t i = 0; i < prefix.data[Node::PREFIX_SIZE]; i++) {
       if (prefix.data[i] != key[depth]) {
+        PART_TRACE(PREFIX_BYTES_COMPARED, i + 1);
         return i;
       }
       depth++;
     }
+    PART_TRACE(PREFIX_BYTES_COMPARED, prefix.data[Node::PREFIX_SIZE]);
     prefix_node = prefix.ptr;
     P_ASSERT(prefix_node.get().IsSet());
     if (prefix_node.get().IsSerialized()) {
@@ -95,6 +99,7 @@ bool Prefix::Traverse(ART &art, reference<Node> &l_node, reference<Node> &r_node
 
 void Prefix::Split(ART &art, std::reference_wrapper<Node> &prefix_node, Node &child_node, idx_t position) {
   assert(prefix_node.get().IsSet() && !prefix_node.get().IsSerialized());
+  PART_TRACE(PREFIX_SPLITS, 1);
 
   auto &prefix = Prefix::Get(art, prefix_node);
 
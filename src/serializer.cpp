@@ -3,6 +3,8 @@
 //
 #include "serializer.h"
 
+#include "trace.h"
+
 namespace part {
 
 void SequentialSerializer::WriteData(const_data_ptr_t buffer, idx_t write_size) {
@@ -73,6 +75,7 @@ void SequentialSerializer::Flush() {
 BlockPointer SequentialSerializer::GetBlockPointer() { return BlockPointer(block_id_, offset_); }
 
 void BlockDeserializer::ReadData(data_ptr_t buffer, idx_t read_size) {
+  PART_TRACE(DESERIALIZE_BYTES, read_size);
   auto offset = block_id_ * BLOCK_SIZE + offset_;
   ssize_t r = pread(fd_, buffer, read_size, offset);
   if (r != read_size) {
@@ -0,0 +1,157 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "sharded_art.h"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+#include <queue>
+#include <string_view>
+
+#include "art_iterator.h"
+#include "task_scheduler.h"
+
+namespace part {
+
+ShardedART::ShardedART(idx_t shard_count, ShardPartitioner partitioner)
+    : partitioner(partitioner), shards(shard_count) {
+  if (shard_count == 0) {
+    throw std::invalid_argument("ShardedART needs at least one shard");
+  }
+  for (auto &shard : shards) {
+    shard.art = std::make_unique<ART>();
+  }
+}
+
+ShardedART::ShardedART(const std::string &index_path, idx_t shard_count, ShardPartitioner partitioner,
+                       bool fast_serialize)
+    : partitioner(partitioner), index_path(index_path), shards(shard_count) {
+  if (shard_count == 0) {
+    throw std::invalid_argument("ShardedART needs at least one shard");
+  }
+  for (idx_t i = 0; i < shard_count; i++) {
+    auto shard_path = ShardPath(index_path, i);
+    // NOTE: the fast serialize format can only be opened once it was written
+    std::error_code ec;
+    auto file_size = std::filesystem::file_size(shard_path, ec);
+    if (fast_serialize && !ec && file_size > 0) {
+      shards[i].art = std::make_unique<ART>(shard_path, true);
+    } else {
+      shards[i].art = std::make_unique<ART>(shard_path);
+    }
+  }
+}
+
+std::string ShardedART::ShardPath(const std::string &index_path, idx_t shard_id) {
+  return fmt::format("{}.{}", index_path, shard_id);
+}
+
+idx_t ShardedART::ShardOf(const ARTKey &key) const {
+  if (partitioner == ShardPartitioner::RANGE) {
+    return key.len == 0 ? 0 : key[0] * shards.size() / Node::NODE_256_CAPACITY;
+  }
+  auto hash = std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char *>(key.data), key.len));
+  return hash % shards.size();
+}
+
+void ShardedART::Put(const ARTKey &key, idx_t doc_id) {
+  auto &shard = shards[ShardOf(key)];
+  std::lock_guard<std::mutex> guard(shard.lock);
+  shard.art->Put(key, doc_id);
+}
+
+bool ShardedART::Get(const ARTKey &key, std::vector<idx_t> &result_ids) {
+  auto &shard = shards[ShardOf(key)];
+  std::lock_guard<std::mutex> guard(shard.lock);
+  return shard.art->Get(key, result_ids);
+}
+
+void ShardedART::Delete(const ARTKey &key, idx_t doc_id) {
+  auto &shard = shards[ShardOf(key)];
+  std::lock_guard<std::mutex> guard(shard.lock);
+  shard.art->Delete(key, doc_id);
+}
+
+void ShardedART::Scan(const ARTKey &lower, const ARTKey &upper,
+                      const std::function<bool(const ARTKey &key, const std::vector<idx_t> &doc_ids)> &fn) {
+  // NOTE: shards are always locked in the same order, so concurrent scans cannot deadlock
+  std::vector<std::unique_lock<std::mutex>> guards;
+  guards.reserve(shards.size());
+  for (auto &shard : shards) {
+    guards.emplace_back(shard.lock);
+  }
+
+  std::vector<ARTIterator> iterators;
+  iterators.reserve(shards.size());
+  for (auto &shard : shards) {
+    iterators.emplace_back(*shard.art);
+  }
+
+  // k-way merge over the shard iterators, the smallest key on top
+  auto greater = [&](idx_t a, idx_t b) { return iterators[b].Key() < iterators[a].Key(); };
+  std::priority_queue<idx_t, std::vector<idx_t>, decltype(greater)> heap(greater);
+  for (idx_t i = 0; i < iterators.size(); i++) {
+    if (iterators[i].Seek(lower)) {
+      heap.push(i);
+    }
+  }
+
+  std::vector<idx_t> doc_ids;
+  while (!heap.empty()) {
+    auto i = heap.top();
+    heap.pop();
+    auto key = iterators[i].Key();
+    if (upper < key) {
+      // every other shard is past the upper bound as well
+      return;
+    }
+    doc_ids.clear();
+    iterators[i].GetDocIds(doc_ids);
+    if (!fn(key, doc_ids)) {
+      return;
+    }
+    if (iterators[i].Next()) {
+      heap.push(i);
+    }
+  }
+}
+
+void ShardedART::forEachShardParallel(const std::function<void(ART &art)> &fn) {
+  if (!scheduler) {
+    scheduler = TaskScheduler::Default();
+  }
+  TaskGroup group(*scheduler);
+  for (auto &shard : shards) {
+    group.Run([&fn, &shard]() {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      fn(*shard.art);
+    });
+  }
+  group.Wait();
+}
+
+void ShardedART::Serialize() {
+  if (index_path.empty()) {
+    throw std::invalid_argument("cannot serialize a ShardedART without index path");
+  }
+  forEachShardParallel([](ART &art) { art.Serialize(); });
+}
+
+void ShardedART::FastSerialize() {
+  if (index_path.empty()) {
+    throw std::invalid_argument("cannot serialize a ShardedART without index path");
+  }
+  forEachShardParallel([](ART &art) { art.FastSerialize(); });
+}
+
+idx_t ShardedART::GetMemoryUsage() {
+  idx_t total = 0;
+  for (auto &shard : shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    total += shard.art->GetMemoryUsage();
+  }
+  return total;
+}
+
+}  // namespace part
@@ -0,0 +1,232 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "task_scheduler.h"
+
+#include <algorithm>
+
+namespace part {
+
+//! The scheduler and worker id of the calling thread, set on the worker threads only
+static thread_local const TaskScheduler *current_scheduler = nullptr;
+static thread_local idx_t current_worker_id = INVALID_INDEX;
+
+TaskScheduler::TaskScheduler(idx_t thread_count) : queued(0), stopped(false), next_worker(0) {
+  thread_count = std::max<idx_t>(thread_count, 1);
+  max_concurrency = thread_count;
+  for (idx_t i = 0; i < thread_count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  for (idx_t i = 0; i < thread_count; i++) {
+    threads.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopped = true;
+  }
+  cv.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+std::shared_ptr<TaskScheduler> TaskScheduler::Default() {
+  static auto scheduler = std::make_shared<TaskScheduler>();
+  return scheduler;
+}
+
+void TaskScheduler::SetMaxConcurrency(idx_t max_concurrency_p) {
+  {
+    // NOTE: a worker checks the limit under lock before it sleeps, so raising it in between cannot be missed
+    std::lock_guard<std::mutex> guard(lock);
+    max_concurrency = std::clamp<idx_t>(max_concurrency_p, 1, workers.size());
+  }
+  cv.notify_all();
+}
+
+idx_t TaskScheduler::WorkerId() const { return current_scheduler == this ? current_worker_id : INVALID_INDEX; }
+
+void TaskScheduler::Schedule(Task task) {
+  // a task spawned by a worker stays with it, the others are spread over the workers allowed to run
+  auto worker_id = WorkerId();
+  if (worker_id == INVALID_INDEX) {
+    worker_id = next_worker++ % max_concurrency;
+  }
+  {
+    auto &worker = *workers[worker_id];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    worker.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queued++;
+  }
+  // NOTE: not notify_one, the woken worker may be above the concurrency limit
+  cv.notify_all();
+}
+
+bool TaskScheduler::pop(idx_t worker_id, Task &task) {
+  for (idx_t i = 0; i < workers.size(); i++) {
+    auto &worker = *workers[(worker_id + i) % workers.size()];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if (worker.tasks.empty()) {
+      continue;
+    }
+    // own tasks are taken from the back while they are still warm, stolen ones from the front
+    if (i == 0) {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    } else {
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+bool TaskScheduler::RunOne(idx_t worker_id) {
+  Task task;
+  if (!pop(worker_id, task)) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queued--;
+  }
+  task();
+  return true;
+}
+
+void TaskScheduler::workerLoop(idx_t worker_id) {
+  current_scheduler = this;
+  current_worker_id = worker_id;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      // NOTE: a stopped scheduler drains its queues regardless of the concurrency limit
+      cv.wait(guard, [&] { return stopped || (queued > 0 && worker_id < max_concurrency); });
+      if (stopped && queued <= 0) {
+        return;
+      }
+    }
+    if (!RunOne(worker_id)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+TaskGroup::TaskGroup(TaskScheduler &scheduler, idx_t max_concurrency, std::vector<FixedSizeAllocator> *allocators)
+    : scheduler(scheduler),
+      max_concurrency(max_concurrency),
+      running(0),
+      allocators(allocators),
+      caches(scheduler.ThreadCount()) {}
+
+TaskGroup::~TaskGroup() {
+  try {
+    Wait();
+  } catch (...) {
+  }
+}
+
+void TaskGroup::Run(TaskScheduler::Task task) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (max_concurrency > 0 && running >= max_concurrency) {
+      pending.push_back(std::move(task));
+      return;
+    }
+    running++;
+  }
+  submit(std::move(task));
+}
+
+void TaskGroup::submit(TaskScheduler::Task task) {
+  scheduler.Schedule([this, task = std::move(task)] {
+    run(task);
+    finish();
+  });
+}
+
+void TaskGroup::run(const TaskScheduler::Task &task) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (error) {
+      return;
+    }
+  }
+  try {
+    if (!allocators) {
+      task();
+      return;
+    }
+    auto &cache = caches[scheduler.WorkerId()];
+    if (!cache) {
+      cache = std::make_unique<AllocatorCache>(*allocators, allocator_lock);
+    }
+    AllocatorCacheGuard cache_guard(*cache);
+    task();
+  } catch (...) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!error) {
+      error = std::current_exception();
+    }
+  }
+}
+
+void TaskGroup::finish() {
+  TaskScheduler::Task next;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (pending.empty()) {
+      running--;
+      // NOTE: notified under the lock, Wait may return and destroy the group right after
+      if (running == 0) {
+        cv.notify_all();
+      }
+      return;
+    }
+    next = std::move(pending.front());
+    pending.pop_front();
+  }
+  submit(std::move(next));
+}
+
+void TaskGroup::Wait() {
+  auto worker_id = scheduler.WorkerId();
+  if (worker_id != INVALID_INDEX) {
+    // a worker waiting idle could leave the tasks of this group without a thread to run them
+    while (true) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if (running == 0) {
+          break;
+        }
+      }
+      if (!scheduler.RunOne(worker_id)) {
+        std::this_thread::yield();
+      }
+    }
+  } else {
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [this] { return running == 0; });
+  }
+
+  for (auto &cache : caches) {
+    cache.reset();
+  }
+  std::exception_ptr first_error;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    std::swap(first_error, error);
+  }
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
+
+}  // namespace part
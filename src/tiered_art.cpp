@@ -0,0 +1,246 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "tiered_art.h"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+
+#include "art_iterator.h"
+#include "art_stream.h"
+
+namespace part {
+
+TieredART::Run::~Run() {
+  art.reset();
+  if (obsolete) {
+    std::filesystem::remove(path);
+    std::filesystem::remove(ART::FilterPath(path));
+  }
+}
+
+TieredART::TieredART(const std::string &index_path, idx_t memtable_limit, idx_t compaction_trigger,
+                     idx_t bits_per_key, std::shared_ptr<TaskScheduler> scheduler_p)
+    : index_path(index_path),
+      memtable_limit(std::max<idx_t>(memtable_limit, 1)),
+      compaction_trigger(std::max<idx_t>(compaction_trigger, 2)),
+      bits_per_key(bits_per_key),
+      memtable(std::make_unique<ART>()),
+      memtable_count(0),
+      next_run_id(0),
+      compaction_queued(false),
+      filtered_count(0),
+      scheduler(scheduler_p ? std::move(scheduler_p) : TaskScheduler::Default()),
+      compactions(*scheduler, 1) {
+  readManifest();
+}
+
+TieredART::~TieredART() { Flush(); }
+
+std::string TieredART::RunPath(const std::string &index_path, idx_t run_id) {
+  return fmt::format("{}.run.{}", index_path, run_id);
+}
+
+std::string TieredART::ManifestPath(const std::string &index_path) { return fmt::format("{}.manifest", index_path); }
+
+void TieredART::Put(const ARTKey &key, idx_t doc_id) {
+  {
+    std::lock_guard<std::mutex> guard(memtable_lock);
+    memtable->Put(key, doc_id);
+    memtable_count++;
+    if (memtable_count < memtable_limit) {
+      return;
+    }
+  }
+  flushMemtable(true);
+}
+
+bool TieredART::Get(const ARTKey &key, std::vector<idx_t> &result_ids) {
+  std::vector<std::shared_ptr<Run>> snapshot;
+  std::shared_ptr<ART> flushing;
+  bool found;
+  {
+    // NOTE: the immutable memtable and the runs are taken under the memtable lock, and a flush publishes its run and
+    // drops the immutable memtable under it as well, so a concurrent flush cannot report a doc id twice
+    std::lock_guard<std::mutex> guard(memtable_lock);
+    found = memtable->Get(key, result_ids);
+    flushing = immutable;
+    std::lock_guard<std::mutex> runs_guard(runs_lock);
+    snapshot = runs;
+  }
+  // NOTE: the flush only iterates the immutable memtable, reading it concurrently is safe
+  if (flushing) {
+    found = flushing->Get(key, result_ids) || found;
+  }
+
+  for (auto it = snapshot.rbegin(); it != snapshot.rend(); it++) {
+    auto &run = *it;
+    if (run->filter && !run->filter->MayContain(key)) {
+      filtered_count++;
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(run->lock);
+    if (!run->art) {
+      run->art = std::make_unique<ART>(run->path, nullptr, IndexConstraintType::NONE, true);
+    }
+    found = run->art->Get(key, result_ids) || found;
+  }
+  return found;
+}
+
+void TieredART::Flush() { flushMemtable(false); }
+
+void TieredART::flushMemtable(bool only_if_full) {
+  std::lock_guard<std::mutex> flush_guard(flush_lock);
+  idx_t doc_count;
+  {
+    std::lock_guard<std::mutex> guard(memtable_lock);
+    if (memtable_count == 0 || (only_if_full && memtable_count < memtable_limit)) {
+      return;
+    }
+    immutable = std::move(memtable);
+    doc_count = memtable_count;
+    memtable = std::make_unique<ART>();
+    memtable_count = 0;
+  }
+
+  auto run = newRun();
+  {
+    // NOTE: doc_count counts doc ids, an upper bound of the key count the filter is sized for
+    ARTStreamWriter writer(run->path, doc_count, bits_per_key);
+    ARTIterator it(*immutable);
+    std::vector<idx_t> doc_ids;
+    for (bool valid = it.SeekToFirst(); valid; valid = it.Next()) {
+      doc_ids.clear();
+      it.GetDocIds(doc_ids);
+      writer.Append(it.Key(), doc_ids);
+    }
+    writer.Finish();
+  }
+  run->filter = ART::ReadFilter(run->path);
+
+  bool compaction_due_now;
+  {
+    std::lock_guard<std::mutex> guard(memtable_lock);
+    std::lock_guard<std::mutex> runs_guard(runs_lock);
+    runs.push_back(run);
+    writeManifest();
+    compaction_due_now = runs.size() >= compaction_trigger;
+    immutable.reset();
+  }
+
+  if (compaction_due_now) {
+    scheduleCompaction();
+  }
+}
+
+std::shared_ptr<TieredART::Run> TieredART::newRun() {
+  idx_t run_id;
+  {
+    std::lock_guard<std::mutex> guard(runs_lock);
+    run_id = next_run_id++;
+  }
+  auto run = std::make_shared<Run>();
+  run->run_id = run_id;
+  run->path = RunPath(index_path, run_id);
+  return run;
+}
+
+std::shared_ptr<TieredART::Run> TieredART::openRun(idx_t run_id) {
+  auto run = std::make_shared<Run>();
+  run->run_id = run_id;
+  run->path = RunPath(index_path, run_id);
+  if (!std::filesystem::exists(run->path)) {
+    throw std::invalid_argument(fmt::format("run {} listed in the manifest does not exist", run->path));
+  }
+  run->filter = ART::ReadFilter(run->path);
+  return run;
+}
+
+void TieredART::writeManifest() {
+  // NOTE: the manifest is replaced by a rename, so a crash leaves either the old or the new run list
+  auto manifest_path = ManifestPath(index_path);
+  auto tmp_path = manifest_path + ".tmp";
+  std::filesystem::remove(tmp_path);
+  {
+    SequentialSerializer writer(tmp_path);
+    writer.Write<idx_t>(runs.size());
+    for (auto &run : runs) {
+      writer.Write<idx_t>(run->run_id);
+    }
+    writer.Flush();
+  }
+  std::filesystem::rename(tmp_path, manifest_path);
+}
+
+void TieredART::readManifest() {
+  auto manifest_path = ManifestPath(index_path);
+  if (!std::filesystem::exists(manifest_path)) {
+    return;
+  }
+  BlockDeserializer reader(manifest_path, BlockPointer(0, 0));
+  auto run_count = reader.Read<idx_t>();
+  for (idx_t i = 0; i < run_count; i++) {
+    auto run_id = reader.Read<idx_t>();
+    runs.push_back(openRun(run_id));
+    next_run_id = std::max(next_run_id, run_id + 1);
+  }
+}
+
+void TieredART::Compact() {
+  std::lock_guard<std::mutex> guard(compaction_lock);
+  std::vector<std::shared_ptr<Run>> inputs;
+  {
+    std::lock_guard<std::mutex> runs_guard(runs_lock);
+    inputs = runs;
+  }
+  if (inputs.size() <= 1) {
+    return;
+  }
+
+  // NOTE: the runs are merged as streams straight from their files, neither the inputs nor the output are loaded
+  std::vector<std::string> input_paths;
+  for (auto &run : inputs) {
+    input_paths.push_back(run->path);
+  }
+  auto output = newRun();
+  ARTStreamWriter::MergeFiles(input_paths, output->path, bits_per_key);
+  output->filter = ART::ReadFilter(output->path);
+
+  // only flushes add runs in the meantime, so the inputs are still the oldest runs
+  std::lock_guard<std::mutex> runs_guard(runs_lock);
+  runs.erase(runs.begin(), runs.begin() + inputs.size());
+  runs.insert(runs.begin(), output);
+  writeManifest();
+  for (auto &run : inputs) {
+    run->obsolete = true;
+  }
+}
+
+void TieredART::scheduleCompaction() {
+  {
+    std::lock_guard<std::mutex> guard(state_lock);
+    if (compaction_queued) {
+      return;
+    }
+    compaction_queued = true;
+  }
+  // NOTE: the group runs one compaction at a time, one queued behind a running compaction picks up its new runs
+  compactions.Run([this] {
+    {
+      std::lock_guard<std::mutex> guard(state_lock);
+      compaction_queued = false;
+    }
+    Compact();
+  });
+}
+
+void TieredART::WaitCompaction() { compactions.Wait(); }
+
+idx_t TieredART::RunCount() {
+  std::lock_guard<std::mutex> guard(runs_lock);
+  return runs.size();
+}
+
+}  // namespace part
@@ -0,0 +1,64 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "trace.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace part {
+
+//! The counters of the live threads and the counts of the threads that exited
+struct TraceRegistry {
+  std::mutex lock;
+  std::vector<std::array<std::atomic<uint64_t>, TRACE_EVENT_COUNT> *> threads;
+  std::array<uint64_t, TRACE_EVENT_COUNT> exited = {};
+};
+
+static TraceRegistry &Registry() {
+  // NOTE: never destroyed, threads may exit after the static destructors ran
+  static auto *registry = new TraceRegistry();
+  return *registry;
+}
+
+Trace::ThreadCounters::ThreadCounters() {
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.threads.push_back(&counts);
+}
+
+Trace::ThreadCounters::~ThreadCounters() {
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  for (idx_t i = 0; i < TRACE_EVENT_COUNT; i++) {
+    registry.exited[i] += counts[i].load(std::memory_order_relaxed);
+  }
+  registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &counts));
+}
+
+TraceStats Trace::Snapshot() {
+  TraceStats stats;
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  stats.counts = registry.exited;
+  for (auto *thread : registry.threads) {
+    for (idx_t i = 0; i < TRACE_EVENT_COUNT; i++) {
+      stats.counts[i] += (*thread)[i].load(std::memory_order_relaxed);
+    }
+  }
+  return stats;
+}
+
+void Trace::Reset() {
+  auto &registry = Registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.exited.fill(0);
+  for (auto *thread : registry.threads) {
+    for (auto &counter : *thread) {
+      counter.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace part
@@ -0,0 +1,294 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include "tree_shape.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+#include "leaf.h"
+#include "node16.h"
+#include "node256.h"
+#include "node4.h"
+#include "node48.h"
+#include "prefix.h"
+#include "task_scheduler.h"
+
+namespace part {
+
+static const char *TypeName(idx_t type) {
+  static const char *names[NTYPE_COUNT] = {"",     "prefix", "leaf", "node4", "node16", "node48", "node256",
+                                           "leaf inlined", "leaf segment", "leaf bitmap"};
+  return names[type];
+}
+
+static void AddTo(std::vector<idx_t> &histogram, idx_t value, idx_t count = 1) {
+  if (histogram.size() <= value) {
+    histogram.resize(value + 1);
+  }
+  histogram[value] += count;
+}
+
+static void MergeHistogram(std::vector<idx_t> &histogram, const std::vector<idx_t> &other) {
+  for (idx_t i = 0; i < other.size(); i++) {
+    if (other[i] > 0) {
+      AddTo(histogram, i, other[i]);
+    }
+  }
+}
+
+namespace {
+
+//! A subtree left to a task by the walk of the top of the tree
+struct SubtreeTask {
+  Node *node;
+  idx_t depth;
+  idx_t prefix_length;
+  std::vector<uint8_t> key;
+};
+
+class ShapeWalker {
+ public:
+  ShapeWalker(ART &art, TreeShape &shape, std::vector<uint8_t> key) : art(art), shape(shape), key(std::move(key)) {}
+
+  //! depth counts the nodes above node, prefix_length the bytes of the prefix nodes right above it. With tasks, the
+  //! walk stops at the first nodes below subtree_bytes key bytes and leaves them to tasks
+  void Walk(Node &node, idx_t depth, idx_t prefix_length, std::vector<SubtreeTask> *tasks = nullptr,
+            idx_t subtree_bytes = 0) {
+    if (node.IsSerialized()) {
+      node.Deserialize(art);
+    }
+    auto type = node.GetType();
+    if (tasks && (key.size() >= subtree_bytes || type == NType::LEAF || type == NType::LEAF_INLINED)) {
+      tasks->push_back({&node, depth, prefix_length, key});
+      return;
+    }
+    if (prefix_length > 0 && type != NType::PREFIX) {
+      AddTo(shape.prefix_length_histogram, prefix_length);
+    }
+
+    shape.node_counts[static_cast<idx_t>(type)]++;
+    switch (type) {
+      case NType::PREFIX: {
+        auto &prefix = Prefix::Get(art, node);
+        auto length = prefix.data[Node::PREFIX_SIZE];
+        key.insert(key.end(), prefix.data, prefix.data + length);
+        Walk(prefix.ptr, depth + 1, prefix_length + length, tasks, subtree_bytes);
+        key.resize(key.size() - length);
+        return;
+      }
+      case NType::LEAF_INLINED:
+        addKey(depth, 1);
+        return;
+      case NType::LEAF:
+        walkLeaf(node, depth);
+        return;
+      default:
+        break;
+    }
+
+    idx_t count = 0;
+    uint8_t byte = 0;
+    for (auto child = node.GetNextChild(art, byte); child; child = node.GetNextChild(art, byte)) {
+      count++;
+      key.push_back(byte);
+      Walk(*child.value(), depth + 1, 0, tasks, subtree_bytes);
+      key.pop_back();
+      if (byte == UINT8_MAX) {
+        break;
+      }
+      byte++;
+    }
+    addInner(type, count);
+  }
+
+ private:
+  void addKey(idx_t depth, idx_t doc_ids) {
+    shape.keys++;
+    shape.doc_ids += doc_ids;
+    AddTo(shape.depth_histogram, depth);
+    AddTo(shape.key_length_histogram, key.size());
+  }
+
+  void walkLeaf(Node &node, idx_t depth) {
+    auto &head = Leaf::Get(art, node);
+    if (head.IsSegmented() || head.IsBitmap()) {
+      auto chain_type = head.IsSegmented() ? NType::LEAF_SEGMENT : NType::LEAF_BITMAP;
+      shape.node_counts[static_cast<idx_t>(chain_type)] += head.row_ids[2];
+      addKey(depth, head.row_ids[0]);
+      return;
+    }
+    idx_t doc_ids = head.count;
+    auto next = std::ref(head.ptr);
+    while (next.get().IsSet()) {
+      if (next.get().IsSerialized()) {
+        next.get().Deserialize(art);
+      }
+      auto &leaf = Leaf::Get(art, next);
+      shape.node_counts[static_cast<idx_t>(NType::LEAF)]++;
+      doc_ids += leaf.count;
+      next = leaf.ptr;
+    }
+    addKey(depth, doc_ids);
+  }
+
+  void addInner(NType type, idx_t count) {
+    auto &policy = art.GetShrinkPolicy();
+    idx_t capacity = 0;
+    idx_t shrink_threshold = 0;
+    switch (type) {
+      case NType::NODE_4:
+        capacity = Node::NODE_4_CAPACITY;
+        break;
+      case NType::NODE_16:
+        capacity = Node::NODE_16_CAPACITY;
+        shrink_threshold = policy.node16_threshold;
+        break;
+      case NType::NODE_48:
+        capacity = Node::NODE_48_CAPACITY;
+        shrink_threshold = policy.node48_threshold;
+        break;
+      case NType::NODE_256:
+        capacity = Node::NODE_256_CAPACITY;
+        shrink_threshold = policy.node256_threshold;
+        break;
+      default:
+        throw std::invalid_argument(fmt::format("unexpected node type {}", static_cast<uint8_t>(type)));
+    }
+    auto index = static_cast<idx_t>(type);
+    AddTo(shape.fanout_histograms[index], count);
+    // NOTE: a node grows on an insert into a full node and shrinks once a removal leaves fewer children than the
+    // threshold, a node4 is never shrunk into another inner node
+    if (type != NType::NODE_256 && count + TreeShape::THRESHOLD_DISTANCE > capacity) {
+      shape.near_grow[index]++;
+    }
+    if (shrink_threshold > 0 && count < shrink_threshold + TreeShape::THRESHOLD_DISTANCE) {
+      shape.near_shrink[index]++;
+    }
+  }
+
+  ART &art;
+  TreeShape &shape;
+  std::vector<uint8_t> key;
+};
+
+}  // namespace
+
+TreeShape TreeShape::Analyze(ART &art, idx_t thread_count, idx_t subtree_bytes, idx_t top_k) {
+  TreeShape shape;
+  if (!art.root->IsSet()) {
+    return shape;
+  }
+  std::vector<SubtreeTask> tasks;
+  ShapeWalker(art, shape, {}).Walk(*art.root, 0, 0, &tasks, subtree_bytes);
+
+  std::vector<TreeShape> subtree_shapes(tasks.size());
+  auto walk_subtree = [&art, &tasks, &subtree_shapes](idx_t i) {
+    auto &task = tasks[i];
+    ShapeWalker(art, subtree_shapes[i], task.key).Walk(*task.node, task.depth, task.prefix_length);
+  };
+  // NOTE: lazily loaded nodes are deserialized into the shared allocators on the way, which only one thread may do
+  if (thread_count > 1 && !art.lazy_load && tasks.size() > 1) {
+    TaskGroup group(art.GetTaskScheduler(), thread_count);
+    for (idx_t i = 0; i < tasks.size(); i++) {
+      group.Run([&walk_subtree, i] { walk_subtree(i); });
+    }
+    group.Wait();
+  } else {
+    for (idx_t i = 0; i < tasks.size(); i++) {
+      walk_subtree(i);
+    }
+  }
+
+  std::vector<SubtreeShape> subtrees;
+  subtrees.reserve(tasks.size());
+  for (idx_t i = 0; i < tasks.size(); i++) {
+    shape.Merge(subtree_shapes[i]);
+    subtrees.push_back(
+        {std::move(tasks[i].key), subtree_shapes[i].NodeCount(), subtree_shapes[i].keys, subtree_shapes[i].doc_ids});
+  }
+  auto largest = [&subtrees, top_k](auto greater) {
+    auto count = std::min(top_k, subtrees.size());
+    std::partial_sort(subtrees.begin(), subtrees.begin() + count, subtrees.end(), greater);
+    return std::vector<SubtreeShape>(subtrees.begin(), subtrees.begin() + count);
+  };
+  shape.largest_by_nodes = largest([](auto &l, auto &r) { return l.nodes > r.nodes; });
+  shape.largest_by_doc_ids = largest([](auto &l, auto &r) { return l.doc_ids > r.doc_ids; });
+  return shape;
+}
+
+idx_t TreeShape::NodeCount() const {
+  idx_t count = 0;
+  for (auto node_count : node_counts) {
+    count += node_count;
+  }
+  return count;
+}
+
+void TreeShape::Merge(const TreeShape &other) {
+  for (idx_t i = 0; i < NTYPE_COUNT; i++) {
+    node_counts[i] += other.node_counts[i];
+    near_grow[i] += other.near_grow[i];
+    near_shrink[i] += other.near_shrink[i];
+    MergeHistogram(fanout_histograms[i], other.fanout_histograms[i]);
+  }
+  keys += other.keys;
+  doc_ids += other.doc_ids;
+  MergeHistogram(depth_histogram, other.depth_histogram);
+  MergeHistogram(key_length_histogram, other.key_length_histogram);
+  MergeHistogram(prefix_length_histogram, other.prefix_length_histogram);
+}
+
+//! The non empty buckets as value:count
+static std::string HistogramString(const std::vector<idx_t> &histogram) {
+  std::string result;
+  for (idx_t i = 0; i < histogram.size(); i++) {
+    if (histogram[i] > 0) {
+      result += fmt::format(" {}:{}", i, histogram[i]);
+    }
+  }
+  return result;
+}
+
+static std::string SubtreesString(const std::vector<SubtreeShape> &subtrees) {
+  std::string result;
+  for (auto &subtree : subtrees) {
+    std::string key;
+    for (auto byte : subtree.key_prefix) {
+      key += fmt::format("{:02x}", byte);
+    }
+    result += fmt::format("\n  [{}] nodes: {}, keys: {}, doc ids: {}", key, subtree.nodes, subtree.keys,
+                          subtree.doc_ids);
+  }
+  return result;
+}
+
+std::string TreeShape::ToString() const {
+  std::string result = fmt::format("nodes: {}, keys: {}, doc ids: {}\n", NodeCount(), keys, doc_ids);
+  for (idx_t i = 1; i < NTYPE_COUNT; i++) {
+    if (node_counts[i] > 0) {
+      result += fmt::format("  {}: {}\n", TypeName(i), node_counts[i]);
+    }
+  }
+  result += fmt::format("depth:{}\n", HistogramString(depth_histogram));
+  result += fmt::format("key length:{}\n", HistogramString(key_length_histogram));
+  result += fmt::format("prefix length:{}\n", HistogramString(prefix_length_histogram));
+  for (idx_t i = 0; i < NTYPE_COUNT; i++) {
+    if (!fanout_histograms[i].empty()) {
+      result += fmt::format("fanout {}:{}\n", TypeName(i), HistogramString(fanout_histograms[i]));
+    }
+  }
+  for (auto type : {NType::NODE_4, NType::NODE_16, NType::NODE_48, NType::NODE_256}) {
+    auto index = static_cast<idx_t>(type);
+    if (node_counts[index] > 0) {
+      result += fmt::format("near thresholds {}: grow {}, shrink {}\n", TypeName(index), near_grow[index],
+                            near_shrink[index]);
+    }
+  }
+  result += fmt::format("largest subtrees by nodes:{}\n", SubtreesString(largest_by_nodes));
+  result += fmt::format("largest subtrees by doc ids:{}\n", SubtreesString(largest_by_doc_ids));
+  return result;
+}
+
+}  // namespace part
@@ -0,0 +1,204 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <random>
+
+#include "art.h"
+#include "art_iterator.h"
+#include "art_stream.h"
+
+using namespace part;
+
+static void RemoveIndex(const std::string &index_path) {
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+}
+
+TEST(ARTStreamTest, WriterRoundTrip) {
+  std::string index_path = "art_stream_writer.idx";
+  RemoveIndex(index_path);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  // dense and sparse key ranges, so every node type and long prefixes are written
+  std::vector<int64_t> keys;
+  for (int64_t i = 0; i < 5000; i++) {
+    keys.push_back(i);
+  }
+  for (int64_t i = 1; i < 200; i++) {
+    keys.push_back(i * 1000003);
+    keys.push_back(i << 40);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  {
+    ARTStreamWriter writer(index_path);
+    for (auto key : keys) {
+      std::vector<idx_t> doc_ids;
+      for (idx_t j = 0; j <= key % 3; j++) {
+        doc_ids.push_back(key * 3 + j);
+      }
+      writer.Append(ARTKey::CreateARTKey<int64_t>(arena_allocator, key), doc_ids);
+    }
+    writer.Finish();
+    EXPECT_EQ(keys.size(), writer.KeyCount());
+  }
+
+  ART art(index_path);
+  ASSERT_TRUE(art.HasFilter());
+  for (auto key : keys) {
+    std::vector<idx_t> result_ids;
+    ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, key), result_ids));
+    std::vector<idx_t> expected;
+    for (idx_t j = 0; j <= key % 3; j++) {
+      expected.push_back(key * 3 + j);
+    }
+    std::sort(result_ids.begin(), result_ids.end());
+    ASSERT_EQ(expected, result_ids);
+  }
+  std::vector<idx_t> result_ids;
+  EXPECT_FALSE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, -1), result_ids));
+
+  RemoveIndex(index_path);
+}
+
+TEST(ARTStreamTest, ReaderMatchesIterator) {
+  std::string index_path = "art_stream_reader.idx";
+  RemoveIndex(index_path);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<int64_t> dist(0, 1 << 20);
+  {
+    ART art(index_path);
+    for (idx_t i = 0; i < 20000; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, dist(gen)), i);
+    }
+    art.Serialize();
+  }
+
+  ART art(index_path);
+  ARTIterator it(art);
+  ARTStreamReader reader(index_path);
+  bool valid = it.SeekToFirst();
+  ASSERT_EQ(valid, reader.SeekToFirst());
+  idx_t count = 0;
+  while (valid) {
+    ASSERT_TRUE(reader.Valid());
+    ASSERT_TRUE(it.Key() == reader.Key());
+    std::vector<idx_t> expected;
+    it.GetDocIds(expected);
+    auto doc_ids = reader.DocIds();
+    std::sort(expected.begin(), expected.end());
+    std::sort(doc_ids.begin(), doc_ids.end());
+    ASSERT_EQ(expected, doc_ids);
+    count++;
+    valid = it.Next();
+    ASSERT_EQ(valid, reader.Next());
+  }
+  EXPECT_GT(count, 0);
+
+  RemoveIndex(index_path);
+}
+
+TEST(ARTStreamTest, MergeFiles) {
+  std::vector<std::string> input_paths = {"art_stream_merge_0.idx", "art_stream_merge_1.idx"};
+  std::string output_path = "art_stream_merge_out.idx";
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  std::map<std::string, std::vector<idx_t>> expected;
+  for (idx_t input = 0; input < input_paths.size(); input++) {
+    RemoveIndex(input_paths[input]);
+    ART art(input_paths[input]);
+    // the inputs overlap on the keys divisible by 3
+    for (idx_t i = input * 1000; i < input * 1000 + 2000; i++) {
+      auto key = fmt::format("key_{}", i % 3 == 0 ? i / 3 : i);
+      idx_t doc_id = input * 10000 + i;
+      art.Put(ARTKey::CreateARTKey<std::string_view>(arena_allocator, key), doc_id);
+      expected[key].push_back(doc_id);
+    }
+    art.Serialize();
+  }
+  RemoveIndex(output_path);
+
+  EXPECT_EQ(expected.size(), ARTStreamWriter::MergeFiles(input_paths, output_path));
+  ART merged(output_path);
+  ASSERT_TRUE(merged.HasFilter());
+  for (auto &[key, doc_ids] : expected) {
+    std::vector<idx_t> result_ids;
+    ASSERT_TRUE(merged.Get(ARTKey::CreateARTKey<std::string_view>(arena_allocator, key), result_ids));
+    std::sort(result_ids.begin(), result_ids.end());
+    ASSERT_EQ(doc_ids, result_ids);
+  }
+  std::vector<idx_t> result_ids;
+  EXPECT_FALSE(merged.Get(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "missing"), result_ids));
+
+  EXPECT_THROW(ARTStreamWriter::MergeFiles(input_paths, input_paths[0]), std::invalid_argument);
+
+  for (auto &path : input_paths) {
+    RemoveIndex(path);
+  }
+  RemoveIndex(output_path);
+}
+
+TEST(ARTStreamTest, MergeFilesDuplicateDocIds) {
+  std::vector<std::string> input_paths = {"art_stream_dup_0.idx", "art_stream_dup_1.idx"};
+  std::string output_path = "art_stream_dup_out.idx";
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+
+  // both inputs hold the same dense doc ids, which are bitmap encoded on their own
+  idx_t limit = 70000;
+  for (auto &input_path : input_paths) {
+    RemoveIndex(input_path);
+    ART art(input_path);
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(key, i);
+    }
+    art.Serialize();
+  }
+  RemoveIndex(output_path);
+
+  EXPECT_EQ(1, ARTStreamWriter::MergeFiles(input_paths, output_path));
+  ART merged(output_path);
+  EXPECT_EQ(2 * limit, merged.Count(key));
+  std::vector<idx_t> result_ids;
+  ASSERT_TRUE(merged.Get(key, result_ids));
+  ASSERT_EQ(2 * limit, result_ids.size());
+  for (idx_t i = 0; i < result_ids.size(); i++) {
+    ASSERT_EQ(i / 2, result_ids[i]);
+  }
+
+  for (auto &path : input_paths) {
+    RemoveIndex(path);
+  }
+  RemoveIndex(output_path);
+}
+
+TEST(ARTStreamTest, InvalidAppend) {
+  std::string index_path = "art_stream_invalid.idx";
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  {
+    ARTStreamWriter writer(index_path);
+    writer.Append(ARTKey::CreateARTKey<int64_t>(arena_allocator, 2), {1});
+    EXPECT_THROW(writer.Append(ARTKey::CreateARTKey<int64_t>(arena_allocator, 1), {2}), std::invalid_argument);
+    EXPECT_THROW(writer.Append(ARTKey::CreateARTKey<int64_t>(arena_allocator, 2), {2}), std::invalid_argument);
+    EXPECT_THROW(writer.Append(ARTKey::CreateARTKey<int64_t>(arena_allocator, 3), {}), std::invalid_argument);
+    writer.Finish();
+  }
+
+  // an empty writer leaves an index without a root
+  {
+    ARTStreamWriter writer(index_path);
+    writer.Finish();
+  }
+  ARTStreamReader reader(index_path);
+  EXPECT_FALSE(reader.SeekToFirst());
+  RemoveIndex(index_path);
+}
@@ -4,10 +4,17 @@
 #include <fmt/core.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <filesystem>
+#include <map>
 #include <memory>
+#include <random>
+#include <set>
 #include <type_traits>
 
 #include "art.h"
+#include "art_iterator.h"
+#include "fixed_key_art.h"
 #include "leaf.h"
 #include "node.h"
 #include "node16.h"
@@ -191,6 +198,8 @@ TEST(ARTTest, MergeTest) {
   allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
 
   ART left(allocators);
   ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
@@ -227,6 +236,8 @@ TEST(ARTTest, MergeMediumTest) {
   allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
 
   ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
   Random random;
@@ -298,6 +309,8 @@ TEST(ARTTest, MergeFixture) {
   allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
 
   ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
   uint8_t data[10][8] = {
@@ -369,6 +382,8 @@ TEST(ARTTest, SerializedMergeTest) {
   allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
   allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
 
   auto kv_pairs = random.GenKvPairs(10000, arena_allocator);
 
@@ -485,6 +500,1049 @@ TEST(ARTTest, LongPrefixTest) {
   art.Draw("long_prefix.dot");
 }
 
+TEST(FixedKeyARTTest, Basic) {
+  FixedKeyART<int64_t> art;
+
+  std::vector<int64_t> keys = {0, 1, -1, 255, 256, -256, std::numeric_limits<int64_t>::min(),
+                               std::numeric_limits<int64_t>::max()};
+  for (idx_t i = 0; i < keys.size(); i++) {
+    art.Put(keys[i], i);
+  }
+  art.Put(keys[0], 100);
+
+  for (idx_t i = 0; i < keys.size(); i++) {
+    std::vector<idx_t> results;
+    EXPECT_TRUE(art.Get(keys[i], results));
+    EXPECT_EQ(results[0], i);
+  }
+
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Get(keys[0], results));
+  EXPECT_EQ(2, results.size());
+  EXPECT_EQ(100, results[1]);
+
+  results.clear();
+  EXPECT_FALSE(art.Get(2, results));
+
+  art.Delete(keys[1], 1);
+  EXPECT_FALSE(art.Get(keys[1], results));
+}
+
+TEST(FixedKeyARTTest, SameLayoutAsGenericKeys) {
+  FixedKeyART<int32_t> art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  ART &generic = art;
+  for (int32_t i = -5000; i < 5000; i++) {
+    generic.Put(ARTKey::CreateARTKey<int32_t>(arena_allocator, i), i + 5000);
+  }
+
+  for (int32_t i = -5000; i < 5000; i++) {
+    std::vector<idx_t> results;
+    EXPECT_TRUE(art.Get(i, results));
+    EXPECT_EQ(1, results.size());
+    EXPECT_EQ(i + 5000, results[0]);
+  }
+
+  // keys longer than KEY_LEN are never found by the fixed width lookup
+  generic.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, (int64_t(8192) << 32) + 7), 1);
+  std::vector<idx_t> results;
+  EXPECT_FALSE(art.Get(8192, results));
+}
+
+TEST(FixedKeyARTTest, RandomUInt64) {
+  FixedKeyART<uint64_t> art;
+  Random random;
+
+  std::vector<uint64_t> keys;
+  for (idx_t i = 0; i < 10000; i++) {
+    keys.push_back(random.NextLong() * 2);
+    art.Put(keys.back(), i);
+  }
+
+  for (idx_t i = 0; i < keys.size(); i++) {
+    std::vector<idx_t> results;
+    EXPECT_TRUE(art.Get(keys[i], results));
+    EXPECT_EQ(i, results.back());
+  }
+}
+
+TEST(ARTTest, LargePostingListTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 42);
+
+  std::vector<idx_t> doc_ids;
+  for (idx_t i = 0; i < 10000; i++) {
+    doc_ids.push_back(i * 3);
+  }
+  std::mt19937_64 gen(7);
+  std::shuffle(doc_ids.begin(), doc_ids.end(), gen);
+  for (auto doc_id : doc_ids) {
+    art.Put(key, doc_id);
+  }
+  std::sort(doc_ids.begin(), doc_ids.end());
+
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Get(key, results));
+  EXPECT_EQ(doc_ids, results);
+  // a chain of 4 doc ids per leaf would need 2500 leaves
+  EXPECT_LT(art.LeafCount(), 200);
+
+  for (idx_t i = 0; i < doc_ids.size(); i += 2) {
+    art.Delete(key, doc_ids[i]);
+  }
+  results.clear();
+  EXPECT_TRUE(art.Get(key, results));
+  ASSERT_EQ(doc_ids.size() / 2, results.size());
+  for (idx_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(doc_ids[i * 2 + 1], results[i]);
+  }
+
+  for (idx_t i = 1; i < doc_ids.size() - 2; i += 2) {
+    art.Delete(key, doc_ids[i]);
+  }
+  results.clear();
+  EXPECT_TRUE(art.Get(key, results));
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(doc_ids.back(), results[0]);
+}
+
+TEST(ARTTest, MergeLargePostingListTest) {
+  auto allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
+  allocators->emplace_back(sizeof(Prefix), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Leaf), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node4), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
+
+  ART left(allocators);
+  ART right(allocators);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto k1 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 10);
+  auto k2 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 11);
+
+  std::vector<idx_t> k1_ids;
+  std::vector<idx_t> k2_ids;
+  for (idx_t i = 0; i < 2000; i++) {
+    auto &art = i % 2 ? left : right;
+    art.Put(k1, i);
+    k1_ids.push_back(i);
+  }
+  for (idx_t i = 0; i < 3; i++) {
+    right.Put(k2, i + 1000000);
+    k2_ids.push_back(i + 1000000);
+  }
+  left.Put(k2, 7);
+  k2_ids.push_back(7);
+
+  left.Merge(right);
+
+  std::vector<idx_t> results;
+  EXPECT_TRUE(left.Get(k1, results));
+  EXPECT_EQ(k1_ids, results);
+
+  results.clear();
+  EXPECT_TRUE(left.Get(k2, results));
+  EXPECT_EQ(k2_ids, results);
+}
+
+TEST(ARTTest, DensePostingListTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+
+  idx_t limit = 200000;
+  for (idx_t i = 0; i < limit; i++) {
+    art.Put(key, i);
+  }
+  // one leaf plus a bitmap container for every 65536 doc ids
+  EXPECT_EQ(5, art.LeafCount());
+
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Get(key, results));
+  ASSERT_EQ(limit, results.size());
+  for (idx_t i = 0; i < limit; i++) {
+    ASSERT_EQ(i, results[i]);
+  }
+
+  // thin the list out until segments are smaller again
+  for (idx_t i = 0; i < limit; i++) {
+    if (i % 1000 != 0) {
+      art.Delete(key, i);
+    }
+  }
+  EXPECT_LT(art.LeafCount(), 5);
+
+  results.clear();
+  EXPECT_TRUE(art.Get(key, results));
+  ASSERT_EQ(limit / 1000, results.size());
+  for (idx_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(i * 1000, results[i]);
+  }
+}
+
+TEST(ARTTest, MergeDensePostingListTest) {
+  auto allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
+  allocators->emplace_back(sizeof(Prefix), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Leaf), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node4), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
+
+  ART left(allocators);
+  ART right(allocators);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+
+  idx_t limit = 300000;
+  for (idx_t i = 0; i < limit; i++) {
+    // the right side only covers the upper half, so some of its containers are relinked
+    if (i % 2 == 0) {
+      left.Put(key, i);
+    } else if (i > limit / 2) {
+      right.Put(key, i);
+    }
+  }
+
+  left.Merge(right);
+
+  std::vector<idx_t> results;
+  EXPECT_TRUE(left.Get(key, results));
+  std::vector<idx_t> expected;
+  for (idx_t i = 0; i < limit; i++) {
+    if (i % 2 == 0 || i > limit / 2) {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(expected, results);
+}
+
+TEST(ARTTest, DuplicateDocIdTest) {
+  std::string index_path = "art_duplicate_doc_id.index";
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  // a plain, a segmented and a bitmap leaf, every one of them gets a doc id twice
+  std::vector<idx_t> limits = {3, 100, 70000};
+  std::vector<std::vector<idx_t>> expected(limits.size());
+  {
+    ART art(index_path);
+    for (idx_t k = 0; k < limits.size(); k++) {
+      auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, k);
+      for (idx_t i = 0; i < limits[k]; i++) {
+        art.Put(key, i);
+        expected[k].push_back(i);
+      }
+      art.Put(key, 1);
+      expected[k].insert(expected[k].begin() + 2, 1);
+      EXPECT_EQ(limits[k] + 1, art.Count(key));
+
+      std::vector<idx_t> results;
+      EXPECT_TRUE(art.Get(key, results));
+      std::sort(results.begin(), results.end());
+      EXPECT_EQ(expected[k], results);
+    }
+    art.Serialize();
+  }
+
+  {
+    ART art(index_path);
+    for (idx_t k = 0; k < limits.size(); k++) {
+      auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, k);
+      std::vector<idx_t> results;
+      EXPECT_TRUE(art.Get(key, results));
+      std::sort(results.begin(), results.end());
+      EXPECT_EQ(expected[k], results);
+
+      // removing a duplicate keeps the other copy
+      art.Delete(key, 1);
+      results.clear();
+      EXPECT_TRUE(art.Get(key, results));
+      std::sort(results.begin(), results.end());
+      EXPECT_EQ(limits[k], results.size());
+      EXPECT_EQ(1, std::count(results.begin(), results.end(), 1));
+    }
+  }
+
+  // merging leaves that share doc ids keeps both copies, even for two bitmap leaves
+  auto allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
+  allocators->emplace_back(sizeof(Prefix), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Leaf), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node4), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
+  ART left(allocators);
+  ART right(allocators);
+  for (idx_t k = 0; k < limits.size(); k++) {
+    auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, k);
+    for (idx_t i = 0; i < limits[k]; i++) {
+      left.Put(key, i);
+      right.Put(key, i);
+    }
+  }
+  left.Merge(right);
+  for (idx_t k = 0; k < limits.size(); k++) {
+    auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, k);
+    EXPECT_EQ(2 * limits[k], left.Count(key));
+    std::vector<idx_t> results;
+    EXPECT_TRUE(left.Get(key, results));
+    std::sort(results.begin(), results.end());
+    for (idx_t i = 0; i < results.size(); i++) {
+      ASSERT_EQ(i / 2, results[i]);
+    }
+  }
+
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+}
+
+TEST(ARTTest, PostingListIntersectTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::vector<ARTKey> keys;
+  for (int64_t i = 0; i < 6; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int64_t>(arena_allocator, i));
+  }
+
+  std::vector<std::vector<idx_t>> lists(keys.size());
+  // segmented leaves
+  for (idx_t i = 0; i < 20000; i += 2) {
+    lists[0].push_back(i);
+  }
+  for (idx_t i = 0; i < 30000; i += 3) {
+    lists[1].push_back(i);
+  }
+  // a plain leaf in insertion order
+  lists[2] = {600, 6, 7, 12};
+  // bitmap leaves
+  for (idx_t i = 0; i < 150000; i++) {
+    lists[3].push_back(i);
+  }
+  for (idx_t i = 100000; i < 250000; i++) {
+    lists[4].push_back(i);
+  }
+  for (idx_t i = 0; i < lists.size(); i++) {
+    for (auto doc_id : lists[i]) {
+      art.Put(keys[i], doc_id);
+    }
+    std::sort(lists[i].begin(), lists[i].end());
+  }
+
+  auto expected = [&](const std::vector<idx_t> &indexes) {
+    auto result = lists[indexes[0]];
+    for (idx_t i = 1; i < indexes.size(); i++) {
+      std::vector<idx_t> next;
+      std::set_intersection(result.begin(), result.end(), lists[indexes[i]].begin(), lists[indexes[i]].end(),
+                            std::back_inserter(next));
+      result = next;
+    }
+    return result;
+  };
+
+  for (auto &indexes : std::vector<std::vector<idx_t>>{{0, 1}, {1, 0, 2}, {0, 3}, {3, 4}, {0, 3, 4}, {4}}) {
+    std::vector<ARTKey> query;
+    for (auto i : indexes) {
+      query.push_back(keys[i]);
+    }
+    std::vector<idx_t> results;
+    EXPECT_TRUE(art.Intersect(query, results));
+    EXPECT_EQ(expected(indexes), results);
+  }
+
+  // early termination
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Intersect({keys[3], keys[4]}, results, 10));
+  ASSERT_EQ(10, results.size());
+  EXPECT_EQ(100000, results[0]);
+  EXPECT_EQ(100009, results[9]);
+
+  results.clear();
+  EXPECT_TRUE(art.Intersect({keys[0], keys[1]}, results, 3));
+  EXPECT_EQ(std::vector<idx_t>({0, 6, 12}), results);
+
+  // a missing key makes the intersection empty
+  results.clear();
+  EXPECT_FALSE(art.Intersect({keys[0], keys[5]}, results));
+  EXPECT_TRUE(results.empty());
+}
+
+TEST(ARTTest, PostingListUnionTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key1 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+  auto key2 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 2);
+  auto key3 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 3);
+  auto missing = ARTKey::CreateARTKey<int64_t>(arena_allocator, 4);
+
+  std::set<idx_t> expected;
+  for (idx_t i = 0; i < 10000; i += 5) {
+    art.Put(key1, i);
+    expected.insert(i);
+  }
+  for (idx_t i = 0; i < 100000; i++) {
+    art.Put(key2, 50000 + i);
+    expected.insert(50000 + i);
+  }
+  for (idx_t doc_id : {7, 3, 10, 200000}) {
+    art.Put(key3, doc_id);
+    expected.insert(doc_id);
+  }
+
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Union({key1, key2, key3, missing}, results));
+  EXPECT_EQ(std::vector<idx_t>(expected.begin(), expected.end()), results);
+
+  results.clear();
+  EXPECT_TRUE(art.Union({key3, key1}, results, 4));
+  EXPECT_EQ(std::vector<idx_t>({0, 3, 5, 7}), results);
+
+  results.clear();
+  EXPECT_FALSE(art.Union({missing}, results));
+  EXPECT_TRUE(results.empty());
+}
+
+TEST(ARTTest, LeafViewTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto inlined_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+  auto plain_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 2);
+  auto segmented_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 3);
+  auto bitmap_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 4);
+  auto missing_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 5);
+
+  art.Put(inlined_key, 7);
+  for (idx_t doc_id : {30, 10, 20}) {
+    art.Put(plain_key, doc_id);
+  }
+  for (idx_t i = 0; i < 5000; i++) {
+    art.Put(segmented_key, 5000 - i);
+  }
+  for (idx_t i = 0; i < 100000; i++) {
+    art.Put(bitmap_key, 1000 + i);
+  }
+
+  idx_t doc_id = 0;
+  EXPECT_TRUE(art.GetFirst(inlined_key, doc_id));
+  EXPECT_EQ(7, doc_id);
+  EXPECT_TRUE(art.GetFirst(plain_key, doc_id));
+  EXPECT_EQ(30, doc_id);
+  EXPECT_TRUE(art.GetFirst(segmented_key, doc_id));
+  EXPECT_EQ(1, doc_id);
+  EXPECT_TRUE(art.GetFirst(bitmap_key, doc_id));
+  EXPECT_EQ(1000, doc_id);
+  EXPECT_FALSE(art.GetFirst(missing_key, doc_id));
+
+  EXPECT_EQ(1, art.Count(inlined_key));
+  EXPECT_EQ(3, art.Count(plain_key));
+  EXPECT_EQ(5000, art.Count(segmented_key));
+  EXPECT_EQ(100000, art.Count(bitmap_key));
+  EXPECT_EQ(0, art.Count(missing_key));
+
+  for (auto &key : {inlined_key, plain_key, segmented_key, bitmap_key}) {
+    EXPECT_TRUE(art.Contains(key));
+
+    std::vector<idx_t> expected;
+    EXPECT_TRUE(art.Get(key, expected));
+    std::vector<idx_t> visited;
+    EXPECT_TRUE(art.ForEachDocId(key, [&](idx_t doc_id) { visited.push_back(doc_id); }));
+    EXPECT_EQ(expected, visited);
+  }
+  EXPECT_FALSE(art.Contains(missing_key));
+  EXPECT_FALSE(art.ForEachDocId(missing_key, [](idx_t) { FAIL(); }));
+}
+
+TEST(ARTTest, UniqueIndexTest) {
+  ART art(nullptr, IndexConstraintType::UNIQUE);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  int64_t limit = 10000;
+  for (int64_t i = 0; i < limit; i++) {
+    art.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i * 2);
+  }
+  // every value lives in an inlined leaf
+  EXPECT_EQ(0, Node::GetAllocator(art, NType::LEAF).total_allocations);
+
+  for (int64_t i = 0; i < limit; i++) {
+    idx_t doc_id;
+    ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), doc_id));
+    ASSERT_EQ(i * 2, doc_id);
+  }
+  idx_t doc_id = 0;
+  EXPECT_FALSE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, limit), doc_id));
+
+  auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 42);
+  EXPECT_THROW(art.Insert(key, 1), std::invalid_argument);
+  EXPECT_THROW(art.Put(key, 1), std::invalid_argument);
+  EXPECT_FALSE(art.InsertIfAbsent(key, 1));
+  EXPECT_TRUE(art.Get(key, doc_id));
+  EXPECT_EQ(84, doc_id);
+
+  art.Upsert(key, 1);
+  EXPECT_TRUE(art.Get(key, doc_id));
+  EXPECT_EQ(1, doc_id);
+
+  auto new_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, limit);
+  EXPECT_TRUE(art.InsertIfAbsent(new_key, 3));
+  art.Upsert(ARTKey::CreateARTKey<int64_t>(arena_allocator, limit + 1), 4);
+  EXPECT_TRUE(art.Get(new_key, doc_id));
+  EXPECT_EQ(3, doc_id);
+  EXPECT_EQ(0, Node::GetAllocator(art, NType::LEAF).total_allocations);
+
+  // the vector based read path still works
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Get(new_key, results));
+  EXPECT_EQ(std::vector<idx_t>({3}), results);
+
+  EXPECT_THROW(art.Insert(key, idx_t(1) << 60), std::invalid_argument);
+
+  ART non_unique;
+  non_unique.Put(key, 1);
+  EXPECT_THROW(non_unique.Get(key, doc_id), std::invalid_argument);
+  EXPECT_THROW(non_unique.Insert(key, 1), std::invalid_argument);
+}
+
+TEST(ARTTest, UniqueIndexMergeTest) {
+  auto allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
+  allocators->emplace_back(sizeof(Prefix), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Leaf), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node4), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
+
+  ART art1(allocators, IndexConstraintType::UNIQUE);
+  ART art2(allocators, IndexConstraintType::UNIQUE);
+  ART art3(allocators, IndexConstraintType::UNIQUE);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  for (int64_t i = 0; i < 1000; i++) {
+    art1.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2), i);
+    art2.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2 + 1), i);
+  }
+  for (int64_t i = 5000; i < 6000; i++) {
+    art3.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+  }
+  art3.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, 0), 7);
+
+  art1.Merge(art2);
+  for (int64_t i = 0; i < 2000; i++) {
+    idx_t doc_id;
+    ASSERT_TRUE(art1.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), doc_id));
+    ASSERT_EQ(i / 2, doc_id);
+  }
+
+  // a failed merge leaves both trees untouched
+  EXPECT_THROW(art1.Merge(art3), std::invalid_argument);
+  EXPECT_THROW(art1.Merge(art3, 4), std::invalid_argument);
+  for (int64_t i = 0; i < 6000; i++) {
+    idx_t doc_id;
+    auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, i);
+    ASSERT_EQ(i < 2000, art1.Get(key, doc_id));
+    ASSERT_EQ(i == 0 || i >= 5000, art3.Get(key, doc_id));
+  }
+
+  // the conflict is gone once the delta deletes the existing doc id
+  ART deletes(allocators);
+  deletes.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, 0), 0);
+  art1.Merge(art3, deletes);
+  idx_t doc_id;
+  EXPECT_TRUE(art1.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 0), doc_id));
+  EXPECT_EQ(7, doc_id);
+  EXPECT_TRUE(art1.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 5999), doc_id));
+  EXPECT_EQ(5999, doc_id);
+}
+
+TEST(ARTTest, ParallelMergeTest) {
+  auto allocators = std::make_shared<std::vector<FixedSizeAllocator>>();
+  allocators->emplace_back(sizeof(Prefix), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Leaf), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node4), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node16), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node48), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(Node256), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafSegment), Allocator::DefaultAllocator());
+  allocators->emplace_back(sizeof(LeafBitmap), Allocator::DefaultAllocator());
+
+  ART left(allocators);
+  ART right(allocators);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  // overlapping random keys, a dense range and long posting lists under a few keys
+  std::mt19937_64 gen(7);
+  std::uniform_int_distribution<int64_t> dist(0, 1 << 24);
+  std::map<int64_t, std::vector<idx_t>> expected;
+  idx_t doc_id = 0;
+  for (idx_t i = 0; i < 50000; i++) {
+    auto key = i % 5 == 0 ? int64_t(i % 100) : dist(gen);
+    auto &art = i % 2 == 0 ? left : right;
+    art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, key), doc_id);
+    expected[key].push_back(doc_id++);
+  }
+
+  left.Merge(right, 4);
+  EXPECT_FALSE(right.root->IsSet());
+  for (auto &[key, doc_ids] : expected) {
+    std::vector<idx_t> results;
+    ASSERT_TRUE(left.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, key), results));
+    std::sort(results.begin(), results.end());
+    ASSERT_EQ(doc_ids, results);
+  }
+
+  // errors of the worker threads reach the caller
+  ART unique1(allocators, IndexConstraintType::UNIQUE);
+  ART unique2(allocators, IndexConstraintType::UNIQUE);
+  for (int64_t i = 0; i < 1000; i++) {
+    unique1.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 3), i);
+    unique2.Insert(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 5), i);
+  }
+  EXPECT_THROW(unique1.Merge(unique2, 4), std::invalid_argument);
+}
+
+TEST(ARTTest, MergeWithDeletesTest) {
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  ART base;
+  ART adds(base.allocators);
+  ART deletes;
+
+  idx_t limit = 2000;
+  for (int64_t i = 0; i < limit; i++) {
+    base.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+    base.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i + limit);
+  }
+  auto none_leaf_count = base.NoneLeafCount();
+  for (int64_t i = 0; i < limit; i++) {
+    auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, i);
+    if (i < limit / 2) {
+      // the first half loses both doc ids, its leaves and most inner nodes go away
+      deletes.Put(key, i);
+      deletes.Put(key, i + limit);
+    } else if (i % 2 == 0) {
+      // deleted and added again within the same delta
+      deletes.Put(key, i);
+      adds.Put(key, i);
+    } else {
+      deletes.Put(key, i + limit);
+      adds.Put(key, i + 2 * limit);
+    }
+  }
+  // a key only the tombstones know about is ignored
+  deletes.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, -1), 1);
+
+  base.Merge(adds, deletes);
+  for (int64_t i = 0; i < limit; i++) {
+    std::vector<idx_t> results;
+    auto found = base.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), results);
+    std::sort(results.begin(), results.end());
+    if (i < limit / 2) {
+      ASSERT_FALSE(found);
+    } else if (i % 2 == 0) {
+      ASSERT_EQ(std::vector<idx_t>({idx_t(i), idx_t(i + limit)}), results);
+    } else {
+      ASSERT_EQ(std::vector<idx_t>({idx_t(i), idx_t(i + 2 * limit)}), results);
+    }
+  }
+  ARTIterator it(base);
+  idx_t key_count = 0;
+  for (bool valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    key_count++;
+  }
+  EXPECT_EQ(limit / 2, key_count);
+  EXPECT_LT(base.NoneLeafCount(), none_leaf_count);
+}
+
+TEST(ARTTest, ApplyDeletesLargeLeafTest) {
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto segmented_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+  auto bitmap_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 2);
+  auto plain_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 3);
+
+  for (idx_t round = 0; round < 3; round++) {
+    SCOPED_TRACE(round);
+    ART base;
+    ART deletes;
+    std::mt19937_64 gen(round);
+    std::multiset<idx_t> segmented_ids;
+    std::multiset<idx_t> bitmap_ids;
+    for (idx_t i = 0; i < 20000; i++) {
+      base.Put(segmented_key, i * 13);
+      segmented_ids.insert(i * 13);
+    }
+    // a duplicate keeps the leaf in segments, its tombstone removes one copy
+    base.Put(segmented_key, 26);
+    segmented_ids.insert(26);
+    for (idx_t i = 0; i < 100000; i++) {
+      base.Put(bitmap_key, i);
+      bitmap_ids.insert(i);
+    }
+    for (idx_t i = 0; i < 3; i++) {
+      base.Put(plain_key, i);
+    }
+
+    // the last round deletes everything
+    for (idx_t i = 0; i < 30000; i++) {
+      auto doc_id = round == 2 ? i * 13 : gen() % 300000;
+      deletes.Put(segmented_key, doc_id);
+      if (segmented_ids.count(doc_id)) {
+        segmented_ids.erase(segmented_ids.find(doc_id));
+      }
+    }
+    for (idx_t i = 0; i < 120000; i++) {
+      auto doc_id = round == 2 ? i : gen() % 120000;
+      deletes.Put(bitmap_key, doc_id);
+      bitmap_ids.erase(doc_id);
+    }
+    if (round == 2) {
+      deletes.Put(segmented_key, 26);
+      segmented_ids.clear();
+    }
+    deletes.Put(plain_key, 1);
+    deletes.Put(plain_key, 7);
+
+    base.ApplyDeletes(deletes);
+    std::vector<idx_t> results;
+    EXPECT_EQ(!segmented_ids.empty(), base.Get(segmented_key, results));
+    EXPECT_EQ(std::vector<idx_t>(segmented_ids.begin(), segmented_ids.end()), results);
+    EXPECT_EQ(segmented_ids.size(), base.Count(segmented_key));
+    results.clear();
+    EXPECT_EQ(!bitmap_ids.empty(), base.Get(bitmap_key, results));
+    EXPECT_EQ(std::vector<idx_t>(bitmap_ids.begin(), bitmap_ids.end()), results);
+    EXPECT_EQ(bitmap_ids.size(), base.Count(bitmap_key));
+    results.clear();
+    EXPECT_TRUE(base.Get(plain_key, results));
+    EXPECT_EQ(std::vector<idx_t>({0, 2}), results);
+  }
+}
+
+TEST(ARTTest, DeleteRangeTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  int64_t limit = 100000;
+  for (int64_t i = -limit; i < limit; i++) {
+    auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, i);
+    art.Put(key, i + limit);
+    if (i % 3 == 0) {
+      art.Put(key, i + 3 * limit);
+    }
+  }
+  auto memory_usage = art.GetMemoryUsage();
+
+  art.DeleteRange(ARTKey::CreateARTKey<int64_t>(arena_allocator, -777),
+                  ARTKey::CreateARTKey<int64_t>(arena_allocator, 54321));
+  art.DeleteRange(ARTKey::CreateARTKey<int64_t>(arena_allocator, 70000),
+                  ARTKey::CreateARTKey<int64_t>(arena_allocator, 70000));
+  // bounds which are not in the tree
+  art.DeleteRange(ARTKey::CreateARTKey<int64_t>(arena_allocator, 90000),
+                  ARTKey::CreateARTKey<int64_t>(arena_allocator, 2 * limit));
+
+  for (int64_t i = -limit; i < limit; i++) {
+    auto key = ARTKey::CreateARTKey<int64_t>(arena_allocator, i);
+    auto deleted = (i >= -777 && i <= 54321) || i == 70000 || i >= 90000;
+    ASSERT_EQ(!deleted, art.Contains(key)) << i;
+    if (!deleted) {
+      ASSERT_EQ(i % 3 == 0 ? 2 : 1, art.Count(key)) << i;
+    }
+  }
+
+  EXPECT_THROW(art.DeleteRange(ARTKey::CreateARTKey<int64_t>(arena_allocator, 2),
+                               ARTKey::CreateARTKey<int64_t>(arena_allocator, 1)),
+               std::invalid_argument);
+
+  art.DeleteRange(ARTKey::CreateARTKey<int64_t>(arena_allocator, std::numeric_limits<int64_t>::min()),
+                  ARTKey::CreateARTKey<int64_t>(arena_allocator, std::numeric_limits<int64_t>::max()));
+  EXPECT_FALSE(art.root->IsSet());
+  EXPECT_LT(art.GetMemoryUsage(), memory_usage);
+  EXPECT_EQ(0, art.GetMemoryUsage());
+}
+
+TEST(ARTTest, RandomDeleteRangeTest) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<uint32_t> dist(0, 1 << 20);
+
+  std::set<uint32_t> expected;
+  for (idx_t i = 0; i < 50000; i++) {
+    auto value = dist(rng);
+    art.Put(ARTKey::CreateARTKey<uint32_t>(arena_allocator, value), i);
+    expected.insert(value);
+  }
+
+  for (idx_t round = 0; round < 50; round++) {
+    auto lower = dist(rng);
+    auto upper = lower + dist(rng) % 20000;
+    art.DeleteRange(ARTKey::CreateARTKey<uint32_t>(arena_allocator, lower),
+                    ARTKey::CreateARTKey<uint32_t>(arena_allocator, upper));
+    expected.erase(expected.lower_bound(lower), expected.upper_bound(upper));
+  }
+
+  for (uint32_t value = 0; value <= (1 << 20); value++) {
+    ASSERT_EQ(expected.count(value) == 1, art.Contains(ARTKey::CreateARTKey<uint32_t>(arena_allocator, value)))
+        << value;
+  }
+}
+
+TEST(ARTIteratorTest, OrderedScan) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::mt19937_64 rng(7);
+  std::uniform_int_distribution<int64_t> dist(-1000000, 1000000);
+
+  std::set<int64_t> expected;
+  for (idx_t i = 0; i < 20000; i++) {
+    auto value = dist(rng);
+    art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, value), i);
+    expected.insert(value);
+  }
+
+  ARTIterator it(art);
+  auto expected_it = expected.begin();
+  for (auto valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    ASSERT_NE(expected_it, expected.end());
+    ASSERT_EQ(ARTKey::CreateARTKey<int64_t>(arena_allocator, *expected_it), it.Key());
+    expected_it++;
+  }
+  EXPECT_EQ(expected_it, expected.end());
+  EXPECT_FALSE(it.Valid());
+
+  for (idx_t round = 0; round < 1000; round++) {
+    auto lower = dist(rng);
+    auto expected_lower = expected.lower_bound(lower);
+    auto found = it.Seek(ARTKey::CreateARTKey<int64_t>(arena_allocator, lower));
+    ASSERT_EQ(expected_lower != expected.end(), found);
+    if (found) {
+      ASSERT_EQ(ARTKey::CreateARTKey<int64_t>(arena_allocator, *expected_lower), it.Key());
+      std::vector<idx_t> doc_ids;
+      EXPECT_TRUE(it.GetDocIds(doc_ids));
+      EXPECT_FALSE(doc_ids.empty());
+    }
+  }
+
+  ART empty;
+  ARTIterator empty_it(empty);
+  EXPECT_FALSE(empty_it.SeekToFirst());
+  EXPECT_FALSE(empty_it.Seek(ARTKey::CreateARTKey<int64_t>(arena_allocator, 1)));
+}
+
+TEST(ARTIteratorTest, StringKeys) {
+  ART art;
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::vector<std::string> keys = {"apple", "applesauce", "apricot", "banana", "band", "bandana", "can", "candy"};
+  for (idx_t i = 0; i < keys.size(); i++) {
+    art.Put(ARTKey::CreateARTKey<std::string_view>(arena_allocator, keys[i]), i);
+  }
+
+  ARTIterator it(art);
+  idx_t i = 0;
+  for (auto valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    ASSERT_EQ(ARTKey::CreateARTKey<std::string_view>(arena_allocator, keys[i]), it.Key());
+    i++;
+  }
+  EXPECT_EQ(keys.size(), i);
+
+  EXPECT_TRUE(it.Seek(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "b")));
+  EXPECT_EQ(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "banana"), it.Key());
+  EXPECT_TRUE(it.Seek(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "bandana")));
+  EXPECT_EQ(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "bandana"), it.Key());
+  EXPECT_TRUE(it.Seek(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "bane")));
+  EXPECT_EQ(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "can"), it.Key());
+  EXPECT_FALSE(it.Seek(ARTKey::CreateARTKey<std::string_view>(arena_allocator, "dog")));
+}
+
+//! The type of the node below the common prefix of the int64 keys in art
+static NType InnerType(ART& art) {
+  EXPECT_EQ(NType::PREFIX, art.root->GetType());
+  return Prefix::Get(art, *art.root).ptr.GetType();
+}
+
+TEST(ARTTest, ShrinkPolicyTest) {
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key = [&](int64_t i) { return ARTKey::CreateARTKey<int64_t>(arena_allocator, i); };
+  auto expect_keys = [&](ART& art, int64_t lower, int64_t upper, int64_t limit) {
+    for (int64_t i = 0; i < limit; i++) {
+      std::vector<idx_t> results;
+      ASSERT_EQ(i >= lower && i < upper, art.Get(key(i), results)) << i;
+    }
+  };
+  int64_t limit = 50;
+
+  {
+    ART art;
+    for (int64_t i = 0; i < limit; i++) {
+      art.Put(key(i), i);
+    }
+    EXPECT_EQ(NType::NODE_256, InnerType(art));
+    for (int64_t i = limit - 1; i >= 1; i--) {
+      art.Delete(key(i), i);
+    }
+    expect_keys(art, 0, 1, limit);
+    auto stats = art.GetTransitionStats();
+    EXPECT_EQ(1, stats.grow_node4);
+    EXPECT_EQ(1, stats.grow_node16);
+    EXPECT_EQ(1, stats.grow_node48);
+    EXPECT_EQ(1, stats.shrink_node256);
+    EXPECT_EQ(1, stats.shrink_node48);
+    EXPECT_EQ(1, stats.shrink_node16);
+
+    // a node churning between 11 and 17 children is copied on every turn
+    art.ResetTransitionStats();
+    for (int64_t round = 0; round < 10; round++) {
+      for (int64_t i = 1; i < 17; i++) {
+        art.Put(key(i), i);
+      }
+      for (int64_t i = 11; i < 17; i++) {
+        art.Delete(key(i), i);
+      }
+    }
+    EXPECT_EQ(10, art.GetTransitionStats().grow_node16);
+    EXPECT_EQ(10, art.GetTransitionStats().shrink_node48);
+  }
+
+  {
+    // with a wider gap it stays a node48
+    ART art;
+    art.SetShrinkPolicy({Node::NODE_4_CAPACITY, 4, Node::NODE_256_SHRINK_THRESHOLD});
+    for (int64_t round = 0; round < 10; round++) {
+      for (int64_t i = 0; i < 17; i++) {
+        art.Put(key(i), i);
+      }
+      for (int64_t i = 11; i < 17; i++) {
+        art.Delete(key(i), i);
+      }
+    }
+    EXPECT_EQ(NType::NODE_48, InnerType(art));
+    EXPECT_EQ(1, art.GetTransitionStats().grow_node16);
+    EXPECT_EQ(0, art.GetTransitionStats().shrink_node48);
+    expect_keys(art, 0, 11, limit);
+  }
+
+  {
+    ART art;
+    art.SetShrinkPolicy({Node::NODE_4_CAPACITY, Node::NODE_48_SHRINK_THRESHOLD, Node::NODE_256_SHRINK_THRESHOLD, true});
+    for (int64_t i = 0; i < limit; i++) {
+      art.Put(key(i), i);
+    }
+    for (int64_t i = 2; i < limit; i++) {
+      art.Delete(key(i), i);
+    }
+    EXPECT_EQ(NType::NODE_256, InnerType(art));
+    EXPECT_EQ(0, art.GetTransitionStats().shrink_node256);
+
+    EXPECT_EQ(3, art.Compact());
+    EXPECT_EQ(NType::NODE_4, InnerType(art));
+    EXPECT_EQ(0, art.Compact());
+    expect_keys(art, 0, 2, limit);
+
+    // a node256 left with one child is compressed into the prefix right away
+    for (int64_t i = 2; i < limit; i++) {
+      art.Put(key(i), i);
+    }
+    for (int64_t i = 1; i < limit; i++) {
+      art.Delete(key(i), i);
+    }
+    EXPECT_EQ(1, art.NoneLeafCount());
+    expect_keys(art, 0, 1, limit);
+  }
+
+  {
+    // with the lowest thresholds a node shrinks into a smaller one holding a single child
+    ART art;
+    art.SetShrinkPolicy({2, 2, 2});
+    for (int64_t i = 0; i < 5; i++) {
+      art.Put(key(i), i);
+    }
+    EXPECT_EQ(NType::NODE_16, InnerType(art));
+    for (int64_t i = 0; i < 5; i++) {
+      art.Delete(key(i), i);
+    }
+    expect_keys(art, 0, 0, limit);
+
+    for (int64_t i = 0; i < limit; i++) {
+      art.Put(key(i), i);
+    }
+    for (int64_t i = limit - 1; i >= 1; i--) {
+      art.Delete(key(i), i);
+    }
+    expect_keys(art, 0, 1, limit);
+    EXPECT_EQ(1, art.GetTransitionStats().shrink_node16);
+    art.Delete(key(0), 0);
+    expect_keys(art, 0, 0, limit);
+    art.Put(key(3), 3);
+    expect_keys(art, 3, 4, limit);
+  }
+
+  ART art;
+  EXPECT_THROW(art.SetShrinkPolicy({Node::NODE_4_CAPACITY + 2, 0, 0}), std::invalid_argument);
+  EXPECT_THROW(art.SetShrinkPolicy({0, 0, Node::NODE_48_CAPACITY + 2}), std::invalid_argument);
+}
+
+TEST(ARTTest, ChildBitmapTest) {
+  ChildBitmap bitmap;
+  bitmap.Reset();
+  EXPECT_EQ(0, bitmap.Count());
+  EXPECT_EQ(ChildBitmap::END, bitmap.First());
+  EXPECT_EQ(ChildBitmap::END, bitmap.Last());
+  for (idx_t byte : {0, 63, 64, 130, 255}) {
+    bitmap.Set(byte);
+  }
+  EXPECT_EQ(5, bitmap.Count());
+  EXPECT_EQ(0, bitmap.First());
+  EXPECT_EQ(255, bitmap.Last());
+  EXPECT_EQ(63, bitmap.Next(1));
+  EXPECT_EQ(64, bitmap.Next(64));
+  EXPECT_EQ(130, bitmap.Next(65));
+  EXPECT_EQ(ChildBitmap::END, bitmap.Next(ChildBitmap::END));
+  bitmap.Clear(255);
+  EXPECT_FALSE(bitmap.Test(255));
+  EXPECT_EQ(ChildBitmap::END, bitmap.Next(131));
+  EXPECT_EQ(130, bitmap.Last());
+
+  // the children of wide nodes are visited in order after deletes
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  auto key = [&](int64_t i) { return ARTKey::CreateARTKey<int64_t>(arena_allocator, i); };
+  for (int64_t limit : {40, 200}) {
+    ART art;
+    art.SetShrinkPolicy({Node::NODE_4_CAPACITY, Node::NODE_48_SHRINK_THRESHOLD, Node::NODE_256_SHRINK_THRESHOLD, true});
+    for (int64_t i = 0; i < limit; i++) {
+      art.Put(key(i), i);
+    }
+    for (int64_t i = 0; i < limit; i += 3) {
+      art.Delete(key(i), i);
+    }
+    EXPECT_EQ(limit == 40 ? NType::NODE_48 : NType::NODE_256, InnerType(art));
+
+    auto &inner = Prefix::Get(art, *art.root).ptr;
+    std::vector<idx_t> bytes;
+    uint8_t byte = 0;
+    for (auto child = inner.GetNextChild(art, byte); child; child = inner.GetNextChild(art, byte)) {
+      bytes.push_back(byte);
+      byte++;
+    }
+    std::vector<idx_t> expected;
+    for (int64_t i = 0; i < limit; i++) {
+      if (i % 3 != 0) {
+        expected.push_back(i);
+      }
+    }
+    EXPECT_EQ(expected, bytes);
+    EXPECT_EQ(expected.size(), inner.ChildCount(art));
+    EXPECT_EQ(2, art.NoneLeafCount());
+  }
+}
+
 TEST(ARTTest, SwapTest) {
   int a = 10;
   int b = 20;
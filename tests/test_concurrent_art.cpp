@@ -61,6 +61,99 @@ TEST(ConcurrentARTTest, LeafExpand) {
   }
 }
 
+TEST(ConcurrentARTTest, ContainsAndGetFirst) {
+  ConcurrentART art;
+
+  Allocator& allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+
+  ARTKey k1 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 10);
+  ARTKey k2 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 11);
+  ARTKey k3 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 12);
+
+  art.Put(k1, 1);
+  for (idx_t i = 0; i < 20; i++) {
+    art.Put(k2, 100 + i);
+  }
+
+  idx_t doc_id;
+  EXPECT_TRUE(art.Contains(k1));
+  EXPECT_TRUE(art.GetFirst(k1, doc_id));
+  EXPECT_EQ(1, doc_id);
+
+  EXPECT_TRUE(art.Contains(k2));
+  EXPECT_TRUE(art.GetFirst(k2, doc_id));
+  EXPECT_EQ(100, doc_id);
+
+  EXPECT_FALSE(art.Contains(k3));
+  EXPECT_FALSE(art.GetFirst(k3, doc_id));
+}
+
+TEST(ConcurrentARTTest, Upsert) {
+  ConcurrentART art;
+
+  Allocator& allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+
+  std::vector<ARTKey> keys;
+  for (idx_t i = 0; i < 100; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int64_t>(arena_allocator, i));
+  }
+  art.Put(keys[0], 1);
+  for (idx_t i = 0; i < 20; i++) {
+    art.Put(keys[1], 100 + i);
+  }
+
+  // an inlined leaf, a chained leaf and a missing key
+  art.Upsert(keys[0], 2);
+  art.Upsert(keys[1], 3);
+  art.Upsert(keys[2], 4);
+  for (idx_t i = 0; i < 3; i++) {
+    std::vector<idx_t> result_ids;
+    ASSERT_TRUE(art.Get(keys[i], result_ids));
+    EXPECT_EQ(std::vector<idx_t>({i + 2}), result_ids);
+  }
+  art.Put(keys[1], 5);
+  std::vector<idx_t> result_ids;
+  ASSERT_TRUE(art.Get(keys[1], result_ids));
+  EXPECT_EQ(std::vector<idx_t>({3, 5}), result_ids);
+
+  // readers always see one doc id per upserted key, however they interleave with the writer
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    for (idx_t i = 0; i < 4000; i++) {
+      art.Upsert(keys[10 + i % 90], i);
+      if (i % 2 == 0) {
+        art.Put(keys[1], i);
+        art.Upsert(keys[1], i);
+      }
+    }
+  });
+  for (idx_t t = 0; t < 2; t++) {
+    threads.emplace_back([&] {
+      for (idx_t i = 0; i < 4000; i++) {
+        std::vector<idx_t> ids;
+        if (art.Get(keys[10 + i % 90], ids)) {
+          ASSERT_EQ(1, ids.size());
+        }
+        ids.clear();
+        ASSERT_TRUE(art.Get(keys[1], ids));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (idx_t i = 10; i < 100; i++) {
+    result_ids.clear();
+    ASSERT_TRUE(art.Get(keys[i], result_ids));
+    EXPECT_EQ(1, result_ids.size());
+  }
+  result_ids.clear();
+  ASSERT_TRUE(art.Get(keys[1], result_ids));
+  EXPECT_EQ(std::vector<idx_t>({3998}), result_ids);
+}
+
 TEST(ConcurrentARTTest, ConcurrentTest) {
   ConcurrentART art;
 
@@ -325,6 +418,83 @@ TEST(ConcurrentNodeTest, MultiThreadTest) {
   EXPECT_EQ(counter, 10 * 100000);
 }
 
+TEST(ConcurrentNodeTest, ContentionStats) {
+  ConcurrentART::ResetContentionStats();
+  ConcurrentNode node;
+  node.Lock();
+  node.Unlock();
+  auto stats = ConcurrentART::GetContentionStats();
+  EXPECT_EQ(stats.lock_spins, 0);
+  EXPECT_EQ(stats.yields, 0);
+
+  node.RLock();
+  std::thread writer([&] {
+    node.Lock();
+    node.Unlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  node.RUnlock();
+  writer.join();
+
+  stats = ConcurrentART::GetContentionStats();
+  EXPECT_GT(stats.lock_spins, 0);
+  EXPECT_GT(stats.yields, 0);
+  EXPECT_EQ(stats.rlock_spins, 0);
+
+  ConcurrentART::ResetContentionStats();
+  EXPECT_EQ(ConcurrentART::GetContentionStats().lock_spins, 0);
+}
+
+TEST(ConcurrentARTTest, RestartFromInnerNode) {
+  ConcurrentART::ResetContentionStats();
+  ConcurrentART art;
+
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::vector<ARTKey> keys;
+  for (idx_t i = 0; i < 10; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int64_t>(arena_allocator, i));
+    art.Put(keys[i], i);
+  }
+
+  art.root->RLock();
+  auto inner = CPrefix::Get(art, *art.root).ptr;
+  art.root->RUnlock();
+  inner->RLock();
+  ASSERT_TRUE(inner->IsInner());
+  auto child = inner->GetChild(art, 5).value();
+  inner->RUnlock();
+
+  // a node being replaced is marked deleted, readers and writers running into it retry until it is back
+  child->Lock();
+  auto data = child->GetData();
+  child->SetDeleted();
+  child->Unlock();
+  std::thread reader([&] {
+    std::vector<idx_t> result_ids;
+    EXPECT_TRUE(art.Get(keys[5], result_ids));
+  });
+  std::thread writer([&] { art.Put(keys[5], 10); });
+  // restore the node only once both ran into it
+  for (auto stats = ConcurrentART::GetContentionStats(); stats.get_restarts == 0 || stats.put_restarts == 0;
+       stats = ConcurrentART::GetContentionStats()) {
+    std::this_thread::yield();
+  }
+  child->Lock();
+  child->SetData(data);
+  child->Unlock();
+  reader.join();
+  writer.join();
+
+  std::vector<idx_t> result_ids;
+  ASSERT_TRUE(art.Get(keys[5], result_ids));
+  EXPECT_EQ(std::vector<idx_t>({5, 10}), result_ids);
+  auto stats = ConcurrentART::GetContentionStats();
+  EXPECT_GT(stats.get_restarts, 0);
+  EXPECT_GT(stats.put_restarts, 0);
+  // both resumed from the node above the deleted one
+  EXPECT_EQ(0, stats.root_restarts);
+}
+
 TEST(ConcurrentARTTest, BigMultiThreadTest) {
   ConcurrentART art;
 
@@ -0,0 +1,122 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <thread>
+
+#include "arena_allocator.h"
+#include "art.h"
+#include "latency_histogram.h"
+
+using namespace part;
+
+TEST(LatencyHistogramTest, Buckets) {
+  idx_t last = 0;
+  for (uint64_t value = 0; value < (1 << 20); value += value / 7 + 1) {
+    auto bucket = LatencyHistogram::BucketIndex(value);
+    ASSERT_LT(bucket, LatencyHistogram::BUCKET_COUNT);
+    ASSERT_GE(bucket, last);
+    ASSERT_LE(LatencyHistogram::BucketLowerBound(bucket), value);
+    ASSERT_GE(LatencyHistogram::BucketUpperBound(bucket), value);
+    // relative error of at most 1 / 32
+    auto width = LatencyHistogram::BucketUpperBound(bucket) - LatencyHistogram::BucketLowerBound(bucket);
+    ASSERT_LE(width * 32, std::max<uint64_t>(value, 1));
+    last = bucket;
+  }
+  for (idx_t bucket = 1; bucket < LatencyHistogram::BUCKET_COUNT; bucket++) {
+    ASSERT_EQ(LatencyHistogram::BucketUpperBound(bucket - 1) + 1, LatencyHistogram::BucketLowerBound(bucket));
+  }
+  EXPECT_EQ(LatencyHistogram::BUCKET_COUNT - 1, LatencyHistogram::BucketIndex(UINT64_MAX));
+  EXPECT_EQ(LatencyHistogram::MAX_VALUE, LatencyHistogram::BucketUpperBound(LatencyHistogram::BUCKET_COUNT - 1));
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.Percentile(50));
+  for (uint64_t value = 1; value <= 10000; value++) {
+    histogram.Record(value);
+  }
+  EXPECT_EQ(10000, histogram.Count());
+  EXPECT_EQ(1, histogram.Min());
+  EXPECT_EQ(10000, histogram.Max());
+  EXPECT_DOUBLE_EQ(5000.5, histogram.Mean());
+  EXPECT_NEAR(5000, histogram.Percentile(50), 5000 / 32);
+  EXPECT_NEAR(9900, histogram.Percentile(99), 9900 / 32);
+  EXPECT_EQ(1, histogram.Percentile(0));
+  EXPECT_EQ(10000, histogram.Percentile(100));
+
+  LatencyHistogram other;
+  other.Record(1000000, 10000);
+  histogram.Merge(other);
+  EXPECT_EQ(20000, histogram.Count());
+  EXPECT_EQ(1000000, histogram.Max());
+  EXPECT_NEAR(1000000, histogram.Percentile(75), 1000000 / 32);
+  EXPECT_NEAR(9900, histogram.Percentile(49.5), 9900 / 32);
+
+  histogram.Reset();
+  EXPECT_EQ(0, histogram.Count());
+  EXPECT_EQ(0, histogram.Min());
+}
+
+TEST(LatencyHistogramTest, Metrics) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  LatencyMetrics::Reset();
+
+  std::string index_path = "latency_test.idx";
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+  idx_t limit = 1000;
+  {
+    ART art(index_path);
+    // off by default
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+    }
+    EXPECT_EQ(0, LatencyMetrics::Snapshot(IndexOperation::PUT).Count());
+
+    LatencyMetrics::SetSampleRate(10);
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i + limit);
+    }
+    EXPECT_EQ(limit / 10, LatencyMetrics::Snapshot(IndexOperation::PUT).Count());
+
+    LatencyMetrics::SetSampleRate(1);
+    for (idx_t i = 0; i < limit; i++) {
+      std::vector<idx_t> results;
+      ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), results));
+    }
+    art.Delete(ARTKey::CreateARTKey<int64_t>(arena_allocator, 0), 0);
+    ART other(art.allocators);
+    other.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, limit), limit);
+    art.Merge(other, 2);
+    art.Serialize();
+  }
+  ART loaded(index_path);
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+
+  auto gets = LatencyMetrics::Snapshot(IndexOperation::GET);
+  EXPECT_EQ(limit, gets.Count());
+  EXPECT_GT(gets.Max(), 0);
+  EXPECT_LE(gets.Percentile(50), gets.Percentile(99));
+  EXPECT_EQ(1, LatencyMetrics::Snapshot(IndexOperation::DELETE).Count());
+  // nested merges count once
+  EXPECT_EQ(1, LatencyMetrics::Snapshot(IndexOperation::MERGE).Count());
+  EXPECT_EQ(1, LatencyMetrics::Snapshot(IndexOperation::SERIALIZE).Count());
+  EXPECT_EQ(1, LatencyMetrics::Snapshot(IndexOperation::DESERIALIZE_NODE).Count());
+
+  // histograms of exited threads are kept
+  std::thread thread([&] {
+    std::vector<idx_t> results;
+    loaded.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 1), results);
+  });
+  thread.join();
+  EXPECT_EQ(limit + 1, LatencyMetrics::Snapshot(IndexOperation::GET).Count());
+
+  LatencyMetrics::SetSampleRate(0);
+  LatencyMetrics::Reset();
+  EXPECT_EQ(0, LatencyMetrics::Snapshot(IndexOperation::GET).Count());
+}
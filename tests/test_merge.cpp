@@ -5,9 +5,11 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <thread>
 #include <type_traits>
 
 #include "art.h"
+#include "buffered_concurrent_art.h"
 #include "concurrent_art.h"
 #include "concurrent_node.h"
 #include "leaf.h"
@@ -476,3 +478,126 @@ TEST(ConcurrentARTTest, Debug) {
     fmt::println("pass j {}", j);
   }
 }
+
+TEST(ConcurrentARTMergeTest, MergeIntoLongLeafChain) {
+  ConcurrentART cart;
+  Allocator& allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  idx_t key_count = 50;
+  std::vector<ARTKey> keys;
+  for (idx_t i = 0; i < key_count; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7919));
+  }
+  for (idx_t round = 0; round < 10; round++) {
+    ART art;
+    for (idx_t i = 0; i < key_count; i++) {
+      art.Put(keys[i], round * 100 + i);
+    }
+    cart.Merge(art);
+    for (idx_t i = 0; i < key_count; i++) {
+      std::vector<idx_t> result_ids;
+      cart.Get(keys[i], result_ids);
+      ASSERT_EQ(result_ids.size(), round + 1);
+    }
+  }
+}
+
+TEST(BufferedConcurrentARTTest, Basic) {
+  ConcurrentART cart;
+  Allocator& allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+
+  std::vector<ARTKey> keys;
+  idx_t limit = 1050;
+  for (idx_t i = 0; i < limit; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int32_t>(arena_allocator, i));
+  }
+
+  BufferedConcurrentART buffered(cart, 100);
+  auto writer = buffered.NewWriter();
+  for (idx_t i = 0; i < limit; i++) {
+    writer->Put(keys[i], i);
+  }
+  // the last 50 doc ids are still in the memtable of the writer
+  std::vector<idx_t> result_ids;
+  EXPECT_FALSE(buffered.Get(keys[limit - 1], result_ids));
+
+  writer->Flush();
+  for (idx_t i = 0; i < limit; i++) {
+    result_ids.clear();
+    ASSERT_TRUE(buffered.Get(keys[i], result_ids));
+    ASSERT_EQ(result_ids.size(), 1);
+    ASSERT_EQ(result_ids[0], i);
+  }
+
+  buffered.WaitMerged();
+  EXPECT_EQ(buffered.PendingCount(), 0);
+  EXPECT_EQ(buffered.MergedCount(), limit / 100 + 1);
+  for (idx_t i = 0; i < limit; i++) {
+    result_ids.clear();
+    ASSERT_TRUE(cart.Get(keys[i], result_ids));
+    ASSERT_EQ(result_ids.size(), 1);
+    ASSERT_EQ(result_ids[0], i);
+  }
+
+  // duplicates are kept the same before and after the merge
+  writer->Put(keys[0], 0);
+  writer->Flush();
+  result_ids.clear();
+  ASSERT_TRUE(buffered.Get(keys[0], result_ids));
+  EXPECT_EQ(std::vector<idx_t>({0, 0}), result_ids);
+  buffered.WaitMerged();
+  result_ids.clear();
+  ASSERT_TRUE(buffered.Get(keys[0], result_ids));
+  EXPECT_EQ(std::vector<idx_t>({0, 0}), result_ids);
+}
+
+TEST(BufferedConcurrentARTTest, MultiThreadIngest) {
+  ConcurrentART cart;
+  Allocator& allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+
+  idx_t thread_count = 4;
+  idx_t per_thread = 20000;
+  idx_t key_count = 5000;
+  std::vector<ARTKey> keys;
+  for (idx_t i = 0; i < key_count; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7919));
+  }
+
+  {
+    BufferedConcurrentART buffered(cart, 3000, 2);
+    std::vector<std::thread> writers;
+    for (idx_t t = 0; t < thread_count; t++) {
+      writers.emplace_back([&, t] {
+        auto writer = buffered.NewWriter();
+        for (idx_t i = 0; i < per_thread; i++) {
+          auto doc_id = t * per_thread + i;
+          writer->Put(keys[doc_id % key_count], doc_id);
+        }
+      });
+    }
+    std::thread reader([&] {
+      for (idx_t i = 0; i < key_count; i++) {
+        std::vector<idx_t> result_ids;
+        buffered.Get(keys[i], result_ids);
+        std::sort(result_ids.begin(), result_ids.end());
+        ASSERT_EQ(std::unique(result_ids.begin(), result_ids.end()), result_ids.end());
+      }
+    });
+    for (auto& writer : writers) {
+      writer.join();
+    }
+    reader.join();
+  }
+
+  for (idx_t i = 0; i < key_count; i++) {
+    std::vector<idx_t> result_ids;
+    ASSERT_TRUE(cart.Get(keys[i], result_ids));
+    ASSERT_EQ(result_ids.size(), thread_count * per_thread / key_count);
+    std::sort(result_ids.begin(), result_ids.end());
+    for (auto doc_id : result_ids) {
+      ASSERT_EQ(doc_id % key_count, i);
+    }
+  }
+}
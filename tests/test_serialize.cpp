@@ -4,6 +4,7 @@
 #include <fmt/core.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -15,6 +16,7 @@
 #include "allocator.h"
 #include "arena_allocator.h"
 #include "art.h"
+#include "art_iterator.h"
 #include "art_key.h"
 #include "concurrent_art.h"
 
@@ -113,7 +115,7 @@ class ARTSerializeTest : public testing::Test {
     }
     std::lock_guard<std::mutex> lock(mu_);
     if (!index_path_.empty()) {
-      removeFiles({index_path_});
+      removeFiles({index_path_, ART::FilterPath(index_path_)});
     }
   }
 
@@ -313,6 +315,235 @@ TEST_F(ARTSerializeTest, FastSerializeBasicTest) {
   }
 }
 
+TEST_F(ARTSerializeTest, LargePostingListTest) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  SetUpFiles("large_posting_list.idx");
+
+  auto index_path = GetFiles();
+  std::vector<ARTKey> keys;
+  for (int32_t i = 0; i < 10; i++) {
+    keys.push_back(ARTKey::CreateARTKey<int32_t>(arena_allocator, i));
+  }
+
+  // NOTE: inlined leaves only keep 56 bits of a doc id
+  std::uniform_int_distribution<idx_t> doc_id_dist(0, idx_t(1) << 40);
+  std::vector<std::vector<idx_t>> doc_ids(keys.size());
+  {
+    ART art(index_path);
+    for (idx_t i = 0; i < 20000; i++) {
+      auto doc_id = doc_id_dist(*gen_);
+      art.Put(keys[i % keys.size()], doc_id);
+      doc_ids[i % keys.size()].push_back(doc_id);
+    }
+    art.Serialize();
+  }
+
+  for (auto &ids : doc_ids) {
+    std::sort(ids.begin(), ids.end());
+  }
+
+  ART art2(index_path);
+  for (idx_t i = 0; i < keys.size(); i++) {
+    std::vector<idx_t> results;
+    ASSERT_TRUE(art2.Get(keys[i], results));
+    ASSERT_EQ(doc_ids[i], results);
+  }
+
+  art2.FastSerialize();
+  ART art3(index_path, true);
+  for (idx_t i = 0; i < keys.size(); i++) {
+    std::vector<idx_t> results;
+    ASSERT_TRUE(art3.Get(keys[i], results));
+    ASSERT_EQ(doc_ids[i], results);
+  }
+}
+
+TEST_F(ARTSerializeTest, DensePostingListTest) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  SetUpFiles("dense_posting_list.idx");
+
+  auto index_path = GetFiles();
+  auto dense_key = ARTKey::CreateARTKey<int32_t>(arena_allocator, 0);
+  auto sparse_key = ARTKey::CreateARTKey<int32_t>(arena_allocator, 1);
+
+  idx_t limit = 100000;
+  {
+    ART art(index_path);
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(dense_key, i);
+      if (i % 100 == 0) {
+        art.Put(sparse_key, i);
+      }
+    }
+    art.Serialize();
+  }
+
+  ART art2(index_path);
+  std::vector<idx_t> results;
+  ASSERT_TRUE(art2.Get(dense_key, results));
+  ASSERT_EQ(limit, results.size());
+  for (idx_t i = 0; i < limit; i++) {
+    ASSERT_EQ(i, results[i]);
+  }
+
+  results.clear();
+  ASSERT_TRUE(art2.Get(sparse_key, results));
+  ASSERT_EQ(limit / 100, results.size());
+  for (idx_t i = 0; i < results.size(); i++) {
+    ASSERT_EQ(i * 100, results[i]);
+  }
+}
+
+TEST_F(ARTSerializeTest, KeyFilterTest) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  SetUpFiles("key_filter.idx");
+
+  auto index_path = GetFiles();
+  idx_t limit = 10000;
+  for (auto fast_serialize : {false, true}) {
+    SCOPED_TRACE(fast_serialize);
+    {
+      ART art(index_path);
+      for (idx_t i = 0; i < limit; i++) {
+        art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2), i);
+      }
+      EXPECT_FALSE(art.HasFilter());
+      fast_serialize ? art.FastSerialize() : art.Serialize();
+      EXPECT_TRUE(art.HasFilter());
+    }
+
+    // NOTE: ART(path, false) still is the fast serialize format
+    auto art2 = fast_serialize ? std::make_unique<ART>(index_path, true) : std::make_unique<ART>(index_path);
+    ASSERT_TRUE(art2->HasFilter());
+    idx_t rejected = 0;
+    for (idx_t i = 0; i < limit; i++) {
+      std::vector<idx_t> results;
+      ASSERT_TRUE(art2->Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2), results));
+      ASSERT_EQ(std::vector<idx_t>({i}), results);
+      auto missing = ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2 + 1);
+      rejected += !art2->MayContain(missing);
+      ASSERT_FALSE(art2->Contains(missing));
+    }
+    EXPECT_GT(rejected, limit * 9 / 10);
+
+    // keys added after loading pass the filter
+    auto new_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, -1);
+    art2->Put(new_key, 42);
+    EXPECT_TRUE(art2->MayContain(new_key));
+    idx_t doc_id;
+    EXPECT_TRUE(art2->GetFirst(new_key, doc_id));
+    EXPECT_EQ(42, doc_id);
+
+    ::unlink(index_path.c_str());
+  }
+}
+
+TEST_F(ARTSerializeTest, StaleKeyFilterTest) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  SetUpFiles("stale_key_filter.idx");
+
+  auto index_path = GetFiles();
+  auto k1 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 1);
+  auto k2 = ARTKey::CreateARTKey<int64_t>(arena_allocator, 2);
+  auto write_k1 = [&] {
+    ::unlink(index_path.c_str());
+    ART art(index_path);
+    art.Put(k1, 1);
+    art.Serialize();
+  };
+
+  // a ConcurrentART writing to the same path drops the filter
+  for (auto fast_serialize : {false, true}) {
+    SCOPED_TRACE(fast_serialize);
+    write_k1();
+    ::unlink(index_path.c_str());
+    {
+      ConcurrentART cart(index_path);
+      cart.Put(k2, 2);
+      fast_serialize ? cart.FastSerialize() : cart.Serialize();
+    }
+    if (!fast_serialize) {
+      ART art(index_path);
+      EXPECT_FALSE(art.HasFilter());
+      std::vector<idx_t> results;
+      EXPECT_TRUE(art.Get(k2, results));
+    }
+    EXPECT_FALSE(std::filesystem::exists(ART::FilterPath(index_path)));
+  }
+
+  // a filter written for another version of the index file is ignored
+  write_k1();
+  ::unlink(index_path.c_str());
+  {
+    ART art(index_path);
+    art.Put(k2, 2);
+    SequentialSerializer writer(index_path, META_OFFSET);
+    auto block_pointer = art.Serialize(writer);
+    SequentialSerializer meta_writer(index_path);
+    art.UpdateMetadata(block_pointer, meta_writer);
+    meta_writer.Flush();
+  }
+  ART art(index_path);
+  EXPECT_FALSE(art.HasFilter());
+  std::vector<idx_t> results;
+  EXPECT_TRUE(art.Get(k2, results));
+  EXPECT_FALSE(art.Get(k1, results));
+}
+
+TEST_F(ARTSerializeTest, LazyLoadTest) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  SetUpFiles("lazy_load.idx");
+
+  auto index_path = GetFiles();
+  idx_t limit = 20000;
+  {
+    ART art(index_path);
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7), i);
+      // a few posting lists that need more than an inlined leaf
+      if (i % 100 == 0) {
+        art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7), i + limit);
+      }
+    }
+    art.Serialize();
+  }
+
+  ART eager(index_path);
+  ART lazy(index_path, nullptr, IndexConstraintType::NONE, true);
+  EXPECT_LT(lazy.GetMemoryUsage(), eager.GetMemoryUsage());
+
+  for (idx_t i = 0; i < limit; i += 3) {
+    std::vector<idx_t> results;
+    ASSERT_TRUE(lazy.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7), results));
+    std::vector<idx_t> expected = {i};
+    if (i % 100 == 0) {
+      expected.push_back(i + limit);
+    }
+    std::sort(results.begin(), results.end());
+    ASSERT_EQ(expected, results);
+    ASSERT_FALSE(lazy.Contains(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7 + 1)));
+  }
+
+  // the iterator loads the rest of the tree
+  idx_t count = 0;
+  ARTIterator it(lazy);
+  for (bool valid = it.SeekToFirst(); valid; valid = it.Next()) {
+    count++;
+  }
+  EXPECT_EQ(limit, count);
+
+  auto new_key = ARTKey::CreateARTKey<int64_t>(arena_allocator, 3);
+  lazy.Put(new_key, 42);
+  idx_t doc_id;
+  EXPECT_TRUE(lazy.GetFirst(new_key, doc_id));
+  EXPECT_EQ(42, doc_id);
+}
+
 TEST(SerializerTest, Basic) {
   Allocator &allocator = Allocator::DefaultAllocator();
   SequentialSerializer serializer("serialize_test.data");
@@ -0,0 +1,146 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <map>
+#include <random>
+#include <thread>
+
+#include "sharded_art.h"
+
+using namespace part;
+
+TEST(ShardedARTTest, Basic) {
+  for (auto partitioner : {ShardPartitioner::HASH, ShardPartitioner::RANGE}) {
+    ShardedART art(8, partitioner);
+    ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+    for (int64_t i = 0; i < 10000; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i + 10000);
+    }
+    for (int64_t i = 0; i < 10000; i++) {
+      std::vector<idx_t> result_ids;
+      ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), result_ids));
+      ASSERT_EQ(std::vector<idx_t>({idx_t(i), idx_t(i + 10000)}), result_ids);
+    }
+
+    art.Delete(ARTKey::CreateARTKey<int64_t>(arena_allocator, 42), 42);
+    std::vector<idx_t> result_ids;
+    EXPECT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 42), result_ids));
+    EXPECT_EQ(std::vector<idx_t>({10042}), result_ids);
+  }
+}
+
+TEST(ShardedARTTest, HashPartitionerSpreadsKeys) {
+  ShardedART art(4);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::vector<idx_t> keys_per_shard(art.ShardCount());
+  for (int64_t i = 0; i < 10000; i++) {
+    keys_per_shard[art.ShardOf(ARTKey::CreateARTKey<int64_t>(arena_allocator, i))]++;
+  }
+  for (auto count : keys_per_shard) {
+    EXPECT_GT(count, 2000);
+  }
+}
+
+TEST(ShardedARTTest, Scan) {
+  for (auto partitioner : {ShardPartitioner::HASH, ShardPartitioner::RANGE}) {
+    ShardedART art(5, partitioner);
+    ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+    std::mt19937_64 rng(3);
+    std::uniform_int_distribution<int64_t> dist(-100000, 100000);
+
+    std::map<int64_t, idx_t> expected;
+    for (idx_t i = 0; i < 20000; i++) {
+      auto value = dist(rng);
+      if (expected.emplace(value, i).second) {
+        art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, value), i);
+      }
+    }
+
+    auto lower = ARTKey::CreateARTKey<int64_t>(arena_allocator, -5000);
+    auto upper = ARTKey::CreateARTKey<int64_t>(arena_allocator, 30000);
+    auto expected_it = expected.lower_bound(-5000);
+    art.Scan(lower, upper, [&](const ARTKey &key, const std::vector<idx_t> &doc_ids) {
+      EXPECT_EQ(ARTKey::CreateARTKey<int64_t>(arena_allocator, expected_it->first), key);
+      EXPECT_EQ(std::vector<idx_t>({expected_it->second}), doc_ids);
+      expected_it++;
+      return true;
+    });
+    EXPECT_EQ(expected.upper_bound(30000), expected_it);
+
+    // stop early
+    idx_t visited = 0;
+    art.Scan(lower, upper, [&](const ARTKey &, const std::vector<idx_t> &) { return ++visited < 10; });
+    EXPECT_EQ(10, visited);
+  }
+}
+
+TEST(ShardedARTTest, MultiThreadPut) {
+  ShardedART art(8);
+  idx_t thread_count = 4;
+  int64_t per_thread = 20000;
+
+  std::vector<std::thread> threads;
+  for (idx_t t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t]() {
+      ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+      for (int64_t i = 0; i < per_thread; i++) {
+        auto value = int64_t(t) * per_thread + i;
+        art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, value), value);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  for (int64_t value = 0; value < int64_t(thread_count) * per_thread; value++) {
+    std::vector<idx_t> result_ids;
+    ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, value), result_ids));
+    ASSERT_EQ(std::vector<idx_t>({idx_t(value)}), result_ids);
+  }
+}
+
+TEST(ShardedARTTest, Serialize) {
+  std::string index_path = "sharded.idx";
+  idx_t shard_count = 4;
+  for (auto fast_serialize : {false, true}) {
+    for (idx_t i = 0; i < shard_count; i++) {
+      std::filesystem::remove(ShardedART::ShardPath(index_path, i));
+      std::filesystem::remove(ART::FilterPath(ShardedART::ShardPath(index_path, i)));
+    }
+    ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+    {
+      ShardedART art(index_path, shard_count, ShardPartitioner::HASH, fast_serialize);
+      for (int64_t i = 0; i < 10000; i++) {
+        art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+      }
+      if (fast_serialize) {
+        art.FastSerialize();
+      } else {
+        art.Serialize();
+      }
+    }
+
+    ShardedART art(index_path, shard_count, ShardPartitioner::HASH, fast_serialize);
+    for (int64_t i = 0; i < 10000; i++) {
+      std::vector<idx_t> result_ids;
+      ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), result_ids));
+      ASSERT_EQ(std::vector<idx_t>({idx_t(i)}), result_ids);
+    }
+  }
+
+  for (idx_t i = 0; i < shard_count; i++) {
+    std::filesystem::remove(ShardedART::ShardPath(index_path, i));
+    std::filesystem::remove(ART::FilterPath(ShardedART::ShardPath(index_path, i)));
+  }
+
+  ShardedART in_memory(2);
+  EXPECT_THROW(in_memory.Serialize(), std::invalid_argument);
+}
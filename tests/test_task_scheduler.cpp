@@ -0,0 +1,142 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <set>
+
+#include "art.h"
+#include "leaf.h"
+#include "node16.h"
+#include "node256.h"
+#include "node4.h"
+#include "node48.h"
+#include "prefix.h"
+#include "task_scheduler.h"
+
+using namespace part;
+
+TEST(TaskSchedulerTest, Basic) {
+  TaskScheduler scheduler(4);
+  EXPECT_EQ(4, scheduler.ThreadCount());
+  EXPECT_EQ(INVALID_INDEX, scheduler.WorkerId());
+
+  std::atomic<idx_t> sum(0);
+  std::mutex lock;
+  std::set<idx_t> worker_ids;
+  TaskGroup group(scheduler);
+  for (idx_t i = 1; i <= 1000; i++) {
+    group.Run([&, i] {
+      sum += i;
+      std::lock_guard<std::mutex> guard(lock);
+      worker_ids.insert(scheduler.WorkerId());
+    });
+  }
+  group.Wait();
+  EXPECT_EQ(500500, sum);
+  for (auto worker_id : worker_ids) {
+    EXPECT_LT(worker_id, scheduler.ThreadCount());
+  }
+
+  // a group can be reused after Wait
+  group.Run([&] { sum = 0; });
+  group.Wait();
+  EXPECT_EQ(0, sum);
+}
+
+TEST(TaskSchedulerTest, ConcurrencyLimit) {
+  TaskScheduler scheduler(4);
+  std::atomic<idx_t> running(0);
+  std::atomic<idx_t> max_running(0);
+  auto task = [&] {
+    auto now = ++running;
+    auto seen = max_running.load();
+    while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    running--;
+  };
+
+  {
+    TaskGroup group(scheduler, 2);
+    for (idx_t i = 0; i < 50; i++) {
+      group.Run(task);
+    }
+    group.Wait();
+    EXPECT_LE(max_running, 2);
+  }
+
+  scheduler.SetMaxConcurrency(1);
+  EXPECT_EQ(1, scheduler.MaxConcurrency());
+  max_running = 0;
+  {
+    TaskGroup group(scheduler);
+    for (idx_t i = 0; i < 20; i++) {
+      group.Run(task);
+    }
+    group.Wait();
+    EXPECT_EQ(1, max_running);
+  }
+  scheduler.SetMaxConcurrency(scheduler.ThreadCount());
+}
+
+TEST(TaskSchedulerTest, ErrorsAndNestedGroups) {
+  TaskScheduler scheduler(2);
+  {
+    TaskGroup group(scheduler);
+    group.Run([] { throw std::invalid_argument("task failed"); });
+    EXPECT_THROW(group.Wait(), std::invalid_argument);
+    // the error is reported once
+    group.Wait();
+  }
+
+  // tasks waiting for tasks of their own do not block the workers they run on
+  std::atomic<idx_t> count(0);
+  TaskGroup outer(scheduler);
+  for (idx_t i = 0; i < 8; i++) {
+    outer.Run([&] {
+      TaskGroup inner(scheduler);
+      for (idx_t j = 0; j < 8; j++) {
+        inner.Run([&] { count++; });
+      }
+      inner.Wait();
+    });
+  }
+  outer.Wait();
+  EXPECT_EQ(64, count);
+}
+
+TEST(TaskSchedulerTest, AllocatorCache) {
+  TaskScheduler scheduler(4);
+  ART art;
+  auto &allocator = Node::GetAllocator(art, NType::NODE_4);
+
+  std::vector<std::vector<Node>> nodes(16);
+  TaskGroup group(scheduler, 0, art.allocators.get());
+  for (auto &task_nodes : nodes) {
+    group.Run([&] {
+      for (idx_t i = 0; i < 1000; i++) {
+        task_nodes.push_back(allocator.New());
+      }
+      // frees stay in the cache of the worker and are handed out again
+      for (idx_t i = 0; i < 500; i++) {
+        allocator.Free(task_nodes.back());
+        task_nodes.pop_back();
+      }
+    });
+  }
+  group.Wait();
+  EXPECT_EQ(16 * 500, allocator.total_allocations);
+
+  std::set<uint64_t> distinct;
+  for (auto &task_nodes : nodes) {
+    for (auto node : task_nodes) {
+      distinct.insert(node.GetData());
+      allocator.Free(node);
+    }
+  }
+  EXPECT_EQ(16 * 500, distinct.size());
+  EXPECT_EQ(0, allocator.total_allocations);
+}
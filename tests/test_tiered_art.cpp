@@ -0,0 +1,163 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+#include "bloom_filter.h"
+#include "tiered_art.h"
+
+using namespace part;
+
+static void RemoveTieredART(const std::string &index_path) {
+  std::filesystem::remove(TieredART::ManifestPath(index_path));
+  for (idx_t i = 0; i < 64; i++) {
+    auto run_path = TieredART::RunPath(index_path, i);
+    std::filesystem::remove(run_path);
+    std::filesystem::remove(ART::FilterPath(run_path));
+  }
+}
+
+TEST(BloomFilterTest, Basic) {
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  idx_t limit = 10000;
+  BloomFilter filter(limit);
+  for (int64_t i = 0; i < limit; i++) {
+    filter.Add(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2));
+  }
+  idx_t false_positives = 0;
+  for (int64_t i = 0; i < limit; i++) {
+    ASSERT_TRUE(filter.MayContain(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2)));
+    if (filter.MayContain(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 2 + 1))) {
+      false_positives++;
+    }
+  }
+  // 10 bits per key give about 1% false positives
+  EXPECT_LT(false_positives, limit / 20);
+
+  BloomFilter empty;
+  EXPECT_TRUE(empty.MayContain(ARTKey::CreateARTKey<int64_t>(arena_allocator, 1)));
+}
+
+TEST(TieredARTTest, FlushAndGet) {
+  std::string index_path = "tiered_basic.idx";
+  RemoveTieredART(index_path);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  {
+    TieredART art(index_path, 1000, 100);
+    for (int64_t i = 0; i < 5000; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i % 2000), i);
+    }
+    EXPECT_EQ(art.RunCount(), 5);
+
+    for (int64_t i = 0; i < 2000; i++) {
+      std::vector<idx_t> result_ids;
+      ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), result_ids));
+      // newest run first
+      std::vector<idx_t> expected;
+      for (int64_t doc_id = 4000 + i; doc_id >= 0; doc_id -= 2000) {
+        if (doc_id < 5000) {
+          expected.push_back(doc_id);
+        }
+      }
+      ASSERT_EQ(expected, result_ids);
+    }
+
+    std::vector<idx_t> result_ids;
+    EXPECT_FALSE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 12345), result_ids));
+    EXPECT_GT(art.FilteredCount(), 0);
+  }
+
+  // the runs are reopened from the manifest
+  TieredART art(index_path, 1000, 100);
+  EXPECT_EQ(art.RunCount(), 5);
+  std::vector<idx_t> result_ids;
+  ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 7), result_ids));
+  std::sort(result_ids.begin(), result_ids.end());
+  EXPECT_EQ(std::vector<idx_t>({7, 2007, 4007}), result_ids);
+  RemoveTieredART(index_path);
+}
+
+TEST(TieredARTTest, Compaction) {
+  std::string index_path = "tiered_compaction.idx";
+  RemoveTieredART(index_path);
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+
+  idx_t limit = 20000;
+  {
+    // compactions share the pool of the caller instead of a thread of their own
+    auto scheduler = std::make_shared<TaskScheduler>(2);
+    TieredART art(index_path, 1500, 4, BloomFilter::DEFAULT_BITS_PER_KEY, scheduler);
+    std::thread reader([&] {
+      for (int64_t i = 0; i < 2000; i++) {
+        std::vector<idx_t> result_ids;
+        art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), result_ids);
+        std::sort(result_ids.begin(), result_ids.end());
+        ASSERT_EQ(std::unique(result_ids.begin(), result_ids.end()), result_ids.end());
+      }
+    });
+    for (int64_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i * 7 % 3000), i);
+    }
+    reader.join();
+    art.Flush();
+    art.WaitCompaction();
+    art.Compact();
+    EXPECT_EQ(art.RunCount(), 1);
+
+    for (int64_t key = 0; key < 3000; key++) {
+      std::vector<idx_t> result_ids;
+      ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, key), result_ids));
+      ASSERT_FALSE(result_ids.empty());
+      for (auto doc_id : result_ids) {
+        ASSERT_EQ(doc_id * 7 % 3000, key);
+      }
+    }
+  }
+
+  // the compacted runs are gone, only the merged one is left
+  idx_t run_files = 0;
+  for (idx_t i = 0; i < 64; i++) {
+    run_files += std::filesystem::exists(TieredART::RunPath(index_path, i));
+  }
+  EXPECT_EQ(run_files, 1);
+  RemoveTieredART(index_path);
+}
+
+TEST(TieredARTTest, GetDuringFlush) {
+  std::string index_path = "tiered_flush.idx";
+  RemoveTieredART(index_path);
+
+  idx_t limit = 20000;
+  {
+    TieredART art(index_path, 1000, 100);
+    std::atomic<int64_t> written(0);
+    std::thread reader([&] {
+      ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+      while (written.load() < limit) {
+        // every doc id put so far is in exactly one of the memtables or runs, also while it is written out
+        auto key = written.load() - 1;
+        if (key < 0) {
+          continue;
+        }
+        std::vector<idx_t> result_ids;
+        ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, key), result_ids));
+        ASSERT_EQ(std::vector<idx_t>({idx_t(key)}), result_ids);
+      }
+    });
+    ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+    for (int64_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+      written.store(i + 1);
+    }
+    reader.join();
+    EXPECT_EQ(art.RunCount(), limit / 1000);
+  }
+  RemoveTieredART(index_path);
+}
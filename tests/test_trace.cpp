@@ -0,0 +1,70 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <thread>
+
+#include "arena_allocator.h"
+#include "art.h"
+#include "trace.h"
+
+using namespace part;
+
+TEST(TraceTest, Counters) {
+  Allocator &allocator = Allocator::DefaultAllocator();
+  ArenaAllocator arena_allocator(allocator, 16384);
+  Trace::Reset();
+
+  std::string index_path = "trace_test.idx";
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+  idx_t limit = 1000;
+  {
+    ART art(index_path);
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i + limit);
+    }
+    for (idx_t i = 0; i < limit; i++) {
+      std::vector<idx_t> results;
+      ASSERT_TRUE(art.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), results));
+    }
+    art.Serialize();
+  }
+  ART loaded(index_path);
+
+  auto stats = Trace::Snapshot();
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+  if (!Trace::Enabled()) {
+    for (auto count : stats.counts) {
+      EXPECT_EQ(0, count);
+    }
+    return;
+  }
+
+  EXPECT_EQ(limit, stats.Get(TraceEvent::LOOKUPS));
+  EXPECT_EQ(2 * limit, stats.Get(TraceEvent::INSERTS));
+  EXPECT_GT(stats.NodeVisits(NType::PREFIX), 0);
+  EXPECT_GT(stats.NodeVisits(NType::NODE_256), 0);
+  EXPECT_GT(stats.Get(TraceEvent::PREFIX_BYTES_COMPARED), 0);
+  EXPECT_GT(stats.Get(TraceEvent::PREFIX_SPLITS), 0);
+  EXPECT_GT(stats.Get(TraceEvent::GROW_NODE4), 0);
+  EXPECT_GT(stats.Get(TraceEvent::GROW_NODE16), 0);
+  EXPECT_GT(stats.Get(TraceEvent::GROW_NODE48), 0);
+  EXPECT_GT(stats.Get(TraceEvent::DESERIALIZE_CALLS), 0);
+  EXPECT_GT(stats.Get(TraceEvent::DESERIALIZE_BYTES), 0);
+
+  // counts of exited threads are kept
+  std::thread thread([&] {
+    std::vector<idx_t> results;
+    loaded.Get(ARTKey::CreateARTKey<int64_t>(arena_allocator, 1), results);
+  });
+  thread.join();
+  EXPECT_EQ(limit + 1, Trace::Snapshot().Get(TraceEvent::LOOKUPS));
+
+  Trace::Reset();
+  EXPECT_EQ(0, Trace::Snapshot().Get(TraceEvent::LOOKUPS));
+}
@@ -0,0 +1,92 @@
+//
+// Created by skyitachi on 26-10-19.
+//
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <numeric>
+
+#include "arena_allocator.h"
+#include "art.h"
+#include "tree_shape.h"
+
+using namespace part;
+
+static idx_t Sum(const std::vector<idx_t> &histogram) {
+  return std::accumulate(histogram.begin(), histogram.end(), idx_t(0));
+}
+
+static void ExpectSameShape(const TreeShape &expected, const TreeShape &shape) {
+  EXPECT_EQ(expected.node_counts, shape.node_counts);
+  EXPECT_EQ(expected.keys, shape.keys);
+  EXPECT_EQ(expected.doc_ids, shape.doc_ids);
+  EXPECT_EQ(expected.depth_histogram, shape.depth_histogram);
+  EXPECT_EQ(expected.prefix_length_histogram, shape.prefix_length_histogram);
+  EXPECT_EQ(expected.fanout_histograms, shape.fanout_histograms);
+  EXPECT_EQ(expected.near_grow, shape.near_grow);
+  EXPECT_EQ(expected.near_shrink, shape.near_shrink);
+}
+
+TEST(TreeShapeTest, Analyze) {
+  ArenaAllocator arena_allocator(Allocator::DefaultAllocator(), 16384);
+  std::string index_path = "tree_shape_test.idx";
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+
+  idx_t limit = 100000;
+  TreeShape shape;
+  {
+    ART art(index_path);
+    EXPECT_EQ(0, TreeShape::Analyze(art).NodeCount());
+    for (idx_t i = 0; i < limit; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, i), i);
+    }
+    // a hot key with a long posting list
+    for (idx_t i = 0; i < 1000; i++) {
+      art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, 7), limit + i);
+    }
+    art.Put(ARTKey::CreateARTKey<int64_t>(arena_allocator, int64_t(1) << 40), 0);
+
+    shape = TreeShape::Analyze(art, 1, 6, 3);
+    EXPECT_EQ(limit + 1, shape.keys);
+    EXPECT_EQ(limit + 1001, shape.doc_ids);
+    EXPECT_EQ(shape.keys, Sum(shape.depth_histogram));
+    EXPECT_EQ(shape.keys, shape.key_length_histogram[sizeof(int64_t)]);
+    idx_t inner_nodes = shape.node_counts[static_cast<idx_t>(NType::PREFIX)];
+    for (auto type : {NType::NODE_4, NType::NODE_16, NType::NODE_48, NType::NODE_256}) {
+      auto index = static_cast<idx_t>(type);
+      EXPECT_EQ(shape.node_counts[index], Sum(shape.fanout_histograms[index]));
+      inner_nodes += shape.node_counts[index];
+    }
+    EXPECT_EQ(art.NoneLeafCount(), inner_nodes);
+    // the keys 0..limit are dense in their last two bytes
+    EXPECT_GT(shape.fanout_histograms[static_cast<idx_t>(NType::NODE_256)][Node::NODE_256_CAPACITY], 0);
+    EXPECT_FALSE(shape.prefix_length_histogram.empty());
+
+    // the subtrees below 6 bytes are the keys below 65536, the other keys up to limit and the largest key
+    ASSERT_EQ(3, shape.largest_by_doc_ids.size());
+    EXPECT_EQ(std::vector<uint8_t>({0x80, 0, 0, 0, 0, 0}), shape.largest_by_doc_ids[0].key_prefix);
+    EXPECT_EQ(65536 + 1000, shape.largest_by_doc_ids[0].doc_ids);
+    EXPECT_EQ(std::vector<uint8_t>({0x80, 0, 0, 0, 0, 1}), shape.largest_by_doc_ids[1].key_prefix);
+    EXPECT_EQ(limit - 65536, shape.largest_by_doc_ids[1].doc_ids);
+    EXPECT_EQ(1, shape.largest_by_doc_ids[2].doc_ids);
+    EXPECT_EQ(shape.largest_by_doc_ids[0].key_prefix, shape.largest_by_nodes[0].key_prefix);
+
+    // walked in parallel, one subtree per key at 8 bytes
+    ExpectSameShape(shape, TreeShape::Analyze(art, 4, 2, 3));
+    auto per_key = TreeShape::Analyze(art, 4, 8, 3);
+    ExpectSameShape(shape, per_key);
+    EXPECT_EQ(1001, per_key.largest_by_doc_ids[0].doc_ids);
+    EXPECT_EQ(1, per_key.largest_by_doc_ids[1].doc_ids);
+    EXPECT_NE(std::string::npos, TreeShape::Analyze(art).ToString().find("fanout node256"));
+    art.Serialize();
+  }
+  ART lazy(index_path, nullptr, IndexConstraintType::NONE, true);
+  auto lazy_shape = TreeShape::Analyze(lazy, 4, 6, 3);
+  std::filesystem::remove(index_path);
+  std::filesystem::remove(ART::FilterPath(index_path));
+  EXPECT_EQ(shape.keys, lazy_shape.keys);
+  EXPECT_EQ(shape.doc_ids, lazy_shape.doc_ids);
+  EXPECT_EQ(shape.depth_histogram, lazy_shape.depth_histogram);
+  EXPECT_EQ(shape.fanout_histograms, lazy_shape.fanout_histograms);
+}